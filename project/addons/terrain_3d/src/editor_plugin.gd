@@ -58,6 +58,7 @@ func _exit_tree() -> void:
 	asset_dock.remove_dock(true)
 	asset_dock.queue_free()
 	ui.queue_free()
+	editor_settings.settings_changed.disconnect(_apply_undo_settings)
 	editor.free()
 
 	scene_changed.disconnect(_on_scene_changed)
@@ -376,7 +377,29 @@ func setup_editor_settings() -> void:
 		"hint_string": "Alt,Space,Meta,Capslock"
 	}
 	editor_settings.add_property_info(property_info)
-	
+
+	if not editor_settings.has_setting("terrain3d/config/undo_memory_budget_mb"):
+		editor_settings.set("terrain3d/config/undo_memory_budget_mb", 256)
+	property_info = {
+		"name": "terrain3d/config/undo_memory_budget_mb",
+		"type": TYPE_INT,
+		"hint": PROPERTY_HINT_RANGE,
+		"hint_string": "16,16384,1,or_greater"
+	}
+	editor_settings.add_property_info(property_info)
+	if not editor_settings.has_setting("terrain3d/config/undo_spill_to_disk"):
+		editor_settings.set("terrain3d/config/undo_spill_to_disk", true)
+	_apply_undo_settings()
+	if not editor_settings.settings_changed.is_connected(_apply_undo_settings):
+		editor_settings.settings_changed.connect(_apply_undo_settings)
+
+
+func _apply_undo_settings() -> void:
+	if not editor:
+		return
+	editor.set_undo_memory_budget(get_setting("terrain3d/config/undo_memory_budget_mb", 256) * 1024 * 1024)
+	editor.set_undo_spill_to_disk(get_setting("terrain3d/config/undo_spill_to_disk", true))
+
 
 func set_setting(p_str: String, p_value: Variant) -> void:
 	editor_settings.set_setting(p_str, p_value)
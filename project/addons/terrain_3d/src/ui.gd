@@ -70,8 +70,7 @@ var editor_decal_fade: float :
 			if is_shader_valid():
 				RenderingServer.material_set_param(mat_rid, "_editor_decal_color", editor_decal_color)
 				if value < 0.001:
-					var r_map: PackedInt32Array = plugin.terrain.data.get_region_map()
-					RenderingServer.material_set_param(mat_rid, "_region_map", r_map)
+					RenderingServer.material_set_param(mat_rid, "_region_map_preview", Vector2i(-1, -1))
 var editor_ring_texture_rid: RID
 
 
@@ -335,8 +334,8 @@ func update_decal() -> void:
 	reset_decal_arrays()
 	editor_decal_position[0] = Vector2(plugin.mouse_global_position.x, plugin.mouse_global_position.z)
 	editor_decal_visible[0] = true
-	# Set region size, and modify region map for none background mode.
-	var r_map: PackedInt32Array = plugin.terrain.data.get_region_map()
+	# Set region size, and preview the hovered region for none background mode.
+	var region_preview := Vector2i(-1, -1)
 	if plugin.editor.get_tool() == Terrain3DEditor.REGION:
 		var r_size: float = float(plugin.terrain.get_region_size()) * plugin.terrain.get_vertex_spacing()
 		var map_size: int = plugin.terrain.data.REGION_MAP_SIZE
@@ -349,25 +348,22 @@ func update_decal() -> void:
 		editor_decal_rotation[0] = 0.0
 		
 		var loc: Vector2i = plugin.terrain.data.get_region_location(plugin.mouse_global_position)
-		loc += Vector2i(map_size / 2, map_size / 2)
-		if !(loc.x < 0 or loc.x > map_size - 1 or loc.y < 0 or loc.y > map_size - 1):
-			var index: int = clampi(loc.y * map_size + loc.x, 0, map_size * map_size - 1)
+		if Terrain3DData.get_region_map_index(loc) >= 0:
+			var has_region: bool = plugin.terrain.data.has_region(loc)
 			if plugin.terrain.material.get_world_background() == Terrain3DMaterial.WorldBackground.NONE:
-				if r_map[index] == 0 and plugin.editor.get_operation() == Terrain3DEditor.ADD:
-					r_map[index] = -index - 1
-				else:
-					r_map[index] = r_map[index]
+				if not has_region and plugin.editor.get_operation() == Terrain3DEditor.ADD:
+					region_preview = loc + Vector2i(map_size / 2, map_size / 2)
 			
 			match plugin.editor.get_operation():
 				Terrain3DEditor.ADD:
-					if r_map[index] <= 0:
+					if not has_region:
 						editor_decal_color[0] = Color.WHITE
 						editor_decal_color[0].a = 0.25
 					else:
 						hide_decal()
 				
 				Terrain3DEditor.SUBTRACT:
-					if r_map[index] > 0:
+					if has_region:
 						editor_decal_color[0] = Color.WHITE * .15
 						editor_decal_color[0].a = 0.75
 					else:
@@ -484,7 +480,7 @@ func update_decal() -> void:
 		RenderingServer.material_set_param(mat_rid, "_editor_decal_color", editor_decal_color)
 		RenderingServer.material_set_param(mat_rid, "_editor_decal_visible", editor_decal_visible)
 		RenderingServer.material_set_param(mat_rid, "_editor_crosshair_threshold", brush_data["crosshair_threshold"] + 0.1)
-		RenderingServer.material_set_param(mat_rid, "_region_map", r_map)
+		RenderingServer.material_set_param(mat_rid, "_region_map_preview", region_preview)
 
 
 func is_shader_valid() -> bool:
@@ -502,9 +498,8 @@ func is_shader_valid() -> bool:
 func hide_decal() -> void:
 	editor_decal_visible = [false, false, false]
 	if is_shader_valid():
-		var r_map: PackedInt32Array = plugin.terrain.data.get_region_map()
 		RenderingServer.material_set_param(mat_rid, "_editor_decal_visible", editor_decal_visible)
-		RenderingServer.material_set_param(mat_rid, "_region_map", r_map)
+		RenderingServer.material_set_param(mat_rid, "_region_map_preview", Vector2i(-1, -1))
 
 
 # These array sizes are reset to 0 when closing scenes for some unknown reason, so check and reset
@@ -0,0 +1,69 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include "data_snapshot.h"
+#include "height_pyramid.h"
+#include "logger.h"
+#include "sparse_map.h"
+#include "terrain_3d_data.h"
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+// Must be constructed on the main thread, where the live data is modified
+DataSnapshot::DataSnapshot(const Terrain3DData *p_data) {
+	if (!p_data) {
+		return;
+	}
+	_region_map = p_data->_region_map;
+	const int region_count = int(p_data->_region_ptrs.size());
+	_region_ptrs.resize(region_count);
+	// One slot of each per region, so regions can be copied in parallel
+	_mapped_files.resize(region_count);
+	_sparse_maps.resize(region_count * 2);
+	_pyramids.resize(region_count);
+	Util::parallel_for(region_count, [&](const int p_from, const int p_to) {
+		for (int i = p_from; i < p_to; i++) {
+			const MapSampler::RegionPtrs &live = p_data->_region_ptrs[i];
+			MapSampler::RegionPtrs &ptrs = _region_ptrs[i];
+			ptrs.offset = live.offset;
+			// Live pointers are only set on maps in the expected format and size. Others stay null
+			// and read as NAN, as does any region marked for deletion.
+			if (!live.region || live.region->is_deleted()) {
+				continue;
+			}
+			auto get_mapped = [&](const MapType p_map_type, const void *p_live_ptr) -> const uint8_t * {
+				const uint8_t *mapped = p_live_ptr ? live.region->get_mapped_ptr(p_map_type) : nullptr;
+				if (mapped) {
+					_mapped_files[i] = live.region->get_mapped_file();
+				}
+				return mapped;
+			};
+			ptrs.height = reinterpret_cast<const float *>(get_mapped(TYPE_HEIGHT, live.height));
+			ptrs.control = reinterpret_cast<const uint32_t *>(get_mapped(TYPE_CONTROL, live.control));
+			auto get_sparse_map = [&](const MapType p_map_type, const void *p_live_ptr, const SparseMap *p_live_sparse) -> const SparseMap * {
+				std::shared_ptr<const SparseMap> &map = _sparse_maps[i * 2 + p_map_type];
+				if (p_live_sparse) {
+					map = live.region->get_sparse_map(p_map_type);
+				} else if (p_live_ptr && !live.region->get_mapped_ptr(p_map_type)) {
+					// Expanded since the last update_maps(), which stores it in tiles again
+					map = SparseMap::compact(live.region->read_map(p_map_type), 1.f);
+				}
+				return map.get();
+			};
+			ptrs.sparse_height = get_sparse_map(TYPE_HEIGHT, live.height, live.sparse_height);
+			ptrs.sparse_control = get_sparse_map(TYPE_CONTROL, live.control, live.sparse_control);
+			// Pyramids are replaced rather than modified while a snapshot holds them
+			_pyramids[i] = live.region->get_height_pyramid();
+			ptrs.pyramid = _pyramids[i].get();
+		}
+	}, 16);
+
+	_sampler.region_map = _region_map.ptr();
+	_sampler.region_map_size = Terrain3DData::REGION_MAP_SIZE;
+	_sampler.regions = _region_ptrs.data();
+	_sampler.region_count = region_count;
+	_sampler.region_size = p_data->_region_size;
+	_sampler.vertex_spacing = p_data->_vertex_spacing;
+	LOG(EXTREME, "Created snapshot of ", region_count, " regions");
+}
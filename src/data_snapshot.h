@@ -0,0 +1,47 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef DATASNAPSHOT_CLASS_H
+#define DATASNAPSHOT_CLASS_H
+
+#include <memory>
+#include <vector>
+
+#include "constants.h"
+#include "map_sampler.h"
+
+class HeightPyramid;
+class MappedFile;
+class SparseMap;
+class Terrain3DData;
+
+using namespace godot;
+
+// An immutable view of the region map and the height and control maps of all active regions, for
+// reading terrain data from worker and physics threads without locks.
+// Regions store these maps as sparse maps, whose tiles are copied on write, so this keeps
+// references to them rather than copying them. A write after a publish copies the region's tile
+// pointers and each tile it touches, 16KB, while this keeps the old ones. So a snapshot costs
+// nothing until the maps change, then at most the tiles written since, and is freed with the last
+// reader. Memory mapped maps are read only, so it reads them in place, keeping their mapping alive.
+// A map expanded into an Image since the last update_maps() is the exception, copied in full.
+// Color maps aren't read by MapSampler, so they aren't referenced.
+// Terrain3DData publishes a new one at the end of update_maps(). Readers keep the shared_ptr
+// returned by Terrain3DData::get_snapshot() for as long as they read from it.
+
+class DataSnapshot {
+	CLASS_NAME_STATIC("Terrain3DDataSnapshot");
+
+private:
+	PackedInt32Array _region_map;
+	std::vector<std::shared_ptr<const MappedFile>> _mapped_files;
+	std::vector<std::shared_ptr<const SparseMap>> _sparse_maps;
+	std::vector<std::shared_ptr<const HeightPyramid>> _pyramids;
+	std::vector<MapSampler::RegionPtrs> _region_ptrs;
+	MapSampler _sampler;
+
+public:
+	DataSnapshot(const Terrain3DData *p_data);
+	const MapSampler &get_sampler() const { return _sampler; }
+};
+
+#endif // DATASNAPSHOT_CLASS_H
@@ -1,10 +1,58 @@
 // Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
 
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/rd_texture_format.hpp>
+#include <godot_cpp/classes/rd_texture_view.hpp>
 #include <godot_cpp/classes/rendering_server.hpp>
 
 #include "generated_texture.h"
 #include "logger.h"
 
+///////////////////////////
+// Private Functions
+///////////////////////////
+
+// Returns the RenderingDevice if textures can be written to directly from this thread. Returns
+// nullptr with the Compatibility renderer, or when rendering runs on its own thread.
+RenderingDevice *GeneratedTexture::_get_rendering_device() {
+	RenderingDevice *rd = RS->get_rendering_device();
+	if (!rd || int(ProjectSettings::get_singleton()->get_setting("rendering/driver/threads/thread_model", 1)) == 2) {
+		return nullptr;
+	}
+	return rd;
+}
+
+// Creates the array on the RenderingDevice, so update() can copy sub rectangles into it. Only
+// used for FORMAT_RF maps without mipmaps. The color map keeps the RenderingServer texture, which
+// provides the sRGB view used by source_color. Returns an invalid RID if not supported.
+RID GeneratedTexture::_create_rd_array(const TypedArray<Image> &p_layers) const {
+	RenderingDevice *rd = _get_rendering_device();
+	Ref<Image> first = p_layers[0];
+	if (!rd || first.is_null() || first->get_format() != Image::FORMAT_RF || first->has_mipmaps()) {
+		return RID();
+	}
+	TypedArray<PackedByteArray> data;
+	for (int i = 0; i < p_layers.size(); i++) {
+		Ref<Image> img = p_layers[i];
+		if (img.is_null() || img->get_format() != Image::FORMAT_RF || img->get_size() != first->get_size() || img->has_mipmaps()) {
+			return RID();
+		}
+		data.push_back(img->get_data());
+	}
+	Ref<RDTextureFormat> format;
+	format.instantiate();
+	format->set_format(RenderingDevice::DATA_FORMAT_R32_SFLOAT);
+	format->set_texture_type(RenderingDevice::TEXTURE_TYPE_2D_ARRAY);
+	format->set_width(first->get_width());
+	format->set_height(first->get_height());
+	format->set_array_layers(p_layers.size());
+	format->set_usage_bits(RenderingDevice::TEXTURE_USAGE_SAMPLING_BIT | RenderingDevice::TEXTURE_USAGE_CAN_UPDATE_BIT |
+			RenderingDevice::TEXTURE_USAGE_CAN_COPY_FROM_BIT | RenderingDevice::TEXTURE_USAGE_CAN_COPY_TO_BIT);
+	Ref<RDTextureView> view;
+	view.instantiate();
+	return rd->texture_create(format, view, data);
+}
+
 ///////////////////////////
 // Public Functions
 ///////////////////////////
@@ -14,11 +62,17 @@ void GeneratedTexture::clear() {
 		LOG(EXTREME, "GeneratedTexture freeing ", _rid);
 		RS->free_rid(_rid);
 	}
+	if (_rd_rid.is_valid()) {
+		LOG(EXTREME, "GeneratedTexture freeing RenderingDevice texture ", _rd_rid);
+		RS->get_rendering_device()->free_rid(_rd_rid);
+	}
 	if (_image.is_valid()) {
 		LOG(EXTREME, "GeneratedTexture unref image", _image);
 		_image.unref();
 	}
 	_rid = RID();
+	_rd_rid = RID();
+	_layer_count = 0;
 	_dirty = true;
 }
 
@@ -31,7 +85,13 @@ RID GeneratedTexture::create(const TypedArray<Image> &p_layers) {
 				LOG(EXTREME, i, ": ", img, ", empty: ", img->is_empty(), ", size: ", img->get_size(), ", format: ", img->get_format());
 			}
 		}
-		_rid = RS->texture_2d_layered_create(p_layers, RenderingServer::TEXTURE_LAYERED_2D_ARRAY);
+		_rd_rid = _create_rd_array(p_layers);
+		if (_rd_rid.is_valid()) {
+			_rid = RS->texture_rd_create(_rd_rid, RenderingServer::TEXTURE_LAYERED_2D_ARRAY);
+		} else {
+			_rid = RS->texture_2d_layered_create(p_layers, RenderingServer::TEXTURE_LAYERED_2D_ARRAY);
+		}
+		_layer_count = p_layers.size();
 		_dirty = false;
 	} else {
 		clear();
@@ -39,9 +99,40 @@ RID GeneratedTexture::create(const TypedArray<Image> &p_layers) {
 	return _rid;
 }
 
-void GeneratedTexture::update(const Ref<Image> &p_image, const int p_layer) {
-	LOG(EXTREME, "RenderingServer updating Texture2DArray at index: ", p_layer);
-	RS->texture_2d_update(_rid, p_image, p_layer);
+/** Uploads a layer of the array.
+ *	p_rect - only upload these pixels, or the whole layer if empty. Only arrays created on the
+ *		RenderingDevice support this, others upload the whole layer.
+ */
+void GeneratedTexture::update(const Ref<Image> &p_image, const int p_layer, const Rect2i &p_rect) {
+	RenderingDevice *rd = _rd_rid.is_valid() ? _get_rendering_device() : nullptr;
+	if (!rd || p_image.is_null() || p_image->get_format() != Image::FORMAT_RF || p_image->has_mipmaps()) {
+		LOG(EXTREME, "RenderingServer updating Texture2DArray at index: ", p_layer);
+		RS->texture_2d_update(_rid, p_image, p_layer);
+		return;
+	}
+	const Rect2i full = Rect2i(V2I_ZERO, p_image->get_size());
+	const Rect2i rect = p_rect.intersection(full);
+	if (!rect.has_area() || rect == full) {
+		LOG(EXTREME, "RenderingDevice updating Texture2DArray at index: ", p_layer);
+		rd->texture_update(_rd_rid, p_layer, p_image->get_data());
+		return;
+	}
+	// Stage the rectangle in a small texture and copy it into the layer on the GPU
+	LOG(EXTREME, "RenderingDevice updating Texture2DArray at index: ", p_layer, ", rect: ", rect);
+	Ref<RDTextureFormat> format;
+	format.instantiate();
+	format->set_format(RenderingDevice::DATA_FORMAT_R32_SFLOAT);
+	format->set_width(rect.size.x);
+	format->set_height(rect.size.y);
+	format->set_usage_bits(RenderingDevice::TEXTURE_USAGE_SAMPLING_BIT | RenderingDevice::TEXTURE_USAGE_CAN_COPY_FROM_BIT);
+	Ref<RDTextureView> view;
+	view.instantiate();
+	TypedArray<PackedByteArray> data;
+	data.push_back(p_image->get_region(rect)->get_data());
+	RID staging = rd->texture_create(format, view, data);
+	rd->texture_copy(staging, _rd_rid, V3_ZERO, Vector3(rect.position.x, rect.position.y, 0.f),
+			Vector3(rect.size.x, rect.size.y, 1.f), 0, 0, 0, p_layer);
+	rd->free_rid(staging);
 }
 
 RID GeneratedTexture::create(const Ref<Image> &p_image) {
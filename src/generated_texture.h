@@ -4,6 +4,7 @@
 #define GENERATEDTEXTURE_CLASS_H
 
 #include <godot_cpp/classes/image.hpp>
+#include <godot_cpp/classes/rendering_device.hpp>
 
 #include "constants.h"
 
@@ -14,17 +15,23 @@ class GeneratedTexture {
 
 private:
 	RID _rid = RID();
+	RID _rd_rid = RID(); // Array created on the RenderingDevice and wrapped by _rid, if supported
 	Ref<Image> _image;
+	int _layer_count = 0;
 	bool _dirty = false;
 
+	static RenderingDevice *_get_rendering_device();
+	RID _create_rd_array(const TypedArray<Image> &p_layers) const;
+
 public:
 	void clear();
 	bool is_dirty() const { return _dirty; }
 	RID create(const TypedArray<Image> &p_layers);
-	void update(const Ref<Image> &p_image, const int p_layer);
+	void update(const Ref<Image> &p_image, const int p_layer, const Rect2i &p_rect = Rect2i());
 	RID create(const Ref<Image> &p_image);
 	Ref<Image> get_image() const { return _image; }
 	RID get_rid() const { return _rid; }
+	int get_layer_count() const { return _layer_count; }
 };
 
 #endif // GENERATEDTEXTURE_CLASS_H
\ No newline at end of file
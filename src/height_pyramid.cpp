@@ -0,0 +1,79 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include "height_pyramid.h"
+#include "logger.h"
+
+///////////////////////////
+// Private Functions
+///////////////////////////
+
+// Returns the range of the 4 vertices of a quad. Missing vertices in absent neighbors are ignored.
+Vector2 HeightPyramid::_calc_cell(const MapSampler &p_sampler, const MapSampler::RegionPtrs &p_ptrs, const int p_x, const int p_y) const {
+	real_t heights[4];
+	if (p_ptrs.height && p_x < _size - 1 && p_y < _size - 1) {
+		const float *row0 = p_ptrs.height + p_y * _size + p_x;
+		heights[0] = row0[0];
+		heights[1] = row0[1];
+		heights[2] = row0[_size];
+		heights[3] = row0[_size + 1];
+	} else {
+		const Vector2i vertex = p_ptrs.offset + Vector2i(p_x, p_y);
+		heights[0] = p_sampler.get_vertex_height(vertex);
+		heights[1] = p_sampler.get_vertex_height(vertex + Vector2i(1, 0));
+		heights[2] = p_sampler.get_vertex_height(vertex + Vector2i(0, 1));
+		heights[3] = p_sampler.get_vertex_height(vertex + Vector2i(1, 1));
+	}
+	Vector2 range = Vector2(INFINITY, -INFINITY);
+	for (const real_t height : heights) {
+		if (!std::isnan(height)) {
+			range.x = MIN(range.x, height);
+			range.y = MAX(range.y, height);
+		}
+	}
+	return range;
+}
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+void HeightPyramid::build(const MapSampler &p_sampler, const MapSampler::RegionPtrs &p_ptrs) {
+	_size = p_sampler.region_size;
+	_levels.clear();
+	for (int size = _size; size > 0; size >>= 1) {
+		_levels.emplace_back(size_t(size) * size, Vector2(INFINITY, -INFINITY));
+	}
+	update(p_sampler, p_ptrs, Rect2i(0, 0, _size, _size));
+	LOG(EXTREME, "Built height pyramid of ", _levels.size(), " levels for region ", p_ptrs.offset / MAX(1, _size));
+}
+
+// Recalculates the level 0 cells in p_cells, then their parents on each level above
+void HeightPyramid::update(const MapSampler &p_sampler, const MapSampler::RegionPtrs &p_ptrs, const Rect2i &p_cells) {
+	Rect2i rect = p_cells.intersection(Rect2i(0, 0, _size, _size));
+	if (!rect.has_area() || _levels.empty()) {
+		return;
+	}
+	std::vector<Vector2> &cells = _levels[0];
+	for (int y = rect.position.y; y < rect.get_end().y; y++) {
+		for (int x = rect.position.x; x < rect.get_end().x; x++) {
+			cells[y * _size + x] = _calc_cell(p_sampler, p_ptrs, x, y);
+		}
+	}
+	for (int level = 1; level < int(_levels.size()); level++) {
+		const Vector2i from = rect.position / 2;
+		const Vector2i to = (rect.get_end() - Vector2i(1, 1)) / 2;
+		rect = Rect2i(from, to - from + Vector2i(1, 1));
+		const int size = _size >> level;
+		const std::vector<Vector2> &children = _levels[level - 1];
+		std::vector<Vector2> &parents = _levels[level];
+		for (int y = rect.position.y; y < rect.get_end().y; y++) {
+			for (int x = rect.position.x; x < rect.get_end().x; x++) {
+				const Vector2 *row0 = &children[(y * 2) * (size * 2) + x * 2];
+				const Vector2 *row1 = row0 + size * 2;
+				parents[y * size + x] = Vector2(
+						MIN(MIN(row0[0].x, row0[1].x), MIN(row1[0].x, row1[1].x)),
+						MAX(MAX(row0[0].y, row0[1].y), MAX(row1[0].y, row1[1].y)));
+			}
+		}
+	}
+}
@@ -0,0 +1,44 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef HEIGHTPYRAMID_CLASS_H
+#define HEIGHTPYRAMID_CLASS_H
+
+#include <vector>
+
+#include "constants.h"
+#include "map_sampler.h"
+
+using namespace godot;
+
+// A min/max mip pyramid of the heights of one region, used to skip empty space in ray queries.
+// Level 0 has one cell per quad, holding the range of its 4 vertices. The quads on the last row
+// and column reach into the neighboring regions. Each level above halves the resolution, up to a
+// single cell for the whole region.
+// Terrain3DData builds and updates these on the main thread. Snapshots share them, so a pyramid
+// still held by one is copied before being modified.
+
+class HeightPyramid {
+	CLASS_NAME_STATIC("Terrain3DHeightPyramid");
+
+private:
+	int _size = 0; // Cells per side on level 0, which is the region size
+	std::vector<std::vector<Vector2>> _levels; // Min and max height of each cell, row major
+
+	Vector2 _calc_cell(const MapSampler &p_sampler, const MapSampler::RegionPtrs &p_ptrs, const int p_x, const int p_y) const;
+
+public:
+	void build(const MapSampler &p_sampler, const MapSampler::RegionPtrs &p_ptrs);
+	void update(const MapSampler &p_sampler, const MapSampler::RegionPtrs &p_ptrs, const Rect2i &p_cells);
+	int get_size() const { return _size; }
+	int get_level_count() const { return int(_levels.size()); }
+	Vector2 get_range(const int p_level, const int p_x, const int p_y) const;
+};
+
+// Inline Functions
+
+// Returns the min and max height of a cell. Cells without any vertices return (INF, -INF).
+inline Vector2 HeightPyramid::get_range(const int p_level, const int p_x, const int p_y) const {
+	return _levels[p_level][p_y * (_size >> p_level) + p_x];
+}
+
+#endif // HEIGHTPYRAMID_CLASS_H
@@ -0,0 +1,242 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include <algorithm>
+#include <cstring>
+
+#include "instance_data.h"
+#include "logger.h"
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+std::vector<int> InstanceData::get_mesh_ids() const {
+	std::vector<int> ids;
+	ids.reserve(_meshes.size());
+	for (const auto &it : _meshes) {
+		ids.push_back(it.first);
+	}
+	return ids;
+}
+
+InstanceData::CellMap *InstanceData::get_cells(const int p_mesh_id) {
+	auto it = _meshes.find(p_mesh_id);
+	return (it != _meshes.end()) ? &it->second : nullptr;
+}
+
+const InstanceData::CellMap *InstanceData::get_cells(const int p_mesh_id) const {
+	auto it = _meshes.find(p_mesh_id);
+	return (it != _meshes.end()) ? &it->second : nullptr;
+}
+
+// Removes the cell, and the mesh if it was its last cell
+void InstanceData::erase_cell(const int p_mesh_id, const Vector2i &p_cell) {
+	auto it = _meshes.find(p_mesh_id);
+	if (it == _meshes.end()) {
+		return;
+	}
+	it->second.erase(p_cell);
+	if (it->second.empty()) {
+		_meshes.erase(it);
+	}
+}
+
+// Exchanges the instances of two mesh ids, either of which may have none
+void InstanceData::swap_meshes(const int p_src_id, const int p_dst_id) {
+	CellMap src;
+	CellMap dst;
+	auto it = _meshes.find(p_src_id);
+	if (it != _meshes.end()) {
+		src.swap(it->second);
+		_meshes.erase(it);
+	}
+	it = _meshes.find(p_dst_id);
+	if (it != _meshes.end()) {
+		dst.swap(it->second);
+		_meshes.erase(it);
+	}
+	if (!src.empty()) {
+		_meshes[p_dst_id].swap(src);
+	}
+	if (!dst.empty()) {
+		_meshes[p_src_id].swap(dst);
+	}
+	for (const int mesh_id : { p_src_id, p_dst_id }) {
+		CellMap *cells = get_cells(mesh_id);
+		if (!cells) {
+			continue;
+		}
+		for (auto &cell : *cells) {
+			cell.second.modified = true;
+		}
+	}
+}
+
+void InstanceData::append(const int p_mesh_id, const Vector2i &p_cell, const Transform3D &p_xform, const Color &p_color) {
+	Cell &cell = _meshes[p_mesh_id][p_cell];
+	const int64_t offset = cell.buffer.size();
+	cell.buffer.resize(offset + STRIDE);
+	write_instance(cell.buffer.ptrw() + offset, p_xform, p_color);
+	cell.modified = true;
+}
+
+void InstanceData::set_modified(const bool p_modified) {
+	for (auto &mesh : _meshes) {
+		for (auto &cell : mesh.second) {
+			cell.second.modified = p_modified;
+		}
+	}
+}
+
+int64_t InstanceData::get_instance_count() const {
+	int64_t count = 0;
+	for (const auto &mesh : _meshes) {
+		for (const auto &cell : mesh.second) {
+			count += cell.second.get_count();
+		}
+	}
+	return count;
+}
+
+int64_t InstanceData::get_memory() const {
+	return get_instance_count() * STRIDE * sizeof(float);
+}
+
+/** Returns the data for storage as Dictionary{ mesh_id:int -> [ cells, buffer ] }
+ *	cells - PackedInt32Array of x, y and instance count for each cell
+ *	buffer - PackedFloat32Array of the buffers of the cells in that order
+ * Mesh ids and cells are written in sorted order, so unchanged data saves identically.
+ */
+Dictionary InstanceData::serialize() const {
+	Dictionary dict;
+	std::vector<std::pair<Vector2i, const Cell *>> sorted;
+	for (const auto &mesh : _meshes) { // Ordered by mesh id
+		sorted.clear();
+		int64_t floats = 0;
+		for (const auto &cell : mesh.second) {
+			if (cell.second.get_count() > 0) {
+				sorted.push_back({ cell.first, &cell.second });
+				floats += cell.second.buffer.size();
+			}
+		}
+		if (sorted.empty()) {
+			continue;
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+		PackedInt32Array cells;
+		cells.resize(sorted.size() * 3);
+		int32_t *cell_dst = cells.ptrw();
+		PackedFloat32Array buffer;
+		buffer.resize(floats);
+		float *dst = buffer.ptrw();
+		for (const auto &cell : sorted) {
+			*cell_dst++ = cell.first.x;
+			*cell_dst++ = cell.first.y;
+			*cell_dst++ = cell.second->get_count();
+			const int64_t size = cell.second->buffer.size();
+			memcpy(dst, cell.second->buffer.ptr(), size * sizeof(float));
+			dst += size;
+		}
+		Array entry;
+		entry.push_back(cells);
+		entry.push_back(buffer);
+		dict[mesh.first] = entry;
+	}
+	return dict;
+}
+
+// Replaces the data with that from serialize(). All cells are marked modified.
+void InstanceData::deserialize(const Dictionary &p_data) {
+	_meshes.clear();
+	const Array mesh_ids = p_data.keys();
+	for (int m = 0; m < mesh_ids.size(); m++) {
+		const int mesh_id = mesh_ids[m];
+		const Array entry = p_data[mesh_ids[m]];
+		if (entry.size() != 2) {
+			LOG(ERROR, "Malformed instance data for mesh id ", mesh_id);
+			continue;
+		}
+		const PackedInt32Array cells = entry[0];
+		const PackedFloat32Array buffer = entry[1];
+		int64_t floats = 0;
+		for (int i = 2; i < cells.size(); i += 3) {
+			floats += int64_t(cells[i]) * STRIDE;
+		}
+		if (cells.size() % 3 != 0 || floats != buffer.size()) {
+			LOG(ERROR, "Instance data for mesh id ", mesh_id, " has ", buffer.size(), " floats, expected ", floats);
+			continue;
+		}
+		CellMap &cell_map = _meshes[mesh_id];
+		const float *src = buffer.ptr();
+		for (int i = 0; i < cells.size(); i += 3) {
+			const int64_t size = int64_t(cells[i + 2]) * STRIDE;
+			if (size <= 0) {
+				continue;
+			}
+			Cell &cell = cell_map[Vector2i(cells[i], cells[i + 1])];
+			cell.buffer.resize(size);
+			memcpy(cell.buffer.ptrw(), src, size * sizeof(float));
+			src += size;
+		}
+		if (cell_map.empty()) {
+			_meshes.erase(mesh_id);
+		}
+	}
+}
+
+// Returns the data in the format of earlier versions:
+// Dictionary{ mesh_id:int -> Dictionary{ cell:Vector2i -> [ TypedArray<Transform3D>, PackedColorArray, modified:bool ] } }
+Dictionary InstanceData::to_dictionary() const {
+	Dictionary dict;
+	for (const auto &mesh : _meshes) {
+		Dictionary cell_dict;
+		for (const auto &cell : mesh.second) {
+			const int count = cell.second.get_count();
+			const float *src = cell.second.buffer.ptr();
+			TypedArray<Transform3D> xforms;
+			PackedColorArray colors;
+			xforms.resize(count);
+			colors.resize(count);
+			for (int i = 0; i < count; i++) {
+				xforms[i] = read_transform(src + i * STRIDE);
+				colors.set(i, read_color(src + i * STRIDE));
+			}
+			Array triple;
+			triple.push_back(xforms);
+			triple.push_back(colors);
+			triple.push_back(cell.second.modified);
+			cell_dict[cell.first] = triple;
+		}
+		dict[mesh.first] = cell_dict;
+	}
+	return dict;
+}
+
+// Replaces the data with that in the format of to_dictionary()
+void InstanceData::from_dictionary(const Dictionary &p_instances) {
+	_meshes.clear();
+	const Array mesh_ids = p_instances.keys();
+	for (int m = 0; m < mesh_ids.size(); m++) {
+		const int mesh_id = mesh_ids[m];
+		const Dictionary cell_dict = p_instances[mesh_ids[m]];
+		const Array cell_locs = cell_dict.keys();
+		for (int c = 0; c < cell_locs.size(); c++) {
+			const Array triple = cell_dict[cell_locs[c]];
+			if (triple.size() < 3) {
+				LOG(WARN, "Malformed instance triple for mesh id ", mesh_id, " at cell ", cell_locs[c]);
+				continue;
+			}
+			const TypedArray<Transform3D> xforms = triple[0];
+			const PackedColorArray colors = triple[1];
+			if (xforms.is_empty()) {
+				continue;
+			}
+			Cell &cell = _meshes[mesh_id][Vector2i(cell_locs[c])];
+			cell.buffer.resize(int64_t(xforms.size()) * STRIDE);
+			float *dst = cell.buffer.ptrw();
+			for (int i = 0; i < xforms.size(); i++) {
+				write_instance(dst + i * STRIDE, xforms[i], (i < colors.size()) ? colors[i] : COLOR_WHITE);
+			}
+		}
+	}
+}
@@ -0,0 +1,90 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef INSTANCEDATA_CLASS_H
+#define INSTANCEDATA_CLASS_H
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "constants.h"
+
+using namespace godot;
+
+// The instances of a region by mesh id, then by cell of Terrain3DInstancer::CELL_SIZE vertices.
+// Each cell holds a single buffer of STRIDE floats per instance, in the layout of a MultiMesh
+// buffer using TRANSFORM_3D and colors: the three basis rows each followed by a component of the
+// origin, then the color. Transforms are in region space.
+// Buffers are PackedFloat32Arrays, so copies of the data share them until written.
+// Regions store the data with serialize(), as one buffer per mesh and a table of cells. The nested
+// Dictionary used by earlier versions is converted with to_dictionary() and from_dictionary().
+
+class InstanceData {
+	CLASS_NAME_STATIC("Terrain3DInstanceData");
+
+public: // Constants
+	static inline const int XFORM_FLOATS = 12;
+	static inline const int COLOR_FLOATS = 4;
+	static inline const int STRIDE = XFORM_FLOATS + COLOR_FLOATS;
+
+	struct Cell {
+		PackedFloat32Array buffer;
+		bool modified = true; // Changed since the MMIs were last updated
+		int get_count() const { return buffer.size() / STRIDE; }
+	};
+	typedef std::unordered_map<Vector2i, Cell, Vector2iHash> CellMap;
+
+private:
+	std::map<int, CellMap> _meshes; // By mesh id
+
+public:
+	bool is_empty() const { return _meshes.empty(); }
+	void clear() { _meshes.clear(); }
+	std::vector<int> get_mesh_ids() const;
+	bool has_mesh(const int p_mesh_id) const { return _meshes.count(p_mesh_id) > 0; }
+	CellMap *get_cells(const int p_mesh_id);
+	const CellMap *get_cells(const int p_mesh_id) const;
+	Cell &get_or_add_cell(const int p_mesh_id, const Vector2i &p_cell) { return _meshes[p_mesh_id][p_cell]; }
+	void erase_cell(const int p_mesh_id, const Vector2i &p_cell);
+	void erase_mesh(const int p_mesh_id) { _meshes.erase(p_mesh_id); }
+	void swap_meshes(const int p_src_id, const int p_dst_id);
+	void append(const int p_mesh_id, const Vector2i &p_cell, const Transform3D &p_xform, const Color &p_color);
+	void set_modified(const bool p_modified);
+	int64_t get_instance_count() const;
+	int64_t get_memory() const;
+
+	Dictionary serialize() const;
+	void deserialize(const Dictionary &p_data);
+	Dictionary to_dictionary() const;
+	void from_dictionary(const Dictionary &p_instances);
+
+	static void write_instance(float *r_dst, const Transform3D &p_xform, const Color &p_color);
+	static Transform3D read_transform(const float *p_src);
+	static Color read_color(const float *p_src);
+};
+
+// Inline Functions
+
+inline void InstanceData::write_instance(float *r_dst, const Transform3D &p_xform, const Color &p_color) {
+	for (int row = 0; row < 3; row++) {
+		r_dst[row * 4 + 0] = p_xform.basis.rows[row].x;
+		r_dst[row * 4 + 1] = p_xform.basis.rows[row].y;
+		r_dst[row * 4 + 2] = p_xform.basis.rows[row].z;
+		r_dst[row * 4 + 3] = p_xform.origin[row];
+	}
+	r_dst[XFORM_FLOATS + 0] = p_color.r;
+	r_dst[XFORM_FLOATS + 1] = p_color.g;
+	r_dst[XFORM_FLOATS + 2] = p_color.b;
+	r_dst[XFORM_FLOATS + 3] = p_color.a;
+}
+
+inline Transform3D InstanceData::read_transform(const float *p_src) {
+	return Transform3D(p_src[0], p_src[1], p_src[2], p_src[4], p_src[5], p_src[6],
+			p_src[8], p_src[9], p_src[10], p_src[3], p_src[7], p_src[11]);
+}
+
+inline Color InstanceData::read_color(const float *p_src) {
+	return Color(p_src[XFORM_FLOATS + 0], p_src[XFORM_FLOATS + 1], p_src[XFORM_FLOATS + 2], p_src[XFORM_FLOATS + 3]);
+}
+
+#endif // INSTANCEDATA_CLASS_H
@@ -0,0 +1,249 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include "height_pyramid.h"
+#include "map_sampler.h"
+
+// A ray in world space, along with its projection onto the descaled XZ plane. Both are
+// parameterized by the distance travelled in world space.
+struct MapSampler::Ray {
+	Vector3 origin;
+	Vector3 direction; // Normalized
+	Vector2 pos; // Descaled XZ origin
+	Vector2 dir; // Descaled XZ distance per world unit
+
+	// Narrows the range to the part of the ray over a descaled box. False if it misses the box.
+	bool clip(const Vector2 &p_min, const Vector2 &p_max, real_t &r_t_min, real_t &r_t_max) const {
+		for (int axis = 0; axis < 2; axis++) {
+			if (dir[axis] == 0.f) {
+				if (pos[axis] < p_min[axis] || pos[axis] > p_max[axis]) {
+					return false;
+				}
+				continue;
+			}
+			real_t t0 = (p_min[axis] - pos[axis]) / dir[axis];
+			real_t t1 = (p_max[axis] - pos[axis]) / dir[axis];
+			if (t0 > t1) {
+				SWAP(t0, t1);
+			}
+			r_t_min = MAX(r_t_min, t0);
+			r_t_max = MIN(r_t_max, t1);
+		}
+		return r_t_min <= r_t_max;
+	}
+};
+
+///////////////////////////
+// Private Functions
+///////////////////////////
+
+// Traverses the height pyramid of a region front to back, skipping every cell whose height range
+// the ray doesn't cross. Without a pyramid, every cell along the ray is tested.
+bool MapSampler::_raycast_region(const Ray &p_ray, const int p_region_id, const real_t p_t_min, const real_t p_t_max, RayHit &r_hit) const {
+	const RegionPtrs &ptrs = regions[p_region_id];
+	if (ptrs.region && ptrs.region->is_deleted()) {
+		return false;
+	}
+	const HeightPyramid *pyramid = (ptrs.pyramid && ptrs.pyramid->get_size() == region_size) ? ptrs.pyramid : nullptr;
+	int top_level = 0;
+	while ((1 << top_level) < region_size) {
+		top_level++;
+	}
+
+	struct Node {
+		int level;
+		Vector2i cell;
+		real_t t_min;
+		real_t t_max;
+	};
+	// Each level pushes at most 4 nodes, so this can't overflow
+	Node stack[4 * 16];
+	int count = 0;
+	stack[count++] = { top_level, V2I_ZERO, p_t_min, p_t_max };
+
+	while (count > 0) {
+		const Node node = stack[--count];
+		const Vector2 range = pyramid ? pyramid->get_range(node.level, node.cell.x, node.cell.y) : Vector2(-INFINITY, INFINITY);
+		const real_t y_min = p_ray.origin.y + p_ray.direction.y * node.t_min;
+		const real_t y_max = p_ray.origin.y + p_ray.direction.y * node.t_max;
+		if (MIN(y_min, y_max) > range.y || MAX(y_min, y_max) < range.x) {
+			continue;
+		}
+		if (node.level == 0) {
+			if (_raycast_cell(p_ray, ptrs, node.cell.x, node.cell.y, node.t_min, node.t_max, r_hit)) {
+				r_hit.region_id = p_region_id;
+				return true;
+			}
+			continue;
+		}
+
+		// Clip the children, slightly enlarged so rays along their edges can't slip between them
+		const int level = node.level - 1;
+		const real_t cell_size = real_t(1 << level);
+		Node children[4];
+		int child_count = 0;
+		for (int i = 0; i < 4; i++) {
+			Node child = { level, node.cell * 2 + Vector2i(i & 1, i >> 1), node.t_min, node.t_max };
+			const Vector2 box_min = Vector2(ptrs.offset) + Vector2(child.cell) * cell_size - Vector2(.001f, .001f);
+			const Vector2 box_max = box_min + Vector2(cell_size + .002f, cell_size + .002f);
+			if (p_ray.clip(box_min, box_max, child.t_min, child.t_max)) {
+				children[child_count++] = child;
+			}
+		}
+		// Push the nearest last, so it's visited first
+		for (int i = 1; i < child_count; i++) {
+			for (int j = i; j > 0 && children[j].t_min < children[j - 1].t_min; j--) {
+				SWAP(children[j], children[j - 1]);
+			}
+		}
+		for (int i = child_count - 1; i >= 0; i--) {
+			stack[count++] = children[i];
+		}
+	}
+	return false;
+}
+
+// Intersects the ray with the bilinear surface of one quad. Along the ray the height difference
+// is a quadratic, whose first root within the range is the exact hit. A ray starting below the
+// surface hits immediately. Quads over holes or missing vertices are never hit.
+bool MapSampler::_raycast_cell(const Ray &p_ray, const RegionPtrs &p_ptrs, const int p_x, const int p_y, const real_t p_t_min, const real_t p_t_max, RayHit &r_hit) const {
+	if (is_hole(read_control(p_ptrs, p_x, p_y))) {
+		return false;
+	}
+	real_t ht00, ht10, ht01, ht11;
+	const Vector2i vertex = p_ptrs.offset + Vector2i(p_x, p_y);
+	if (p_ptrs.height && p_x < region_size - 1 && p_y < region_size - 1) {
+		const float *row0 = p_ptrs.height + p_y * region_size + p_x;
+		ht00 = row0[0];
+		ht10 = row0[1];
+		ht01 = row0[region_size];
+		ht11 = row0[region_size + 1];
+	} else {
+		ht00 = get_vertex_height(vertex);
+		ht10 = get_vertex_height(vertex + Vector2i(1, 0));
+		ht01 = get_vertex_height(vertex + Vector2i(0, 1));
+		ht11 = get_vertex_height(vertex + Vector2i(1, 1));
+	}
+	if (std::isnan(ht00) || std::isnan(ht10) || std::isnan(ht01) || std::isnan(ht11)) {
+		return false;
+	}
+
+	// Surface: h(u, v) = a + b*u + c*v + d*u*v, with u, v in [0, 1] across the quad
+	// Ray: u = u0 + du*t, v = v0 + dv*t, y = y0 + dy*t
+	// Difference: y - h = qa*t^2 + qb*t + qc. Computed in doubles as t can be large.
+	const double a = ht00;
+	const double b = double(ht10) - ht00;
+	const double c = double(ht01) - ht00;
+	const double d = double(ht00) - ht10 - ht01 + ht11;
+	const double u0 = double(p_ray.pos.x) - vertex.x;
+	const double v0 = double(p_ray.pos.y) - vertex.y;
+	const double du = p_ray.dir.x;
+	const double dv = p_ray.dir.y;
+	const double y0 = p_ray.origin.y;
+	const double dy = p_ray.direction.y;
+	const double qa = -d * du * dv;
+	const double qb = dy - b * du - c * dv - d * (u0 * dv + v0 * du);
+	const double qc = y0 - a - b * u0 - c * v0 - d * u0 * v0;
+	auto diff = [&](const double p_t) { return (qa * p_t + qb) * p_t + qc; };
+
+	double t = NAN;
+	if (diff(p_t_min) <= 0.0) {
+		t = p_t_min;
+	} else {
+		double roots[2] = { NAN, NAN };
+		if (Math::abs(qa) < 1e-12) {
+			if (qb != 0.0) {
+				roots[0] = -qc / qb;
+			}
+		} else {
+			const double disc = qb * qb - 4.0 * qa * qc;
+			if (disc >= 0.0) {
+				// Numerically stable form of the quadratic formula
+				const double q = -0.5 * (qb + (qb < 0.0 ? -1.0 : 1.0) * Math::sqrt(disc));
+				roots[0] = q / qa;
+				roots[1] = (q != 0.0) ? qc / q : NAN;
+			}
+		}
+		for (const double root : roots) {
+			if (root >= p_t_min && root <= p_t_max && !(root >= t)) {
+				t = root;
+			}
+		}
+	}
+	if (std::isnan(t)) {
+		return false;
+	}
+
+	const double u = CLAMP(u0 + du * t, 0.0, 1.0);
+	const double v = CLAMP(v0 + dv * t, 0.0, 1.0);
+	r_hit.distance = real_t(t);
+	r_hit.position = p_ray.origin + p_ray.direction * real_t(t);
+	r_hit.normal = Vector3(real_t(-(b + d * v)), vertex_spacing, real_t(-(c + d * u))).normalized();
+	return true;
+}
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+/** Casts a ray against the terrain surface, returning the nearest hit within p_max_distance.
+ * Walks the regions the ray passes over, and in each traverses its height pyramid to reach the
+ * quads the ray may touch, in O(log n) steps per region. Each is intersected exactly with the
+ * bilinear surface used by get_height(). Areas outside of regions or in holes are never hit.
+ */
+bool MapSampler::raycast(const Vector3 &p_origin, const Vector3 &p_direction, const real_t p_max_distance, RayHit &r_hit) const {
+	if (!region_map || region_size <= 0 || p_direction.is_zero_approx() || !(p_max_distance > 0.f)) {
+		return false;
+	}
+	Ray ray;
+	ray.origin = p_origin;
+	ray.direction = p_direction.normalized();
+	ray.pos = Vector2(p_origin.x, p_origin.z) / vertex_spacing;
+	ray.dir = Vector2(ray.direction.x, ray.direction.z) / vertex_spacing;
+
+	// Clip to the area covered by the region map
+	const int half = region_map_size / 2;
+	const Vector2 world_min = Vector2(-half, -half) * real_t(region_size);
+	const Vector2 world_max = Vector2(half, half) * real_t(region_size);
+	real_t t = 0.f;
+	real_t t_end = p_max_distance;
+	if (!ray.clip(world_min, world_max, t, t_end)) {
+		return false;
+	}
+
+	// Step through the regions the ray passes over
+	const Vector2 start = ray.pos + ray.dir * t;
+	Vector2i loc = Vector2i((start / real_t(region_size)).floor()).clamp(Vector2i(-half, -half), Vector2i(half - 1, half - 1));
+	Vector2i step;
+	Vector2 t_next;
+	Vector2 t_delta;
+	for (int axis = 0; axis < 2; axis++) {
+		if (ray.dir[axis] == 0.f) {
+			step[axis] = 0;
+			t_next[axis] = INFINITY;
+			t_delta[axis] = INFINITY;
+			continue;
+		}
+		step[axis] = ray.dir[axis] > 0.f ? 1 : -1;
+		const real_t boundary = real_t(loc[axis] + (step[axis] > 0 ? 1 : 0)) * region_size;
+		t_next[axis] = (boundary - ray.pos[axis]) / ray.dir[axis];
+		t_delta[axis] = real_t(region_size) / Math::abs(ray.dir[axis]);
+	}
+	while (t <= t_end) {
+		const real_t t_exit = MIN(MIN(t_next.x, t_next.y), t_end);
+		const int region_id = get_region_id(loc);
+		if (region_id >= 0 && _raycast_region(ray, region_id, t, t_exit, r_hit)) {
+			return true;
+		}
+		if (t_exit >= t_end) {
+			break;
+		}
+		const int axis = t_next.x < t_next.y ? 0 : 1;
+		loc[axis] += step[axis];
+		t = t_next[axis];
+		t_next[axis] += t_delta[axis];
+		if (loc[axis] < -half || loc[axis] >= half) {
+			break;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,280 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef MAPSAMPLER_CLASS_H
+#define MAPSAMPLER_CLASS_H
+
+#include "constants.h"
+#include "region_map.h"
+#include "sparse_map.h"
+#include "terrain_3d_region.h"
+
+// Vector instruction set used for bilinear interpolation. Others use the scalar fallback.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAPSAMPLER_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MAPSAMPLER_NEON
+#endif
+
+using namespace godot;
+
+class HeightPyramid;
+
+// A non-owning view of the region map and the raw map buffers of each active region, which
+// reads heights, normals and control bits directly from memory.
+// Terrain3DData keeps one over the live maps for use on the main thread, and each DataSnapshot
+// keeps one over its own immutable buffers for use on any thread.
+// Positions are descaled: global position / vertex_spacing, on the XZ plane.
+
+class MapSampler {
+public:
+	struct RegionPtrs {
+		// Only set for live data, to read maps in other formats through the Image API
+		Terrain3DRegion *region = nullptr;
+		Vector2i offset = V2I_ZERO; // region_location * region_size
+		const float *height = nullptr;
+		const uint32_t *control = nullptr;
+		const uint8_t *color = nullptr;
+		// Set instead of the above for maps stored in tiles
+		const SparseMap *sparse_height = nullptr;
+		const SparseMap *sparse_control = nullptr;
+		const HeightPyramid *pyramid = nullptr;
+	};
+
+	struct RayHit {
+		Vector3 position = V3_ZERO;
+		Vector3 normal = Vector3(0.f, 1.f, 0.f);
+		real_t distance = 0.f;
+		int region_id = -1;
+	};
+
+	const int32_t *region_map = nullptr; // Two level map of region_id + 1, 0 = no region. See RegionMap
+	int region_map_size = 0; // Regions per side of the world
+	const RegionPtrs *regions = nullptr; // Indexed by region_id
+	int region_count = 0;
+	int region_size = 0;
+	real_t vertex_spacing = 1.f;
+
+	int get_region_id(const Vector2i &p_region_loc) const;
+	const RegionPtrs *get_region_ptrs(const Vector2 &p_descaled_pos) const;
+	Vector2i get_pixel_position(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const;
+
+	real_t read_height(const RegionPtrs &p_ptrs, const int p_x, const int p_y) const;
+	uint32_t read_control(const RegionPtrs &p_ptrs, const int p_x, const int p_y) const;
+	real_t get_vertex_height(const Vector2i &p_vertex) const;
+
+	static const char *get_simd_name();
+	static real_t bilerp(const float *p_row0, const float *p_row1, const Vector2 &p_weight);
+	static real_t bilerp_scalar(const float *p_row0, const float *p_row1, const Vector2 &p_weight);
+
+	real_t sample_height(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const;
+	real_t sample_height_scalar(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const;
+	real_t get_height(const Vector2 &p_descaled_pos) const;
+	Vector3 sample_normal(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const;
+	uint32_t sample_control(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const;
+	Vector3 get_vertex_normal(const Vector2i &p_vertex) const;
+
+	bool raycast(const Vector3 &p_origin, const Vector3 &p_direction, const real_t p_max_distance, RayHit &r_hit) const;
+
+private:
+	struct Ray;
+	bool _raycast_region(const Ray &p_ray, const int p_region_id, const real_t p_t_min, const real_t p_t_max, RayHit &r_hit) const;
+	bool _raycast_cell(const Ray &p_ray, const RegionPtrs &p_ptrs, const int p_x, const int p_y, const real_t p_t_min, const real_t p_t_max, RayHit &r_hit) const;
+};
+
+// Inline Functions
+
+// Returns id of any active region. -1 if out of bounds or no region
+inline int MapSampler::get_region_id(const Vector2i &p_region_loc) const {
+	// Offset world to positive values only
+	Vector2i loc = p_region_loc + Vector2i(region_map_size / 2, region_map_size / 2);
+	if (uint32_t(loc.x) >= uint32_t(region_map_size) || uint32_t(loc.y) >= uint32_t(region_map_size)) {
+		return -1;
+	}
+	int region_id = RegionMap::get_entry(region_map, loc) - 1; // 0 = no region
+	return (region_id >= 0 && region_id < region_count) ? region_id : -1;
+}
+
+// Returns the pointers of the active region containing the position, or nullptr if none.
+inline const MapSampler::RegionPtrs *MapSampler::get_region_ptrs(const Vector2 &p_descaled_pos) const {
+	int region_id = get_region_id(Vector2i((p_descaled_pos / real_t(region_size)).floor()));
+	if (region_id < 0) {
+		return nullptr;
+	}
+	const RegionPtrs *ptrs = &regions[region_id];
+	if (ptrs->region && ptrs->region->is_deleted()) {
+		return nullptr;
+	}
+	return ptrs;
+}
+
+// Returns the pixel containing the position, clamped to the region
+inline Vector2i MapSampler::get_pixel_position(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const {
+	Vector2i img_pos = Vector2i(p_descaled_pos.x - p_ptrs.offset.x, p_descaled_pos.y - p_ptrs.offset.y);
+	return img_pos.clamp(V2I_ZERO, Vector2i(region_size - 1, region_size - 1));
+}
+
+inline real_t MapSampler::read_height(const RegionPtrs &p_ptrs, const int p_x, const int p_y) const {
+	if (p_ptrs.height) {
+		return p_ptrs.height[p_y * region_size + p_x];
+	}
+	if (p_ptrs.sparse_height) {
+		return p_ptrs.sparse_height->get_float(p_x, p_y);
+	}
+	Image *map = p_ptrs.region ? p_ptrs.region->get_map_ptr(TYPE_HEIGHT) : nullptr;
+	return map ? real_t(map->get_pixel(p_x, p_y).r) : NAN;
+}
+
+inline uint32_t MapSampler::read_control(const RegionPtrs &p_ptrs, const int p_x, const int p_y) const {
+	if (p_ptrs.control) {
+		return p_ptrs.control[p_y * region_size + p_x];
+	}
+	if (p_ptrs.sparse_control) {
+		return p_ptrs.sparse_control->get_bits(p_x, p_y);
+	}
+	Image *map = p_ptrs.region ? p_ptrs.region->get_map_ptr(TYPE_CONTROL) : nullptr;
+	return map ? as_uint(map->get_pixel(p_x, p_y).r) : UINT32_MAX;
+}
+
+// Returns the height of a vertex in descaled coordinates, from whichever region holds it
+inline real_t MapSampler::get_vertex_height(const Vector2i &p_vertex) const {
+	const RegionPtrs *ptrs = get_region_ptrs(Vector2(p_vertex));
+	if (!ptrs) {
+		return NAN;
+	}
+	Vector2i img_pos = p_vertex - ptrs->offset;
+	return read_height(*ptrs, img_pos.x, img_pos.y);
+}
+
+inline const char *MapSampler::get_simd_name() {
+#if defined(MAPSAMPLER_SSE2)
+	return "SSE2";
+#elif defined(MAPSAMPLER_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+// Bilinearly interpolates the quad of heights {row0[0], row0[1], row1[0], row1[1]}.
+// Both rows are lerped along X in one vector operation, then the result along Y.
+inline real_t MapSampler::bilerp(const float *p_row0, const float *p_row1, const Vector2 &p_weight) {
+#if defined(MAPSAMPLER_SSE2)
+	const __m128 row0 = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(p_row0)));
+	const __m128 row1 = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(p_row1)));
+	const __m128 quad = _mm_movelh_ps(row0, row1); // h00, h10, h01, h11
+	const __m128 left = _mm_shuffle_ps(quad, quad, _MM_SHUFFLE(2, 0, 2, 0)); // h00, h01
+	const __m128 right = _mm_shuffle_ps(quad, quad, _MM_SHUFFLE(3, 1, 3, 1)); // h10, h11
+	const __m128 rows = _mm_add_ps(left, _mm_mul_ps(_mm_sub_ps(right, left), _mm_set1_ps(float(p_weight.x))));
+	const float top = _mm_cvtss_f32(rows);
+	const float bottom = _mm_cvtss_f32(_mm_shuffle_ps(rows, rows, _MM_SHUFFLE(1, 1, 1, 1)));
+	return Math::lerp(real_t(top), real_t(bottom), p_weight.y);
+#elif defined(MAPSAMPLER_NEON)
+	const float32x2x2_t cols = vtrn_f32(vld1_f32(p_row0), vld1_f32(p_row1)); // {h00, h01}, {h10, h11}
+	const float32x2_t rows = vmla_n_f32(cols.val[0], vsub_f32(cols.val[1], cols.val[0]), float(p_weight.x));
+	return Math::lerp(real_t(vget_lane_f32(rows, 0)), real_t(vget_lane_f32(rows, 1)), p_weight.y);
+#else
+	return bilerp_scalar(p_row0, p_row1, p_weight);
+#endif
+}
+
+inline real_t MapSampler::bilerp_scalar(const float *p_row0, const float *p_row1, const Vector2 &p_weight) {
+	return Math::lerp(Math::lerp(real_t(p_row0[0]), real_t(p_row0[1]), p_weight.x),
+			Math::lerp(real_t(p_row1[0]), real_t(p_row1[1]), p_weight.x), p_weight.y);
+}
+
+// Returns the height at a position within the region of p_ptrs, or NAN on a hole. If the position
+// is close to a vertex, its height is returned, otherwise the 4 surrounding vertices are bilinearly
+// interpolated. The quad and its control bits are read straight from memory when the quad lies
+// entirely within the region, which is all but the last row and column. Those fall back to
+// sample_height_scalar().
+inline real_t MapSampler::sample_height(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const {
+	const Vector2 pos_floor = p_descaled_pos.floor();
+	const Vector2i pos00 = Vector2i(pos_floor) - p_ptrs.offset;
+	if (!p_ptrs.height || !p_ptrs.control ||
+			uint32_t(pos00.x) >= uint32_t(region_size - 1) || uint32_t(pos00.y) >= uint32_t(region_size - 1)) {
+		return sample_height_scalar(p_ptrs, p_descaled_pos);
+	}
+	const int index = pos00.y * region_size + pos00.x;
+	const float *row0 = p_ptrs.height + index;
+	const float *row1 = row0 + region_size;
+	const Vector2 weight = p_descaled_pos - pos_floor;
+	// The nearest vertex is always one of this quad
+	const Vector2 weight_round = weight.round();
+	const bool on_vertex = ((weight - weight_round) * vertex_spacing).length_squared() < 0.0001f;
+	const real_t vertex_height = (weight_round.y > 0.f ? row1 : row0)[weight_round.x > 0.f ? 1 : 0];
+	const real_t height = on_vertex ? vertex_height : bilerp(row0, row1, weight);
+	return is_hole(p_ptrs.control[index]) ? real_t(NAN) : height;
+}
+
+// Reference implementation of sample_height(), which looks up each vertex of the quad individually
+// so it can span regions, and reads maps in unexpected formats through the Image API.
+inline real_t MapSampler::sample_height_scalar(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const {
+	Vector2i img_pos = get_pixel_position(p_ptrs, p_descaled_pos);
+	if (is_hole(read_control(p_ptrs, img_pos.x, img_pos.y))) {
+		return NAN;
+	}
+	const Vector2 pos_round = p_descaled_pos.round();
+	if (((p_descaled_pos - pos_round) * vertex_spacing).length_squared() < 0.0001f) {
+		return get_vertex_height(Vector2i(pos_round));
+	}
+	const Vector2 pos_floor = p_descaled_pos.floor();
+	const Vector2i vertex00 = Vector2i(pos_floor);
+	const float quad[4] = {
+		float(get_vertex_height(vertex00)),
+		float(get_vertex_height(vertex00 + Vector2i(1, 0))),
+		float(get_vertex_height(vertex00 + Vector2i(0, 1))),
+		float(get_vertex_height(vertex00 + Vector2i(1, 1))),
+	};
+	return bilerp_scalar(quad, quad + 2, p_descaled_pos - pos_floor);
+}
+
+inline real_t MapSampler::get_height(const Vector2 &p_descaled_pos) const {
+	const RegionPtrs *ptrs = get_region_ptrs(p_descaled_pos);
+	return ptrs ? sample_height(*ptrs, p_descaled_pos) : NAN;
+}
+
+// Returns the normal at a position within the region of p_ptrs, or NANs on a hole
+inline Vector3 MapSampler::sample_normal(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const {
+	real_t height = sample_height(p_ptrs, p_descaled_pos);
+	if (std::isnan(height)) {
+		return Vector3(NAN, NAN, NAN);
+	}
+	// Neighbors may be in the next region
+	real_t u = height - get_height(p_descaled_pos + Vector2(1.f, 0.f));
+	real_t v = height - get_height(p_descaled_pos + Vector2(0.f, 1.f));
+	return Vector3(u, vertex_spacing, v).normalized();
+}
+
+// Returns the control bits of the pixel containing the position, or UINT32_MAX if invalid
+inline uint32_t MapSampler::sample_control(const RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) const {
+	Vector2i img_pos = get_pixel_position(p_ptrs, p_descaled_pos);
+	uint32_t control = read_control(p_ptrs, img_pos.x, img_pos.y);
+	return std::isnan(as_float(control)) ? UINT32_MAX : control;
+}
+
+// Returns the normal of a vertex from its height and those of its +X and +Z neighbors. Unlike
+// sample_normal(), holes are ignored and missing neighbors read as 0, so slopes can be evaluated
+// up to the edges of holes and regions.
+inline Vector3 MapSampler::get_vertex_normal(const Vector2i &p_vertex) const {
+	real_t height, height_x, height_z;
+	const RegionPtrs *ptrs = get_region_ptrs(Vector2(p_vertex));
+	const Vector2i img_pos = ptrs ? p_vertex - ptrs->offset : V2I_MAX;
+	if (ptrs && ptrs->height && img_pos.x < region_size - 1 && img_pos.y < region_size - 1) {
+		const float *row0 = ptrs->height + img_pos.y * region_size + img_pos.x;
+		height = row0[0];
+		height_x = row0[1];
+		height_z = row0[region_size];
+	} else {
+		height = get_vertex_height(p_vertex);
+		height_x = get_vertex_height(p_vertex + Vector2i(1, 0));
+		height_z = get_vertex_height(p_vertex + Vector2i(0, 1));
+	}
+	height = std::isnan(height) ? 0.f : height;
+	height_x = std::isnan(height_x) ? 0.f : height_x;
+	height_z = std::isnan(height_z) ? 0.f : height_z;
+	return Vector3(height - height_x, vertex_spacing, height - height_z).normalized();
+}
+
+#endif // MAPSAMPLER_CLASS_H
@@ -0,0 +1,100 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <godot_cpp/classes/project_settings.hpp>
+
+#include "logger.h"
+#include "mapped_file.h"
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+// Maps the file at p_path, which must be a file on disk rather than inside a pack file
+Error MappedFile::open(const String &p_path) {
+	close();
+	const String path = ProjectSettings::get_singleton()->globalize_path(p_path);
+#ifdef _WIN32
+	HANDLE file = CreateFileW((LPCWSTR)path.wide_string().get_data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		LOG(DEBUG, "Cannot open file: ", path);
+		return ERR_FILE_CANT_OPEN;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+		CloseHandle(file);
+		return ERR_FILE_CORRUPT;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		LOG(DEBUG, "Cannot map file: ", path);
+		return ERR_FILE_CANT_READ;
+	}
+	const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		LOG(DEBUG, "Cannot map file: ", path);
+		return ERR_FILE_CANT_READ;
+	}
+	_file = file;
+	_mapping = mapping;
+	_data = reinterpret_cast<const uint8_t *>(data);
+	_size = uint64_t(size.QuadPart);
+#else
+	const int fd = ::open(path.utf8().get_data(), O_RDONLY);
+	if (fd < 0) {
+		LOG(DEBUG, "Cannot open file: ", path);
+		return ERR_FILE_CANT_OPEN;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+		::close(fd);
+		return ERR_FILE_CORRUPT;
+	}
+	void *data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid without the descriptor
+	::close(fd);
+	if (data == MAP_FAILED) {
+		LOG(DEBUG, "Cannot map file: ", path);
+		return ERR_FILE_CANT_READ;
+	}
+	_data = reinterpret_cast<const uint8_t *>(data);
+	_size = uint64_t(info.st_size);
+#endif
+	LOG(DEBUG, "Mapped ", _size, " bytes of ", path);
+	return OK;
+}
+
+void MappedFile::close() {
+	if (!_data) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle((HANDLE)_mapping);
+	CloseHandle((HANDLE)_file);
+	_mapping = nullptr;
+	_file = nullptr;
+#else
+	munmap(const_cast<uint8_t *>(_data), size_t(_size));
+#endif
+	_data = nullptr;
+	_size = 0;
+}
@@ -0,0 +1,39 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef MAPPEDFILE_CLASS_H
+#define MAPPEDFILE_CLASS_H
+
+#include "constants.h"
+
+using namespace godot;
+
+// A read only memory mapping of a whole file, using mmap() or MapViewOfFile(). Pages are read
+// from disk on first access and live in the OS page cache, which is shared by every process
+// mapping the same file. The mapping is released when this is destroyed, so anything reading
+// from it keeps a shared_ptr to it.
+
+class MappedFile {
+	CLASS_NAME_STATIC("Terrain3DMappedFile");
+
+private:
+	const uint8_t *_data = nullptr;
+	uint64_t _size = 0;
+#ifdef _WIN32
+	void *_file = nullptr;
+	void *_mapping = nullptr;
+#endif
+
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	Error open(const String &p_path);
+	void close();
+	bool is_open() const { return _data != nullptr; }
+	const uint8_t *get_data() const { return _data; }
+	uint64_t get_size() const { return _size; }
+};
+
+#endif // MAPPEDFILE_CLASS_H
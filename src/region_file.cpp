@@ -0,0 +1,440 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include <cstring>
+#include <vector>
+
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+
+#include "logger.h"
+#include "mapped_file.h"
+#include "region_file.h"
+#include "terrain_3d_util.h"
+
+static const char *MAP_KEY[] = {
+	"height_map", // TYPE_HEIGHT
+	"control_map", // TYPE_CONTROL
+	"color_map", // TYPE_COLOR
+};
+
+static inline uint64_t align_offset(const uint64_t p_offset) {
+	return (p_offset + RegionFile::ALIGNMENT - 1) & ~(RegionFile::ALIGNMENT - 1);
+}
+
+///////////////////////////
+// Private Functions
+///////////////////////////
+
+// Filters a map for compression, and fills in the chunk header describing it. Maps in formats
+// other than those sanitize_map() produces are stored as is.
+PackedByteArray RegionFile::_encode_map(const MapType p_type, const Ref<Image> &p_map, const real_t p_height_step, ChunkHeader &r_chunk) {
+	const int width = p_map->get_width();
+	const int height = p_map->get_height();
+	const int64_t count = int64_t(width) * height;
+	r_chunk.type = p_type;
+	r_chunk.format = p_map->get_format();
+	r_chunk.width = width;
+	r_chunk.height = height;
+	r_chunk.mipmaps = p_map->has_mipmaps();
+	const PackedByteArray data = p_map->get_data();
+	PackedByteArray out;
+
+	if (p_type == TYPE_HEIGHT && r_chunk.format == Image::FORMAT_RF && !r_chunk.mipmaps) {
+		const float *heights = reinterpret_cast<const float *>(data.ptr());
+		std::vector<uint32_t> values(count);
+		if (p_height_step > 0.f) {
+			float low = INFINITY;
+			for (int64_t i = 0; i < count; i++) {
+				if (heights[i] < low) {
+					low = heights[i];
+				}
+			}
+			low = std::isfinite(low) ? low : 0.f;
+			for (int64_t i = 0; i < count; i++) {
+				const double steps = std::isnan(heights[i]) ? 0.0 : Math::round((double(heights[i]) - low) / p_height_step);
+				values[i] = uint32_t(CLAMP(steps, 0.0, double(INT32_MAX)));
+			}
+			r_chunk.encoding = ENCODING_HEIGHT_QUANTIZED;
+			r_chunk.base = low;
+			r_chunk.step = p_height_step;
+		} else {
+			memcpy(values.data(), heights, count * sizeof(uint32_t));
+			r_chunk.encoding = ENCODING_HEIGHT_BITS;
+		}
+		out.resize(count * sizeof(uint32_t));
+		encode_deltas(values.data(), width, height, out.ptrw());
+
+	} else if (p_type == TYPE_CONTROL && r_chunk.format == Image::FORMAT_RF && !r_chunk.mipmaps) {
+		const uint32_t *pixels = reinterpret_cast<const uint32_t *>(data.ptr());
+		out.resize(count * 5);
+		uint8_t *planes = out.ptrw();
+		for (int64_t i = 0; i < count; i++) {
+			const uint32_t pixel = pixels[i];
+			planes[i] = pixel >> 27; // Base
+			planes[count + i] = (pixel >> 22) & 0x1F; // Overlay
+			planes[count * 2 + i] = (pixel >> 14) & 0xFF; // Blend
+			planes[count * 3 + i] = (pixel >> 7) & 0x7F; // UV rotation and scale
+			planes[count * 4 + i] = pixel & 0x7F; // Hole, navigation, autoshader and unused bits
+		}
+		r_chunk.encoding = ENCODING_CONTROL_FIELDS;
+
+	} else if (p_type == TYPE_COLOR && r_chunk.format == Image::FORMAT_RGBA8) {
+		out.resize(data.size());
+		_split_planes(data.ptr(), data.size() / 4, 4, out.ptrw());
+		r_chunk.encoding = ENCODING_BYTE_PLANES;
+
+	} else {
+		out = data;
+		r_chunk.encoding = ENCODING_RAW;
+	}
+	return out;
+}
+
+// Reverses _encode_map() on decompressed chunk data. Returns null if the data doesn't fit the header.
+Ref<Image> RegionFile::_decode_map(const ChunkHeader &p_chunk, const PackedByteArray &p_data) {
+	const int width = int(p_chunk.width);
+	const int height = int(p_chunk.height);
+	const int64_t count = int64_t(width) * height;
+	PackedByteArray data;
+
+	switch (p_chunk.encoding) {
+		case ENCODING_RAW: {
+			data = p_data;
+		} break;
+		case ENCODING_HEIGHT_QUANTIZED:
+		case ENCODING_HEIGHT_BITS: {
+			if (p_data.size() != count * int64_t(sizeof(uint32_t))) {
+				return Ref<Image>();
+			}
+			data.resize(p_data.size());
+			uint32_t *values = reinterpret_cast<uint32_t *>(data.ptrw());
+			decode_deltas(p_data.ptr(), width, height, values);
+			if (p_chunk.encoding == ENCODING_HEIGHT_QUANTIZED) {
+				for (int64_t i = 0; i < count; i++) {
+					values[i] = as_uint(p_chunk.base + float(int32_t(values[i])) * p_chunk.step);
+				}
+			}
+		} break;
+		case ENCODING_CONTROL_FIELDS: {
+			if (p_data.size() != count * 5) {
+				return Ref<Image>();
+			}
+			data.resize(count * sizeof(uint32_t));
+			uint32_t *pixels = reinterpret_cast<uint32_t *>(data.ptrw());
+			const uint8_t *planes = p_data.ptr();
+			for (int64_t i = 0; i < count; i++) {
+				pixels[i] = uint32_t(planes[i]) << 27 |
+						uint32_t(planes[count + i]) << 22 |
+						uint32_t(planes[count * 2 + i]) << 14 |
+						uint32_t(planes[count * 3 + i]) << 7 |
+						uint32_t(planes[count * 4 + i]);
+			}
+		} break;
+		case ENCODING_BYTE_PLANES: {
+			if (p_data.size() % 4 != 0) {
+				return Ref<Image>();
+			}
+			data.resize(p_data.size());
+			_join_planes(p_data.ptr(), p_data.size() / 4, 4, data.ptrw());
+		} break;
+		default:
+			return Ref<Image>();
+	}
+	Ref<Image> map = Image::create_from_data(width, height, p_chunk.mipmaps != 0, Image::Format(p_chunk.format), data);
+	return (map.is_valid() && !map->is_empty()) ? map : Ref<Image>();
+}
+
+// Gathers byte n of each p_stride sized element into plane n
+void RegionFile::_split_planes(const uint8_t *p_src, const int64_t p_count, const int p_stride, uint8_t *r_dst) {
+	for (int plane = 0; plane < p_stride; plane++) {
+		uint8_t *dst = r_dst + plane * p_count;
+		for (int64_t i = 0; i < p_count; i++) {
+			dst[i] = p_src[i * p_stride + plane];
+		}
+	}
+}
+
+void RegionFile::_join_planes(const uint8_t *p_src, const int64_t p_count, const int p_stride, uint8_t *r_dst) {
+	for (int plane = 0; plane < p_stride; plane++) {
+		const uint8_t *src = p_src + plane * p_count;
+		for (int64_t i = 0; i < p_count; i++) {
+			r_dst[i * p_stride + plane] = src[i];
+		}
+	}
+}
+
+// Decodes a region from p_size bytes at p_data. With p_file, the data is that mapping, and height
+// and control maps stored raw in the expected format are read from it instead of being copied.
+Ref<Terrain3DRegion> RegionFile::_decode(const uint8_t *p_data, const uint64_t p_size, const std::shared_ptr<const MappedFile> &p_file) {
+	FileHeader header;
+	if (p_size < sizeof(FileHeader)) {
+		LOG(ERROR, "Region file is too small: ", p_size, " bytes");
+		return Ref<Terrain3DRegion>();
+	}
+	memcpy(&header, p_data, sizeof(FileHeader));
+	if (header.magic != MAGIC) {
+		LOG(ERROR, "Not a region file");
+		return Ref<Terrain3DRegion>();
+	}
+	if (header.version > VERSION) {
+		LOG(ERROR, "Unsupported region file version ", header.version, ". Max: ", VERSION);
+		return Ref<Terrain3DRegion>();
+	}
+	if (p_size < sizeof(FileHeader) + sizeof(ChunkHeader) * uint64_t(header.chunk_count)) {
+		LOG(ERROR, "Region file is truncated");
+		return Ref<Terrain3DRegion>();
+	}
+
+	Dictionary dict;
+	dict["version"] = header.data_version;
+	dict["region_size"] = header.region_size;
+	dict["vertex_spacing"] = header.vertex_spacing;
+	dict["location"] = Vector2i(header.location_x, header.location_y);
+	dict["height_range"] = Vector2(header.height_min, header.height_max);
+	const uint8_t *mapped[TYPE_MAX] = {};
+	for (uint32_t i = 0; i < header.chunk_count; i++) {
+		ChunkHeader chunk;
+		memcpy(&chunk, p_data + sizeof(FileHeader) + sizeof(ChunkHeader) * i, sizeof(ChunkHeader));
+		if (chunk.offset > p_size || chunk.stored_size > p_size - chunk.offset) {
+			LOG(ERROR, "Region file chunk ", i, " is out of bounds");
+			return Ref<Terrain3DRegion>();
+		}
+		if (chunk.type >= CHUNK_MAX) {
+			LOG(WARN, "Skipping unknown region file chunk type ", chunk.type);
+			continue;
+		}
+		if (p_file && (chunk.type == CHUNK_HEIGHT || chunk.type == CHUNK_CONTROL) &&
+				chunk.encoding == ENCODING_RAW && chunk.compression == COMPRESSION_NONE &&
+				chunk.format == uint32_t(FORMAT[chunk.type]) && chunk.mipmaps == 0 &&
+				int(chunk.width) == header.region_size && int(chunk.height) == header.region_size &&
+				chunk.stored_size == uint64_t(chunk.width) * chunk.height * sizeof(uint32_t) && chunk.offset % ALIGNMENT == 0) {
+			mapped[chunk.type] = p_data + chunk.offset;
+			continue;
+		}
+		PackedByteArray payload;
+		payload.resize(chunk.stored_size);
+		memcpy(payload.ptrw(), p_data + chunk.offset, chunk.stored_size);
+		if (chunk.compression == COMPRESSION_ZSTD) {
+			payload = payload.decompress(chunk.raw_size, FileAccess::COMPRESSION_ZSTD);
+		}
+		if (uint64_t(payload.size()) != chunk.raw_size) {
+			LOG(ERROR, "Cannot decompress region file chunk ", i);
+			return Ref<Terrain3DRegion>();
+		}
+		if (chunk.type == CHUNK_INSTANCES) {
+			// Version 1 stored the nested Dictionary of Terrain3DRegion::get_instances()
+			dict[header.version < 2 ? "instances" : "instance_data"] = UtilityFunctions::bytes_to_var(payload);
+			continue;
+		}
+		Ref<Image> map = _decode_map(chunk, payload);
+		if (map.is_null()) {
+			LOG(ERROR, "Cannot decode ", TYPESTR[chunk.type], " in region file chunk ", i);
+			return Ref<Terrain3DRegion>();
+		}
+		dict[MAP_KEY[chunk.type]] = map;
+	}
+
+	Ref<Terrain3DRegion> region;
+	region.instantiate();
+	region->set_data(dict);
+	for (int i = 0; i < TYPE_MAX; i++) {
+		if (mapped[i]) {
+			region->set_mapped_map(MapType(i), p_file, mapped[i]);
+		}
+	}
+	return region;
+}
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+/** Encodes a region into the contents of a region file.
+ *	p_height_step - quantizes heights to multiples of this many meters. 0 keeps them lossless.
+ *	p_mappable - stores the height and control maps raw and uncompressed, so map() can read them
+ *		directly from the file. p_height_step is then ignored.
+ */
+PackedByteArray RegionFile::encode(const Terrain3DRegion *p_region, const real_t p_height_step, const bool p_mappable) {
+	if (!p_region) {
+		LOG(ERROR, "Region is null");
+		return PackedByteArray();
+	}
+	FileHeader header;
+	header.region_size = p_region->get_region_size();
+	header.vertex_spacing = p_region->get_vertex_spacing();
+	header.data_version = p_region->get_version();
+	header.location_x = p_region->get_location().x;
+	header.location_y = p_region->get_location().y;
+	header.height_min = p_region->get_height_range().x;
+	header.height_max = p_region->get_height_range().y;
+	header.flags = p_mappable ? FLAG_MAPPABLE : 0;
+
+	std::vector<ChunkHeader> chunks;
+	std::vector<PackedByteArray> payloads;
+	for (int i = 0; i < TYPE_MAX; i++) {
+		const Ref<Image> map = p_region->read_map(MapType(i));
+		if (map.is_null() || map->is_empty()) {
+			continue;
+		}
+		ChunkHeader chunk;
+		if (p_mappable && i != TYPE_COLOR) {
+			chunk.type = i;
+			chunk.format = map->get_format();
+			chunk.width = map->get_width();
+			chunk.height = map->get_height();
+			chunk.mipmaps = map->has_mipmaps();
+			payloads.push_back(map->get_data());
+		} else {
+			payloads.push_back(_encode_map(MapType(i), map, p_height_step, chunk));
+		}
+		chunks.push_back(chunk);
+	}
+	if (!p_region->get_instances_ptr()->is_empty()) {
+		ChunkHeader chunk;
+		chunk.type = CHUNK_INSTANCES;
+		payloads.push_back(UtilityFunctions::var_to_bytes(p_region->get_instance_data()));
+		chunks.push_back(chunk);
+	}
+
+	// Compress each chunk, keeping the original if it doesn't shrink, then lay them out
+	header.chunk_count = uint32_t(chunks.size());
+	uint64_t offset = sizeof(FileHeader) + sizeof(ChunkHeader) * chunks.size();
+	for (size_t i = 0; i < chunks.size(); i++) {
+		chunks[i].raw_size = payloads[i].size();
+		if (p_mappable && (chunks[i].type == CHUNK_HEIGHT || chunks[i].type == CHUNK_CONTROL)) {
+			chunks[i].stored_size = payloads[i].size();
+			offset = align_offset(offset);
+			chunks[i].offset = offset;
+			offset += chunks[i].stored_size;
+			continue;
+		}
+		PackedByteArray compressed = payloads[i].compress(FileAccess::COMPRESSION_ZSTD);
+		if (!compressed.is_empty() && compressed.size() < payloads[i].size()) {
+			payloads[i] = compressed;
+			chunks[i].compression = COMPRESSION_ZSTD;
+		}
+		chunks[i].stored_size = payloads[i].size();
+		offset = align_offset(offset);
+		chunks[i].offset = offset;
+		offset += chunks[i].stored_size;
+	}
+
+	PackedByteArray data;
+	data.resize(offset);
+	data.fill(0);
+	uint8_t *dst = data.ptrw();
+	memcpy(dst, &header, sizeof(FileHeader));
+	for (size_t i = 0; i < chunks.size(); i++) {
+		memcpy(dst + sizeof(FileHeader) + sizeof(ChunkHeader) * i, &chunks[i], sizeof(ChunkHeader));
+		memcpy(dst + chunks[i].offset, payloads[i].ptr(), chunks[i].stored_size);
+	}
+	return data;
+}
+
+// Decodes the contents of a region file into a new region. Returns null on invalid data.
+Ref<Terrain3DRegion> RegionFile::decode(const PackedByteArray &p_data) {
+	return _decode(p_data.ptr(), p_data.size(), nullptr);
+}
+
+/** Writes a region file, first to a temporary file in the same directory which then replaces
+ * p_path, like Terrain3DRegion::write(). Safe to call from worker threads.
+ *	r_bytes - if not null, receives the size of the written file
+ */
+Error RegionFile::save(const Terrain3DRegion *p_region, const String &p_path, const real_t p_height_step, const bool p_mappable, uint64_t *r_bytes) {
+	const PackedByteArray data = encode(p_region, p_height_step, p_mappable);
+	if (data.is_empty()) {
+		return ERR_INVALID_DATA;
+	}
+	String temp_path = ProjectSettings::get_singleton()->globalize_path(p_path.get_base_dir().path_join(".tmp-" + p_path.get_file()));
+	Ref<FileAccess> file = FileAccess::open(temp_path, FileAccess::WRITE);
+	Error err = FileAccess::get_open_error();
+	if (file.is_valid()) {
+		file->store_buffer(data);
+		err = file->get_error();
+		file->close();
+	}
+	if (err != OK) {
+		LOG(ERROR, "Cannot write temporary file: ", temp_path, ", error: ", UtilityFunctions::error_string(err));
+		DirAccess::remove_absolute(temp_path);
+		return err;
+	}
+	if (r_bytes) {
+		*r_bytes = data.size();
+	}
+	err = DirAccess::rename_absolute(temp_path, p_path);
+	if (err != OK) {
+		LOG(ERROR, "Cannot replace file: ", p_path, ", error: ", UtilityFunctions::error_string(err));
+		DirAccess::remove_absolute(temp_path);
+	}
+	return err;
+}
+
+Ref<Terrain3DRegion> RegionFile::load(const String &p_path) {
+	const PackedByteArray data = FileAccess::get_file_as_bytes(p_path);
+	if (data.is_empty()) {
+		LOG(ERROR, "Cannot read region file: ", p_path, ", error: ", UtilityFunctions::error_string(FileAccess::get_open_error()));
+		return Ref<Terrain3DRegion>();
+	}
+	Ref<Terrain3DRegion> region = decode(data);
+	if (region.is_null()) {
+		LOG(ERROR, "Invalid region file: ", p_path);
+		return region;
+	}
+	LOG(DEBUG, "Loaded region ", region->get_location(), " from ", p_path, ", ", data.size(), " bytes");
+	return region;
+}
+
+/** Loads a region file, reading its height and control maps directly from a read only memory
+ * mapping of the file if it was written as mappable. Other maps and instances are decoded into
+ * memory. Falls back to load() if the file cannot be mapped, such as inside a pack file.
+ */
+Ref<Terrain3DRegion> RegionFile::map(const String &p_path) {
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (file->open(p_path) != OK) {
+		LOG(WARN, "Cannot memory map ", p_path, ". Loading it into memory instead");
+		return load(p_path);
+	}
+	Ref<Terrain3DRegion> region = _decode(file->get_data(), file->get_size(), file);
+	if (region.is_null()) {
+		LOG(ERROR, "Invalid region file: ", p_path);
+		return region;
+	}
+	if (!region->is_mapped()) {
+		LOG(WARN, "Region file ", p_path, " is not mappable. Its maps were loaded into memory");
+	}
+	LOG(DEBUG, "Mapped region ", region->get_location(), " from ", p_path);
+	return region;
+}
+
+// Stores each value as the zigzag encoded difference from the one to its left, or above for the
+// first column, split into byte planes. Smooth terrain leaves mostly small deltas, whose high
+// byte planes are nearly all zeros and compress to almost nothing.
+void RegionFile::encode_deltas(const uint32_t *p_values, const int p_width, const int p_height, uint8_t *r_planes) {
+	const int64_t count = int64_t(p_width) * p_height;
+	std::vector<uint32_t> zigzag(count);
+	for (int y = 0; y < p_height; y++) {
+		const int64_t row = int64_t(y) * p_width;
+		for (int x = 0; x < p_width; x++) {
+			const int64_t i = row + x;
+			const uint32_t prev = (x > 0) ? p_values[i - 1] : ((y > 0) ? p_values[i - p_width] : 0);
+			const int32_t delta = int32_t(p_values[i] - prev);
+			zigzag[i] = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+		}
+	}
+	_split_planes(reinterpret_cast<const uint8_t *>(zigzag.data()), count, sizeof(uint32_t), r_planes);
+}
+
+void RegionFile::decode_deltas(const uint8_t *p_planes, const int p_width, const int p_height, uint32_t *r_values) {
+	const int64_t count = int64_t(p_width) * p_height;
+	_join_planes(p_planes, count, sizeof(uint32_t), reinterpret_cast<uint8_t *>(r_values));
+	for (int y = 0; y < p_height; y++) {
+		const int64_t row = int64_t(y) * p_width;
+		uint32_t prev = (y > 0) ? r_values[row - p_width] : 0;
+		for (int x = 0; x < p_width; x++) {
+			const uint32_t zigzag = r_values[row + x];
+			prev += (zigzag >> 1) ^ (0u - (zigzag & 1));
+			r_values[row + x] = prev;
+		}
+	}
+}
@@ -0,0 +1,116 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef REGIONFILE_CLASS_H
+#define REGIONFILE_CLASS_H
+
+#include <memory>
+
+#include "constants.h"
+#include "terrain_3d_region.h"
+
+class MappedFile;
+
+using namespace godot;
+
+// Reads and writes regions in a compact binary format, an alternative to the Resource files.
+// A file header and a table of chunk headers are followed by the chunk data, each chunk starting
+// on a 64 byte boundary. There is one chunk per map and one for the instances. Each is filtered
+// to suit its data, then compressed with zstd:
+// - Height: quantized to a step, or the raw float bits if lossless, stored as zigzag deltas from
+//   the pixel to the left, then split into byte planes
+// - Control: split into one byte plane per bit field, see terrain_3d_util.h
+// - Color: split into RGBA byte planes, including the mipmaps
+// - Instances: serialized Variant data of Terrain3DRegion::get_instance_data(), or of
+//   get_instances() in version 1
+// Mappable files instead store the height and control maps raw and uncompressed, so they can be
+// read directly from a memory mapping of the file.
+// All values are little endian.
+
+class RegionFile {
+	CLASS_NAME_STATIC("Terrain3DRegionFile");
+
+public: // Constants
+	static inline const char *EXTENSION = "t3dr";
+	static constexpr uint32_t MAGIC = 0x52443354; // "T3DR"
+	static constexpr uint16_t VERSION = 2;
+	static constexpr uint64_t ALIGNMENT = 64;
+
+	enum Flags : uint16_t {
+		FLAG_MAPPABLE = 1 << 0, // Height and control maps are stored raw
+	};
+
+	enum ChunkType : uint32_t {
+		CHUNK_HEIGHT = TYPE_HEIGHT,
+		CHUNK_CONTROL = TYPE_CONTROL,
+		CHUNK_COLOR = TYPE_COLOR,
+		CHUNK_INSTANCES,
+		CHUNK_MAX,
+	};
+
+	enum Encoding : uint32_t {
+		ENCODING_RAW, // Image or Variant data as is
+		ENCODING_HEIGHT_QUANTIZED, // Deltas of round((height - base) / step)
+		ENCODING_HEIGHT_BITS, // Deltas of the float bits
+		ENCODING_CONTROL_FIELDS, // Planes of base, overlay, blend, uv rotation | scale, flags
+		ENCODING_BYTE_PLANES, // Planes of each byte of 4 byte pixels
+	};
+
+	enum Compression : uint32_t {
+		COMPRESSION_NONE,
+		COMPRESSION_ZSTD,
+	};
+
+	struct FileHeader { // 64 bytes
+		uint32_t magic = MAGIC;
+		uint16_t version = VERSION;
+		uint16_t flags = 0;
+		uint32_t chunk_count = 0;
+		int32_t region_size = 0;
+		float vertex_spacing = 1.f;
+		float data_version = 0.f;
+		int32_t location_x = 0;
+		int32_t location_y = 0;
+		float height_min = 0.f;
+		float height_max = 0.f;
+		uint32_t reserved[6] = {};
+	};
+
+	struct ChunkHeader { // 64 bytes
+		uint32_t type = CHUNK_MAX;
+		uint32_t encoding = ENCODING_RAW;
+		uint32_t compression = COMPRESSION_NONE;
+		uint32_t format = 0; // Image::Format
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipmaps = 0;
+		float base = 0.f; // Lowest height, for ENCODING_HEIGHT_QUANTIZED
+		float step = 0.f; // Height quantization step, for ENCODING_HEIGHT_QUANTIZED
+		uint32_t reserved = 0;
+		uint64_t offset = 0; // From the start of the file
+		uint64_t stored_size = 0; // In the file
+		uint64_t raw_size = 0; // After decompression
+	};
+
+	static_assert(sizeof(FileHeader) == 64, "RegionFile::FileHeader must be 64 bytes");
+	static_assert(sizeof(ChunkHeader) == 64, "RegionFile::ChunkHeader must be 64 bytes");
+
+private:
+	static PackedByteArray _encode_map(const MapType p_type, const Ref<Image> &p_map, const real_t p_height_step, ChunkHeader &r_chunk);
+	static Ref<Image> _decode_map(const ChunkHeader &p_chunk, const PackedByteArray &p_data);
+	static void _split_planes(const uint8_t *p_src, const int64_t p_count, const int p_stride, uint8_t *r_dst);
+	static void _join_planes(const uint8_t *p_src, const int64_t p_count, const int p_stride, uint8_t *r_dst);
+	static Ref<Terrain3DRegion> _decode(const uint8_t *p_data, const uint64_t p_size, const std::shared_ptr<const MappedFile> &p_file);
+
+public:
+	static PackedByteArray encode(const Terrain3DRegion *p_region, const real_t p_height_step = 0.f, const bool p_mappable = false);
+	static Ref<Terrain3DRegion> decode(const PackedByteArray &p_data);
+	static Error save(const Terrain3DRegion *p_region, const String &p_path, const real_t p_height_step = 0.f,
+			const bool p_mappable = false, uint64_t *r_bytes = nullptr);
+	static Ref<Terrain3DRegion> load(const String &p_path);
+	static Ref<Terrain3DRegion> map(const String &p_path);
+	static bool is_region_file(const String &p_path) { return p_path.get_extension() == EXTENSION; }
+	static void encode_deltas(const uint32_t *p_values, const int p_width, const int p_height, uint8_t *r_planes);
+	static void decode_deltas(const uint8_t *p_planes, const int p_width, const int p_height, uint32_t *r_values);
+};
+
+#endif // REGIONFILE_CLASS_H
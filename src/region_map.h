@@ -0,0 +1,73 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef REGIONMAP_CLASS_H
+#define REGIONMAP_CLASS_H
+
+#include "constants.h"
+
+using namespace godot;
+
+// Layout of the two level region map, which stores region_id + 1 by region location, 0 = no region.
+// The world is divided into BLOCKS x BLOCKS blocks of BLOCK_SIZE x BLOCK_SIZE regions. The array
+// begins with a page table of one entry per block, holding the index of the page of the block.
+// Pages of BLOCK_SIZE^2 entries follow, only for blocks with regions. Page 0 is always empty and
+// shared by all blocks without regions, so lookups don't need to branch on missing pages.
+// Memory grows with the number of blocks in use, rather than with the area of the world.
+// Locations given here are offset to positive values: 0, 0 to SIZE - 1, SIZE - 1.
+
+class RegionMap {
+public:
+	static inline const int BLOCK_SHIFT = 5;
+	static inline const int BLOCK_SIZE = 1 << BLOCK_SHIFT; // 32x32 regions per block
+	static inline const int BLOCK_MASK = BLOCK_SIZE - 1;
+	static inline const int BLOCK_AREA = BLOCK_SIZE * BLOCK_SIZE;
+	static inline const int BLOCKS = 8; // 8x8 blocks in the world
+	static inline const int SIZE = BLOCK_SIZE * BLOCKS; // 256x256 regions in the world
+	static inline const int PAGE_TABLE_SIZE = BLOCKS * BLOCKS;
+
+	static void clear(PackedInt32Array &r_map);
+	static int get_page_count(const PackedInt32Array &p_map);
+	static int get_entry(const int32_t *p_map, const Vector2i &p_loc);
+	static void set_entry(PackedInt32Array &r_map, const Vector2i &p_loc, const int p_value);
+};
+
+// Inline Functions
+
+// Resets the map to the page table and the empty page
+inline void RegionMap::clear(PackedInt32Array &r_map) {
+	r_map.resize(PAGE_TABLE_SIZE + BLOCK_AREA);
+	r_map.fill(0);
+}
+
+inline int RegionMap::get_page_count(const PackedInt32Array &p_map) {
+	return (p_map.size() - PAGE_TABLE_SIZE) / BLOCK_AREA;
+}
+
+// Returns region_id + 1 at the location, 0 = no region. Location must be in bounds.
+inline int RegionMap::get_entry(const int32_t *p_map, const Vector2i &p_loc) {
+	const int page = p_map[(p_loc.y >> BLOCK_SHIFT) * BLOCKS + (p_loc.x >> BLOCK_SHIFT)];
+	return p_map[PAGE_TABLE_SIZE + page * BLOCK_AREA + ((p_loc.y & BLOCK_MASK) << BLOCK_SHIFT) + (p_loc.x & BLOCK_MASK)];
+}
+
+// Sets region_id + 1 at the location, adding a page for the block if needed. Location must be in
+// bounds. Emptied pages are kept until the map is rebuilt.
+inline void RegionMap::set_entry(PackedInt32Array &r_map, const Vector2i &p_loc, const int p_value) {
+	const int block = (p_loc.y >> BLOCK_SHIFT) * BLOCKS + (p_loc.x >> BLOCK_SHIFT);
+	int page = r_map[block];
+	if (page == 0) {
+		if (p_value == 0) {
+			return;
+		}
+		page = get_page_count(r_map);
+		const int start = r_map.size();
+		r_map.resize(start + BLOCK_AREA);
+		int32_t *map = r_map.ptrw();
+		for (int i = start; i < start + BLOCK_AREA; i++) {
+			map[i] = 0;
+		}
+		map[block] = page;
+	}
+	r_map.set(PAGE_TABLE_SIZE + page * BLOCK_AREA + ((p_loc.y & BLOCK_MASK) << BLOCK_SHIFT) + (p_loc.x & BLOCK_MASK), p_value);
+}
+
+#endif // REGIONMAP_CLASS_H
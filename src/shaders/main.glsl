@@ -39,8 +39,10 @@ uniform float _vertex_spacing = 1.0;
 uniform float _vertex_density = 1.0; // = 1/_vertex_spacing
 uniform float _region_size = 1024.0;
 uniform float _region_texel_size = 0.0009765625; // = 1/1024
-uniform int _region_map_size = 32;
-uniform int _region_map[1024];
+uniform int _region_map_size = 256;
+uniform int _region_blocks[64];
+uniform highp sampler2D _region_map : filter_nearest, repeat_disable;
+uniform ivec2 _region_map_preview = ivec2(-1); // Shows a location without a region in the editor
 uniform vec2 _region_locations[1024];
 uniform float _texture_normal_depth_array[32];
 uniform float _texture_ao_strength_array[32];
@@ -104,6 +106,16 @@ varying vec3 v_vertex;
 // Vertex
 ////////////////////////
 
+// Takes in region location offset to positive values, returns region_id + 1, or 0 if no region.
+// _region_blocks holds the page of each 32x32 block of regions, and _region_map the pages.
+// The editor preview location returns -1, so it's drawn without being a region.
+int get_region_map(const ivec2 pos) {
+	int bounds = int(uint(pos.x | pos.y) < uint(_region_map_size));
+	ivec2 block = (pos >> 5) * bounds;
+	int page = _region_blocks[block.y * (_region_map_size >> 5) + block.x];
+	return int(texelFetch(_region_map, ivec2(pos.x & 31, (page << 5) | (pos.y & 31)), 0).r) * bounds - int(pos == _region_map_preview);
+}
+
 // Takes in world space XZ (UV) coordinates & search depth (only applicable for background mode none)
 // Returns ivec3 with:
 // XY: (0 to _region_size - 1) coordinates within a region
@@ -112,13 +124,12 @@ ivec3 get_index_coord(const vec2 uv, const int search) {
 	vec2 r_uv = round(uv);
 	vec2 o_uv = mod(r_uv,_region_size);
 	ivec2 pos;
-	int bounds, layer_index = -1;
+	int layer_index = -1;
 	for (int i = -1; i < clamp(search, SKIP_PASS, FRAGMENT_PASS); i++) {
 		if ((layer_index == -1 && _background_mode == 0u ) || i < 0) {
 			r_uv -= i == -1 ? vec2(0.0) : vec2(float(o_uv.x <= o_uv.y), float(o_uv.y <= o_uv.x));
 			pos = ivec2(floor((r_uv) * _region_texel_size)) + (_region_map_size / 2);
-			bounds = int(uint(pos.x | pos.y) < uint(_region_map_size));
-			layer_index = (_region_map[ pos.y * _region_map_size + pos.x ] * bounds - 1);
+			layer_index = get_region_map(pos) - 1;
 		}
 	}
 	return ivec3(ivec2(mod(r_uv,_region_size)), layer_index);
@@ -129,8 +140,7 @@ ivec3 get_index_coord(const vec2 uv, const int search) {
 // Z: layer index used for texturearrays, -1 if not in a region
 vec3 get_index_uv(const vec2 uv2) {
 	ivec2 pos = ivec2(floor(uv2)) + (_region_map_size / 2);
-	int bounds = int(uint(pos.x | pos.y) < uint(_region_map_size));
-	int layer_index = _region_map[ pos.y * _region_map_size + pos.x ] * bounds - 1;
+	int layer_index = get_region_map(pos) - 1;
 	return vec3(uv2 - _region_locations[layer_index], float(layer_index));
 }
 
@@ -0,0 +1,215 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include <algorithm>
+
+#include "logger.h"
+#include "sparse_map.h"
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+// Creates a map of p_size, a multiple of TILE_SIZE, with every pixel set to p_value
+SparseMap::SparseMap(const int p_size, const Image::Format p_format, const uint32_t p_value) {
+	_size = p_size;
+	_tiles_per_side = p_size >> TILE_SHIFT;
+	_format = p_format;
+	_values.resize(_tiles_per_side * _tiles_per_side, p_value);
+	_tiles.resize(_tiles_per_side * _tiles_per_side);
+}
+
+/** Returns a sparse copy of the first level of p_image, or nullptr if it isn't worth it.
+ * Tiles are scanned before any are copied, so maps with too much detail are rejected early.
+ *	p_max_dense_ratio - the portion of tiles allowed to vary within themselves
+ */
+std::shared_ptr<SparseMap> SparseMap::compact(const Ref<Image> &p_image, const real_t p_max_dense_ratio) {
+	if (p_image.is_null() || !is_format_supported(p_image->get_format())) {
+		return nullptr;
+	}
+	const int size = p_image->get_width();
+	if (size != p_image->get_height() || size < TILE_SIZE || (size & TILE_MASK) != 0) {
+		return nullptr;
+	}
+	const int tiles_per_side = size >> TILE_SHIFT;
+	const int tile_count = tiles_per_side * tiles_per_side;
+	const int max_dense = int(p_max_dense_ratio * tile_count);
+	const uint32_t *src = reinterpret_cast<const uint32_t *>(p_image->ptr());
+	std::vector<bool> dense(tile_count, false);
+	int dense_count = 0;
+	for (int tile = 0; tile < tile_count; tile++) {
+		const uint32_t *origin = src + (tile / tiles_per_side) * TILE_SIZE * size + (tile % tiles_per_side) * TILE_SIZE;
+		const uint32_t value = origin[0];
+		for (int y = 0; y < TILE_SIZE && !dense[tile]; y++) {
+			const uint32_t *row = origin + y * size;
+			dense[tile] = std::any_of(row, row + TILE_SIZE, [value](const uint32_t p_bits) { return p_bits != value; });
+		}
+		if (dense[tile] && ++dense_count > max_dense) {
+			return nullptr;
+		}
+	}
+
+	std::shared_ptr<SparseMap> map = std::make_shared<SparseMap>(size, p_image->get_format(), 0);
+	for (int tile = 0; tile < tile_count; tile++) {
+		const uint32_t *origin = src + (tile / tiles_per_side) * TILE_SIZE * size + (tile % tiles_per_side) * TILE_SIZE;
+		if (!dense[tile]) {
+			map->_values[tile] = origin[0];
+			continue;
+		}
+		std::shared_ptr<Tile> pixels = std::make_shared<Tile>(TILE_SIZE * TILE_SIZE);
+		for (int y = 0; y < TILE_SIZE; y++) {
+			memcpy(pixels->data() + y * TILE_SIZE, origin + y * size, TILE_SIZE * sizeof(uint32_t));
+		}
+		map->_tiles[tile] = pixels;
+	}
+	LOG(DEBUG, "Compacted ", size, "x", size, " map to ", dense_count, " of ", tile_count, " tiles");
+	return map;
+}
+
+bool SparseMap::is_format_supported(const Image::Format p_format) {
+	return p_format == Image::FORMAT_RF || p_format == Image::FORMAT_RGBA8;
+}
+
+// Converts a color to the bits of a pixel the same way Image::set_pixel() does
+uint32_t SparseMap::encode(const Image::Format p_format, const Color &p_color) {
+	if (p_format == Image::FORMAT_RF) {
+		return as_uint(float(p_color.r));
+	}
+	return uint32_t(uint8_t(CLAMP(p_color.r * 255.0, 0., 255.))) |
+			uint32_t(uint8_t(CLAMP(p_color.g * 255.0, 0., 255.))) << 8 |
+			uint32_t(uint8_t(CLAMP(p_color.b * 255.0, 0., 255.))) << 16 |
+			uint32_t(uint8_t(CLAMP(p_color.a * 255.0, 0., 255.))) << 24;
+}
+
+// Converts the bits of a pixel to a color the same way Image::get_pixel() does
+Color SparseMap::decode(const Image::Format p_format, const uint32_t p_bits) {
+	if (p_format == Image::FORMAT_RF) {
+		return Color(as_float(p_bits), 0.f, 0.f, 1.f);
+	}
+	return Color((p_bits & 0xFF) / 255.0, ((p_bits >> 8) & 0xFF) / 255.0,
+			((p_bits >> 16) & 0xFF) / 255.0, (p_bits >> 24) / 255.0);
+}
+
+// Returns a new Image of the map, generating mipmaps if requested
+Ref<Image> SparseMap::to_image(const bool p_mipmaps) const {
+	if (is_uniform()) {
+		return Util::get_filled_image(Vector2i(_size, _size), decode(_format, _values[0]), p_mipmaps, _format);
+	}
+	PackedByteArray data;
+	data.resize(int64_t(_size) * _size * sizeof(uint32_t));
+	uint32_t *dst = reinterpret_cast<uint32_t *>(data.ptrw());
+	for (int tile = 0; tile < int(_tiles.size()); tile++) {
+		uint32_t *origin = dst + (tile / _tiles_per_side) * TILE_SIZE * _size + (tile % _tiles_per_side) * TILE_SIZE;
+		const Tile *pixels = _tiles[tile].get();
+		for (int y = 0; y < TILE_SIZE; y++) {
+			if (pixels) {
+				memcpy(origin + y * _size, pixels->data() + y * TILE_SIZE, TILE_SIZE * sizeof(uint32_t));
+			} else {
+				std::fill_n(origin + y * _size, TILE_SIZE, _values[tile]);
+			}
+		}
+	}
+	Ref<Image> img = Image::create_from_data(_size, _size, false, _format, data);
+	if (p_mipmaps) {
+		img->generate_mipmaps();
+	}
+	return img;
+}
+
+// Returns true if every pixel has the same value
+bool SparseMap::is_uniform() const {
+	for (int tile = 0; tile < int(_tiles.size()); tile++) {
+		if (_tiles[tile] || _values[tile] != _values[0]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int SparseMap::get_dense_tile_count() const {
+	return int(std::count_if(_tiles.begin(), _tiles.end(), [](const std::shared_ptr<Tile> &p_tile) { return p_tile != nullptr; }));
+}
+
+// Returns the bytes held by the map, counting tiles shared with copies in full
+int64_t SparseMap::get_memory() const {
+	return int64_t(_values.size()) * sizeof(uint32_t) + int64_t(_tiles.size()) * sizeof(std::shared_ptr<Tile>) +
+			int64_t(get_dense_tile_count()) * TILE_SIZE * TILE_SIZE * sizeof(uint32_t);
+}
+
+// Returns the lowest and highest values of a FORMAT_RF map, as Util::get_min_max() does for Images
+Vector2 SparseMap::get_min_max() const {
+	Vector2 min_max = Vector2(FLT_MAX, FLT_MIN);
+	auto include = [&](const uint32_t p_bits) {
+		const real_t value = as_float(p_bits);
+		if (value < min_max.x) {
+			min_max.x = value;
+		}
+		if (value > min_max.y) {
+			min_max.y = value;
+		}
+	};
+	for (int tile = 0; tile < int(_tiles.size()); tile++) {
+		if (const Tile *pixels = _tiles[tile].get()) {
+			std::for_each(pixels->begin(), pixels->end(), include);
+		} else {
+			include(_values[tile]);
+		}
+	}
+	return min_max;
+}
+
+// Writes the raw bits of a pixel, giving a uniform tile its own pixels only if the value differs.
+// The position must be within the map.
+void SparseMap::set_bits(const int p_x, const int p_y, const uint32_t p_bits) {
+	const int tile = _get_tile_index(p_x, p_y);
+	std::shared_ptr<Tile> &pixels = _tiles[tile];
+	if (!pixels) {
+		if (_values[tile] == p_bits) {
+			return;
+		}
+		pixels = std::make_shared<Tile>(TILE_SIZE * TILE_SIZE, _values[tile]);
+	} else if (pixels.use_count() > 1) {
+		pixels = std::make_shared<Tile>(*pixels);
+	}
+	(*pixels)[((p_y & TILE_MASK) << TILE_SHIFT) | (p_x & TILE_MASK)] = p_bits;
+}
+
+// Copies the pixels of p_rect, within the map, into r_dst as rows of p_rect.size.x pixels
+void SparseMap::read_rect(const Rect2i &p_rect, uint32_t *r_dst) const {
+	for (int y = 0; y < p_rect.size.y; y++) {
+		for (int x = 0; x < p_rect.size.x; x++) {
+			r_dst[y * p_rect.size.x + x] = get_bits(p_rect.position.x + x, p_rect.position.y + y);
+		}
+	}
+}
+
+/** Writes the pixels of p_rect, within the map, from p_src given as rows of p_rect.size.x pixels.
+ * Each tile overlapped is replaced rather than written, so copies sharing it are left untouched,
+ * and is stored as a single value again if the pixels written leave it uniform.
+ */
+void SparseMap::write_rect(const Rect2i &p_rect, const uint32_t *p_src) {
+	if (!p_src || !p_rect.has_area()) {
+		return;
+	}
+	const Vector2i from = p_rect.position / TILE_SIZE;
+	const Vector2i to = (p_rect.get_end() - Vector2i(1, 1)) / TILE_SIZE;
+	for (int ty = from.y; ty <= to.y; ty++) {
+		for (int tx = from.x; tx <= to.x; tx++) {
+			const int tile = ty * _tiles_per_side + tx;
+			const Rect2i tile_rect = Rect2i(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+			const Rect2i rect = tile_rect.intersection(p_rect);
+			std::shared_ptr<Tile> pixels = _tiles[tile] ? std::make_shared<Tile>(*_tiles[tile]) :
+														  std::make_shared<Tile>(TILE_SIZE * TILE_SIZE, _values[tile]);
+			for (int y = rect.position.y; y < rect.get_end().y; y++) {
+				const uint32_t *row = p_src + int64_t(y - p_rect.position.y) * p_rect.size.x + (rect.position.x - p_rect.position.x);
+				memcpy(pixels->data() + ((y & TILE_MASK) << TILE_SHIFT) + (rect.position.x & TILE_MASK), row, rect.size.x * sizeof(uint32_t));
+			}
+			const uint32_t value = (*pixels)[0];
+			if (std::all_of(pixels->begin(), pixels->end(), [value](const uint32_t p_bits) { return p_bits == value; })) {
+				_tiles[tile].reset();
+				_values[tile] = value;
+			} else {
+				_tiles[tile] = pixels;
+			}
+		}
+	}
+}
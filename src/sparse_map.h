@@ -0,0 +1,80 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef SPARSEMAP_CLASS_H
+#define SPARSEMAP_CLASS_H
+
+#include <memory>
+#include <vector>
+
+#include "constants.h"
+#include "terrain_3d_util.h"
+
+using namespace godot;
+
+// A square map of 4 byte pixels split into tiles, where a tile of a single value is stored as
+// that value and only tiles with varying data hold pixels. Regions keep their height and control
+// maps, and mostly flat or untouched color maps, in this form instead of a full Image, and expand
+// them when accessed through the Image API. Supports FORMAT_RF and FORMAT_RGBA8, without mipmaps.
+// A map of varying tiles holds the same pixels as an Image, plus a pointer and value per tile.
+// Tiles are shared between copies of a map and copied on write, so a copy is cheap and a
+// snapshot of a map is never modified. Writes go through Terrain3DRegion::get_sparse_map_ptrw(),
+// which first copies the map if it's shared.
+
+class SparseMap {
+	CLASS_NAME_STATIC("Terrain3DSparseMap");
+
+public: // Constants
+	static constexpr int TILE_SHIFT = 6;
+	static constexpr int TILE_SIZE = 1 << TILE_SHIFT; // 64x64 pixels
+	static constexpr int TILE_MASK = TILE_SIZE - 1;
+	static constexpr real_t MAX_DENSE_RATIO = 0.5f; // Of tiles for compact() to succeed
+
+	typedef std::vector<uint32_t> Tile;
+
+private:
+	int _size = 0;
+	int _tiles_per_side = 0;
+	Image::Format _format = Image::FORMAT_RF;
+	std::vector<uint32_t> _values; // Value of each uniform tile
+	std::vector<std::shared_ptr<Tile>> _tiles; // Pixels of each varying tile, or null if uniform
+
+	int _get_tile_index(const int p_x, const int p_y) const;
+
+public:
+	SparseMap(const int p_size, const Image::Format p_format, const uint32_t p_value);
+	static std::shared_ptr<SparseMap> compact(const Ref<Image> &p_image, const real_t p_max_dense_ratio = MAX_DENSE_RATIO);
+	static bool is_format_supported(const Image::Format p_format);
+	static uint32_t encode(const Image::Format p_format, const Color &p_color);
+	static Color decode(const Image::Format p_format, const uint32_t p_bits);
+
+	int get_size() const { return _size; }
+	Image::Format get_format() const { return _format; }
+	Ref<Image> to_image(const bool p_mipmaps = false) const;
+	bool is_uniform() const;
+	int get_dense_tile_count() const;
+	int64_t get_memory() const;
+	Vector2 get_min_max() const;
+
+	uint32_t get_bits(const int p_x, const int p_y) const;
+	float get_float(const int p_x, const int p_y) const { return as_float(get_bits(p_x, p_y)); }
+	Color get_pixel(const int p_x, const int p_y) const { return decode(_format, get_bits(p_x, p_y)); }
+	void set_bits(const int p_x, const int p_y, const uint32_t p_bits);
+	void set_pixel(const int p_x, const int p_y, const Color &p_color) { set_bits(p_x, p_y, encode(_format, p_color)); }
+	void read_rect(const Rect2i &p_rect, uint32_t *r_dst) const;
+	void write_rect(const Rect2i &p_rect, const uint32_t *p_src);
+};
+
+// Inline Functions
+
+inline int SparseMap::_get_tile_index(const int p_x, const int p_y) const {
+	return (p_y >> TILE_SHIFT) * _tiles_per_side + (p_x >> TILE_SHIFT);
+}
+
+// Returns the raw bits of a pixel. The position must be within the map.
+inline uint32_t SparseMap::get_bits(const int p_x, const int p_y) const {
+	const int tile = _get_tile_index(p_x, p_y);
+	const Tile *pixels = _tiles[tile].get();
+	return pixels ? (*pixels)[((p_y & TILE_MASK) << TILE_SHIFT) | (p_x & TILE_MASK)] : _values[tile];
+}
+
+#endif // SPARSEMAP_CLASS_H
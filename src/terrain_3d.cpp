@@ -132,6 +132,19 @@ void Terrain3D::__physics_process(const double p_delta) {
 				_collision->update();
 			}
 		}
+		if (_region_streaming && _data) {
+			_data->_update_streaming(cam_pos);
+		}
+	}
+
+	// Add regions loaded in the background
+	if (_data) {
+		_data->_process_loads();
+	}
+
+	// Rebuild instancer cells queued by update_mmis(true)
+	if (_instancer) {
+		_instancer->_process_rebuilds();
 	}
 }
 
@@ -500,6 +513,7 @@ void Terrain3D::set_region_size(const RegionSize p_size) {
 	if (_data) {
 		_data->_region_size = _region_size;
 		_data->_region_sizev = Vector2i(_region_size, _region_size);
+		_data->update_region_ptrs();
 	}
 	if (_material.is_valid()) {
 		_material->_update_maps();
@@ -511,6 +525,28 @@ void Terrain3D::set_save_16_bit(const bool p_enabled) {
 	_save_16_bit = p_enabled;
 }
 
+void Terrain3D::set_region_streaming(const bool p_enabled) {
+	LOG(INFO, "Setting region streaming: ", p_enabled);
+	_region_streaming = p_enabled;
+}
+
+void Terrain3D::set_streaming_radius(const real_t p_radius) {
+	real_t radius = CLAMP(p_radius, 0.f, 100000.f);
+	LOG(INFO, "Setting region streaming radius: ", radius);
+	_streaming_radius = radius;
+}
+
+void Terrain3D::set_streaming_memory_budget(const int p_megabytes) {
+	int budget = CLAMP(p_megabytes, 64, 1048576);
+	LOG(INFO, "Setting region streaming memory budget: ", budget, " MB");
+	_streaming_memory_budget = budget;
+}
+
+void Terrain3D::set_mapped_regions(const bool p_enabled) {
+	LOG(INFO, "Setting memory mapped regions: ", p_enabled);
+	_mapped_regions = p_enabled;
+}
+
 void Terrain3D::set_label_distance(const real_t p_distance) {
 	real_t distance = CLAMP(p_distance, 0.f, 100000.f);
 	LOG(INFO, "Setting region label distance: ", distance);
@@ -589,6 +625,7 @@ void Terrain3D::set_vertex_spacing(const real_t p_spacing) {
 		LOG(INFO, "Setting vertex spacing: ", _vertex_spacing);
 		if (_collision && _data && _instancer && _material.is_valid()) {
 			_data->_vertex_spacing = _vertex_spacing;
+			_data->update_region_ptrs();
 			update_region_labels();
 			_instancer->_update_vertex_spacing(_vertex_spacing);
 			_camera_last_position = V2_MAX;
@@ -655,30 +692,46 @@ void Terrain3D::set_cull_margin(const real_t p_margin) {
 	}
 }
 
-/* Returns the point a ray intersects the ground using either raymarching or the GPU depth texture
+void Terrain3D::set_show_instances(const bool p_visible) {
+	LOG(INFO, "Setting show instances: ", p_visible);
+	if (_mmi_parent) {
+		_mmi_parent->set_visible(p_visible);
+	}
+	if (_instancer) {
+		_instancer->_update_server_instances();
+	}
+}
+
+/* Returns the point a ray intersects the ground using either the height data or the GPU depth texture
  *	p_src_pos (camera position)
  *	p_direction (camera direction looking at the terrain)
- *  p_gpu_mode - false: use raymarching, true: use GPU mode
+ *  p_gpu_mode - false: use Terrain3DData::raycast(), true: use GPU mode
  * Returns Vec3(NAN) on error or vec3(3.402823466e+38F) on no intersection. Test w/ if (var.x < 3.4e38)
+ * Only GPU mode uses the camera and moves the mouse camera.
  */
 Vector3 Terrain3D::get_intersection(const Vector3 &p_src_pos, const Vector3 &p_direction, const bool p_gpu_mode) {
-	if (!is_instance_valid(_camera_instance_id)) {
+	if (p_gpu_mode && !is_instance_valid(_camera_instance_id)) {
 		LOG(ERROR, "Invalid camera");
 		return Vector3(NAN, NAN, NAN);
 	}
-	if (!_mouse_cam) {
+	if (p_gpu_mode && !_mouse_cam) {
 		LOG(ERROR, "Invalid mouse camera");
 		return Vector3(NAN, NAN, NAN);
 	}
 	Vector3 direction = p_direction.normalized();
 	Vector3 point;
+	bool straight_down = (direction - Vector3(0.f, -1.f, 0.f)).length_squared() < 0.00001f;
 
-	// Position mouse cam one unit behind the requested position
-	_mouse_cam->set_global_position(p_src_pos - direction);
+	if (p_gpu_mode) {
+		// Position mouse cam one unit behind the requested position
+		_mouse_cam->set_global_position(p_src_pos - direction);
+		if (straight_down) {
+			_mouse_cam->set_rotation_degrees(Vector3(-90.f, 0.f, 0.f));
+		}
+	}
 
 	// If looking straight down (eg orthogonal camera), just return height. look_at won't work
-	if ((direction - Vector3(0.f, -1.f, 0.f)).length_squared() < 0.00001f) {
-		_mouse_cam->set_rotation_degrees(Vector3(-90.f, 0.f, 0.f));
+	if (straight_down) {
 		point = p_src_pos;
 		point.y = _data->get_height(p_src_pos);
 		if (std::isnan(point.y)) {
@@ -686,16 +739,12 @@ Vector3 Terrain3D::get_intersection(const Vector3 &p_src_pos, const Vector3 &p_d
 		}
 
 	} else if (!p_gpu_mode) {
-		// Else if not gpu mode, use raymarching mode
-		point = p_src_pos;
-		for (int i = 0; i < 4000; i++) {
-			real_t height = _data->get_height(point);
-			if (point.y - height <= 0) {
-				return point;
-			}
-			point += direction;
+		// Else if not gpu mode, trace the height pyramids
+		point = _data->raycast(p_src_pos, direction, 4000.f);
+		if (std::isnan(point.x)) {
+			return V3_MAX;
 		}
-		return V3_MAX;
+		return point;
 
 	} else {
 		// Else use GPU mode, which requires multiple calls
@@ -840,6 +889,9 @@ void Terrain3D::_notification(const int p_what) {
 			if (_mesher) {
 				_mesher->update();
 			}
+			if (_instancer) {
+				_instancer->_update_server_instances();
+			}
 			break;
 		}
 
@@ -887,6 +939,9 @@ void Terrain3D::_notification(const int p_what) {
 			if (_mesher) {
 				_mesher->update();
 			}
+			if (_instancer) {
+				_instancer->_update_server_instances();
+			}
 			break;
 		}
 
@@ -939,6 +994,10 @@ void Terrain3D::_notification(const int p_what) {
 			LOG(INFO, "NOTIFICATION_EXIT_TREE");
 			set_physics_process(false);
 			_destroy_mesher();
+			// MMI nodes leave the tree with us, but server instances must be freed
+			if (_instancer) {
+				_instancer->_destroy_rids();
+			}
 			_destroy_mouse_picking();
 			if (_assets.is_valid()) {
 				_assets->uninitialize();
@@ -1011,6 +1070,14 @@ void Terrain3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_region_size"), &Terrain3D::get_region_size);
 	ClassDB::bind_method(D_METHOD("set_save_16_bit", "enabled"), &Terrain3D::set_save_16_bit);
 	ClassDB::bind_method(D_METHOD("get_save_16_bit"), &Terrain3D::get_save_16_bit);
+	ClassDB::bind_method(D_METHOD("set_region_streaming", "enabled"), &Terrain3D::set_region_streaming);
+	ClassDB::bind_method(D_METHOD("get_region_streaming"), &Terrain3D::get_region_streaming);
+	ClassDB::bind_method(D_METHOD("set_streaming_radius", "radius"), &Terrain3D::set_streaming_radius);
+	ClassDB::bind_method(D_METHOD("get_streaming_radius"), &Terrain3D::get_streaming_radius);
+	ClassDB::bind_method(D_METHOD("set_streaming_memory_budget", "megabytes"), &Terrain3D::set_streaming_memory_budget);
+	ClassDB::bind_method(D_METHOD("get_streaming_memory_budget"), &Terrain3D::get_streaming_memory_budget);
+	ClassDB::bind_method(D_METHOD("set_mapped_regions", "enabled"), &Terrain3D::set_mapped_regions);
+	ClassDB::bind_method(D_METHOD("get_mapped_regions"), &Terrain3D::get_mapped_regions);
 	ClassDB::bind_method(D_METHOD("set_label_distance", "distance"), &Terrain3D::set_label_distance);
 	ClassDB::bind_method(D_METHOD("get_label_distance"), &Terrain3D::get_label_distance);
 	ClassDB::bind_method(D_METHOD("set_label_size", "size"), &Terrain3D::set_label_size);
@@ -1032,6 +1099,11 @@ void Terrain3D::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_physics_material", "material"), &Terrain3D::set_physics_material);
 	ClassDB::bind_method(D_METHOD("get_physics_material"), &Terrain3D::get_physics_material);
 
+	ClassDB::bind_method(D_METHOD("set_instancer_mode", "mode"), &Terrain3D::set_instancer_mode);
+	ClassDB::bind_method(D_METHOD("get_instancer_mode"), &Terrain3D::get_instancer_mode);
+	ClassDB::bind_method(D_METHOD("set_instancer_rebuild_cells_per_frame", "cells"), &Terrain3D::set_instancer_rebuild_cells_per_frame);
+	ClassDB::bind_method(D_METHOD("get_instancer_rebuild_cells_per_frame"), &Terrain3D::get_instancer_rebuild_cells_per_frame);
+
 	// Meshes
 	ClassDB::bind_method(D_METHOD("set_mesh_lods", "count"), &Terrain3D::set_mesh_lods);
 	ClassDB::bind_method(D_METHOD("get_mesh_lods"), &Terrain3D::get_mesh_lods);
@@ -1112,6 +1184,10 @@ void Terrain3D::_bind_methods() {
 	ADD_GROUP("Regions", "");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "region_size", PROPERTY_HINT_ENUM, "64:64,128:128,256:256,512:512,1024:1024,2048:2048", PROPERTY_USAGE_EDITOR), "change_region_size", "get_region_size");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "save_16_bit"), "set_save_16_bit", "get_save_16_bit");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "region_streaming"), "set_region_streaming", "get_region_streaming");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "streaming_radius", PROPERTY_HINT_RANGE, "0.0,16384.0,1.0,or_greater"), "set_streaming_radius", "get_streaming_radius");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "streaming_memory_budget", PROPERTY_HINT_RANGE, "64,65536,64,or_greater,suffix:MB"), "set_streaming_memory_budget", "get_streaming_memory_budget");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "mapped_regions"), "set_mapped_regions", "get_mapped_regions");
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "label_distance", PROPERTY_HINT_RANGE, "0.0,10000.0,0.5,or_greater"), "set_label_distance", "get_label_distance");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "label_size", PROPERTY_HINT_RANGE, "24,128,1"), "set_label_size", "get_label_size");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "show_grid"), "set_show_region_grid", "get_show_region_grid");
@@ -1125,6 +1201,10 @@ void Terrain3D::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "collision_priority", PROPERTY_HINT_RANGE, "0.1,256,.1"), "set_collision_priority", "get_collision_priority");
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "physics_material", PROPERTY_HINT_RESOURCE_TYPE, "PhysicsMaterial"), "set_physics_material", "get_physics_material");
 
+	ADD_GROUP("Instancer", "");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "instancer_mode", PROPERTY_HINT_ENUM, "Nodes,Server / Game,Server / Editor"), "set_instancer_mode", "get_instancer_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "instancer_rebuild_cells_per_frame", PROPERTY_HINT_RANGE, "0,1024,1,or_greater"), "set_instancer_rebuild_cells_per_frame", "get_instancer_rebuild_cells_per_frame");
+
 	ADD_GROUP("Mesh", "");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_lods", PROPERTY_HINT_RANGE, "1,10,1"), "set_mesh_lods", "get_mesh_lods");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "mesh_size", PROPERTY_HINT_RANGE, "8,64,2"), "set_mesh_size", "get_mesh_size");
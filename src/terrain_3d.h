@@ -62,6 +62,10 @@ private:
 	// Regions
 	RegionSize _region_size = SIZE_256;
 	bool _save_16_bit = false;
+	bool _region_streaming = false;
+	real_t _streaming_radius = 2048.f;
+	int _streaming_memory_budget = 1024; // MB
+	bool _mapped_regions = false;
 	real_t _label_distance = 0.f;
 	int _label_size = 48;
 
@@ -145,6 +149,14 @@ public:
 	void change_region_size(const RegionSize p_size) { _data ? _data->change_region_size(p_size) : void(); }
 	void set_save_16_bit(const bool p_enabled);
 	bool get_save_16_bit() const { return _save_16_bit; }
+	void set_region_streaming(const bool p_enabled);
+	bool get_region_streaming() const { return _region_streaming; }
+	void set_streaming_radius(const real_t p_radius);
+	real_t get_streaming_radius() const { return _streaming_radius; }
+	void set_streaming_memory_budget(const int p_megabytes);
+	int get_streaming_memory_budget() const { return _streaming_memory_budget; }
+	void set_mapped_regions(const bool p_enabled);
+	bool get_mapped_regions() const { return _mapped_regions; }
 	void set_label_distance(const real_t p_distance);
 	real_t get_label_distance() const { return _label_distance; }
 	void set_label_size(const int p_size);
@@ -173,7 +185,7 @@ public:
 	real_t get_cull_margin() const { return _cull_margin; };
 	void set_free_editor_textures(const bool p_free_textures) { _free_editor_textures = p_free_textures; }
 	bool get_free_editor_textures() const { return _free_editor_textures; };
-	void set_show_instances(const bool p_visible) { _mmi_parent ? _mmi_parent->set_visible(p_visible) : void(); }
+	void set_show_instances(const bool p_visible);
 	bool get_show_instances() const { return _mmi_parent ? _mmi_parent->is_visible() : false; }
 
 	// Utility
@@ -202,6 +214,12 @@ public:
 	void set_physics_material(const Ref<PhysicsMaterial> &p_mat) { _collision ? _collision->set_physics_material(p_mat) : void(); }
 	Ref<PhysicsMaterial> get_physics_material() const { return _collision ? _collision->get_physics_material() : Ref<PhysicsMaterial>(); }
 
+	// Instancer Aliases
+	void set_instancer_mode(const InstancerMode p_mode) { _instancer ? _instancer->set_mode(p_mode) : void(); }
+	InstancerMode get_instancer_mode() const { return _instancer ? _instancer->get_mode() : InstancerMode::NODES; }
+	void set_instancer_rebuild_cells_per_frame(const int p_cells) { _instancer ? _instancer->set_rebuild_cells_per_frame(p_cells) : void(); }
+	int get_instancer_rebuild_cells_per_frame() const { return _instancer ? _instancer->get_rebuild_cells_per_frame() : Terrain3DInstancer::DEFAULT_REBUILD_CELLS; }
+
 	// Debug View Aliases
 	void set_show_checkered(const bool p_enabled) { _material.is_valid() ? _material->set_show_checkered(p_enabled) : void(); }
 	bool get_show_checkered() const { return _material.is_valid() ? _material->get_show_checkered() : false; }
@@ -28,35 +28,27 @@ Dictionary Terrain3DCollision::_get_shape_data(const Vector2i &p_position, const
 	real_t min_height = FLT_MAX;
 	real_t max_height = FLT_MIN;
 
-	Ref<Image> map, map_x, map_z, map_xz; // height maps
-	Ref<Image> cmap, cmap_x, cmap_z, cmap_xz; // control maps w/ holes
-
 	// Get region_loc of top left corner of descaled and grid snapped collision shape position
 	Vector2i region_loc = V2I_DIVIDE_FLOOR(p_position, region_size);
-	Ref<Terrain3DRegion> region = data->get_region(region_loc);
-	if (region.is_null() || (region.is_valid() && region->is_deleted())) {
+	auto get_active_region = [&](const Vector2i &p_region_loc) -> Ref<Terrain3DRegion> {
+		Ref<Terrain3DRegion> region = data->get_region(p_region_loc);
+		return (region.is_valid() && !region->is_deleted()) ? region : Ref<Terrain3DRegion>();
+	};
+	Ref<Terrain3DRegion> region = get_active_region(region_loc);
+	if (region.is_null()) {
 		LOG(EXTREME, "Region not found at: ", region_loc, ". Returning blank");
 		return Dictionary();
 	}
-	map = region->get_map(TYPE_HEIGHT);
-	cmap = region->get_map(TYPE_CONTROL);
-
 	// Get +X, +Z adjacent regions in case we run over
-	region = data->get_region(region_loc + Vector2i(1, 0));
-	if (region.is_valid() && !region->is_deleted()) {
-		map_x = region->get_map(TYPE_HEIGHT);
-		cmap_x = region->get_map(TYPE_CONTROL);
-	}
-	region = data->get_region(region_loc + Vector2i(0, 1));
-	if (region.is_valid() && !region->is_deleted()) {
-		map_z = region->get_map(TYPE_HEIGHT);
-		cmap_z = region->get_map(TYPE_CONTROL);
-	}
-	region = data->get_region(region_loc + Vector2i(1, 1));
-	if (region.is_valid() && !region->is_deleted()) {
-		map_xz = region->get_map(TYPE_HEIGHT);
-		cmap_xz = region->get_map(TYPE_CONTROL);
-	}
+	Ref<Terrain3DRegion> region_x = get_active_region(region_loc + Vector2i(1, 0));
+	Ref<Terrain3DRegion> region_z = get_active_region(region_loc + Vector2i(0, 1));
+	Ref<Terrain3DRegion> region_xz = get_active_region(region_loc + Vector2i(1, 1));
+
+	// Height maps and control maps w/ holes are read in place, as copying them expands sparse maps
+	auto get_height = [](const Ref<Terrain3DRegion> &p_region, const int p_x, const int p_y) -> real_t {
+		const Vector2i pixel = Vector2i(p_x, p_y);
+		return is_hole(p_region->get_pixel(TYPE_CONTROL, pixel).r) ? NAN : real_t(p_region->get_pixel(TYPE_HEIGHT, pixel).r);
+	};
 
 	for (int z = 0; z < hshape_size; z++) {
 		for (int x = 0; x < hshape_size; x++) {
@@ -76,26 +68,14 @@ Dictionary Terrain3DCollision::_get_shape_data(const Vector2i &p_position, const
 
 			// Set heights on local map, or adjacent maps if on the last row/col
 			real_t height = 0.f;
-			if (!next_x && !next_z && map.is_valid()) {
-				height = is_hole(cmap->get_pixel(img_x, img_y).r) ? NAN : map->get_pixel(img_x, img_y).r;
+			if (!next_x && !next_z) {
+				height = get_height(region, img_x, img_y);
 			} else if (next_x && !next_z) {
-				if (map_x.is_valid()) {
-					height = is_hole(cmap_x->get_pixel(img_x, img_y).r) ? NAN : map_x->get_pixel(img_x, img_y).r;
-				} else {
-					height = is_hole(cmap->get_pixel(region_size - 1, img_y).r) ? NAN : map->get_pixel(region_size - 1, img_y).r;
-				}
+				height = region_x.is_valid() ? get_height(region_x, img_x, img_y) : get_height(region, region_size - 1, img_y);
 			} else if (!next_x && next_z) {
-				if (map_z.is_valid()) {
-					height = is_hole(cmap_z->get_pixel(img_x, img_y).r) ? NAN : map_z->get_pixel(img_x, img_y).r;
-				} else {
-					height = (is_hole(cmap->get_pixel(img_x, region_size - 1).r)) ? NAN : map->get_pixel(img_x, region_size - 1).r;
-				}
+				height = region_z.is_valid() ? get_height(region_z, img_x, img_y) : get_height(region, img_x, region_size - 1);
 			} else if (next_x && next_z) {
-				if (map_xz.is_valid()) {
-					height = is_hole(cmap_xz->get_pixel(img_x, img_y).r) ? NAN : map_xz->get_pixel(img_x, img_y).r;
-				} else {
-					height = (is_hole(cmap->get_pixel(region_size - 1, region_size - 1).r)) ? NAN : map->get_pixel(region_size - 1, region_size - 1).r;
-				}
+				height = region_xz.is_valid() ? get_height(region_xz, img_x, img_y) : get_height(region, region_size - 1, region_size - 1);
 			}
 			map_data[index] = height;
 			if (!std::isnan(height)) {
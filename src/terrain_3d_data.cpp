@@ -5,9 +5,18 @@
 #include <godot_cpp/classes/editor_interface.hpp>
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
 #include <godot_cpp/classes/resource_saver.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <algorithm>
 
+#include "height_pyramid.h"
 #include "logger.h"
+#include "region_file.h"
+#include "sparse_map.h"
 #include "terrain_3d_data.h"
 
 ///////////////////////////
@@ -16,11 +25,20 @@
 
 void Terrain3DData::_clear() {
 	LOG(INFO, "Clearing data");
+	_cancel_loads();
+	_stop_streaming();
 	_region_map_dirty = true;
-	_region_map.clear();
-	_region_map.resize(REGION_MAP_SIZE * REGION_MAP_SIZE);
+	RegionMap::clear(_region_map);
+	_generated_region_map.clear();
+	_queued_rebuilds = 0;
+	_queued_updates = 0;
+	_queued_mipmaps = false;
+	_queued_layers.clear();
+	_dirty_pyramids.clear();
 	_regions.clear();
 	_region_locations.clear();
+	update_region_ptrs();
+	std::atomic_store(&_snapshot, std::shared_ptr<const DataSnapshot>());
 	_master_height_range = V2_ZERO;
 	_generated_height_maps.clear();
 	_generated_control_maps.clear();
@@ -28,21 +46,856 @@ void Terrain3DData::_clear() {
 }
 
 // Structured to work with do_for_regions. Should be renamed when copy_paste is expanded
-void Terrain3DData::_copy_paste_dfr(const Terrain3DRegion *p_src_region, const Rect2i &p_src_rect, const Rect2i &p_dst_rect, const Terrain3DRegion *p_dst_region) {
+void Terrain3DData::_copy_paste_dfr(const Terrain3DRegion *p_src_region, const Rect2i &p_src_rect, const Rect2i &p_dst_rect, Terrain3DRegion *p_dst_region) {
 	if (!p_src_region || !p_dst_region) {
 		return;
 	}
-	TypedArray<Image> src_maps = p_src_region->get_maps();
-	TypedArray<Image> dst_maps = p_dst_region->get_maps();
-	for (int i = 0; i < dst_maps.size(); i++) {
-		Image *img = cast_to<Image>(dst_maps[i]);
+	for (int i = 0; i < TYPE_MAX; i++) {
+		Image *img = p_dst_region->get_map_ptrw(MapType(i));
 		if (img) {
-			img->blit_rect(src_maps[i], p_src_rect, p_dst_rect.position);
+			img->blit_rect(p_src_region->read_map(MapType(i)), p_src_rect, p_dst_rect.position);
 		}
 	}
 	_terrain->get_instancer()->copy_paste_dfr(p_src_region, p_src_rect, p_dst_region);
 }
 
+// Validates a region loaded from p_path and takes ownership of the file
+//	p_set_size - take the terrain region size from this region, otherwise it must match
+Error Terrain3DData::_setup_loaded_region(const Ref<Terrain3DRegion> &p_region, const Vector2i &p_region_loc, const String &p_path,
+		const bool p_set_size) {
+	if (p_set_size) {
+		_terrain->set_region_size((Terrain3D::RegionSize)p_region->get_region_size());
+	} else {
+		if (_terrain->get_region_size() != (Terrain3D::RegionSize)p_region->get_region_size()) {
+			LOG(ERROR, "Region size mismatch. First loaded: ", _terrain->get_region_size(), " next: ",
+					p_region->get_region_size(), " in file: ", p_path);
+			return FAILED;
+		}
+	}
+	p_region->take_over_path(p_path);
+	p_region->set_location(p_region_loc);
+	p_region->set_version(CURRENT_VERSION); // Sends upgrade warning if old version
+	return OK;
+}
+
+// Queues a region file to be loaded by _process_loads(). Returns false if already queued.
+bool Terrain3DData::_queue_load(const Vector2i &p_region_loc, const String &p_path, const bool p_streamed) {
+	for (const RegionLoad &load : _loads) {
+		if (load.location == p_region_loc) {
+			return false;
+		}
+	}
+	LOG(DEBUG, "Queuing region ", p_region_loc, " to load from ", p_path);
+	RegionLoad load;
+	load.location = p_region_loc;
+	load.path = p_path;
+	load.streamed = p_streamed;
+	_loads.push_back(load);
+	_loads_total++;
+	return true;
+}
+
+/** Advances the regions loading in the background. Called every physics frame by Terrain3D.
+ * Up to LOAD_REQUESTS files are decoded at once by ResourceLoader threads, or the WorkerThreadPool
+ * for binary region files, then the maps of each
+ * region are sanitized on the WorkerThreadPool. Up to LOAD_COMMITS finished regions are then
+ * added to the terrain together, emitting region_loaded for each and load_progress.
+ *	p_blocking - wait for all queued regions and add them at once
+ */
+void Terrain3DData::_process_loads(const bool p_blocking) {
+	if (_loads.empty()) {
+		return;
+	}
+	ResourceLoader *loader = ResourceLoader::get_singleton();
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+
+	// Request the next files
+	int decoding = 0;
+	for (const RegionLoad &load : _loads) {
+		decoding += load.requested ? 1 : 0;
+	}
+	for (RegionLoad &load : _loads) {
+		if (!p_blocking && decoding >= LOAD_REQUESTS) {
+			break;
+		}
+		if (load.requested || load.region.is_valid() || load.failed) {
+			continue;
+		}
+		if (RegionFile::is_region_file(load.path)) {
+			load.decode = std::make_shared<RegionDecode>();
+			load.decode->path = load.path;
+			load.task_id = pool->add_task(callable_mp_static(&Terrain3DData::_decode_region_file).bind(uint64_t(load.decode.get())),
+					false, "Terrain3D decode region");
+			load.requested = true;
+			decoding++;
+			continue;
+		}
+		Error err = loader->load_threaded_request(load.path, "Terrain3DRegion", false, ResourceLoader::CACHE_MODE_IGNORE);
+		if (err != OK) {
+			LOG(ERROR, "Cannot request region at ", load.path, ", error: ", UtilityFunctions::error_string(err));
+			load.failed = true;
+			continue;
+		}
+		load.requested = true;
+		decoding++;
+	}
+
+	// Sanitize decoded regions, then mark them ready. Blocking waits for each one.
+	for (RegionLoad &load : _loads) {
+		bool decoded;
+		if (load.decode) {
+			decoded = load.requested && (p_blocking || pool->is_task_completed(load.task_id));
+		} else {
+			decoded = load.requested && (p_blocking || loader->load_threaded_get_status(load.path) != ResourceLoader::THREAD_LOAD_IN_PROGRESS);
+		}
+		if (decoded) {
+			Ref<Terrain3DRegion> region;
+			if (load.decode) {
+				pool->wait_for_task_completion(load.task_id);
+				load.task_id = -1;
+				region = load.decode->region;
+				load.decode.reset();
+			} else {
+				region = loader->load_threaded_get(load.path);
+			}
+			load.requested = false;
+			if (region.is_null() || _setup_loaded_region(region, load.location, load.path, _regions.is_empty() && !_loads_sized) != OK) {
+				LOG(ERROR, "Cannot load region at ", load.path);
+				load.failed = true;
+				continue;
+			}
+			_loads_sized = true;
+			load.region = region;
+			load.task_id = pool->add_task(callable_mp(region.ptr(), &Terrain3DRegion::sanitize_maps), false, "Terrain3D sanitize region");
+		}
+		if (!load.requested && load.task_id >= 0 && (p_blocking || pool->is_task_completed(load.task_id))) {
+			pool->wait_for_task_completion(load.task_id);
+			load.task_id = -1;
+			load.ready = true;
+		}
+	}
+
+	// Take finished regions in the order requested
+	TypedArray<Terrain3DRegion> added;
+	std::vector<RegionLoad> finished;
+	for (size_t i = 0; i < _loads.size();) {
+		RegionLoad &load = _loads[i];
+		if (load.failed || (load.ready && (p_blocking || added.size() < LOAD_COMMITS))) {
+			if (!load.failed) {
+				added.push_back(load.region);
+			}
+			finished.push_back(load);
+			_loads.erase(_loads.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	if (finished.empty()) {
+		return;
+	}
+	for (const RegionLoad &load : finished) {
+		auto it = _streamed_regions.find(load.location);
+		if (!load.streamed || it == _streamed_regions.end()) {
+			continue;
+		}
+		StreamedRegion &streamed = it->second;
+		streamed.requested = false;
+		streamed.failed = load.failed;
+		streamed.memory = 0;
+		if (!load.failed) {
+			streamed.memory = load.region->get_memory();
+			_stream_memory += streamed.memory;
+		}
+	}
+	if (!added.is_empty()) {
+		// Sanitized by the load tasks
+		_commit_regions(added, TypedArray<Vector2i>(), true, true);
+	}
+	_loads_done += int(finished.size());
+	LOG(INFO, "Loaded ", _loads_done, " of ", _loads_total, " queued regions");
+	for (const RegionLoad &load : finished) {
+		if (!load.failed) {
+			emit_signal("region_loaded", load.region);
+		}
+	}
+	emit_signal("load_progress", _loads_done, _loads_total);
+	if (_loads.empty()) {
+		_loads_total = 0;
+		_loads_done = 0;
+		_loads_sized = false;
+	}
+}
+
+// Waits for the regions still loading in the background, and discards them
+void Terrain3DData::_cancel_loads() {
+	for (const RegionLoad &load : _loads) {
+		if (load.requested && !load.decode) {
+			ResourceLoader::get_singleton()->load_threaded_get(load.path);
+		}
+		if (load.task_id >= 0) {
+			WorkerThreadPool::get_singleton()->wait_for_task_completion(load.task_id);
+		}
+	}
+	_loads.clear();
+	_loads_total = 0;
+	_loads_done = 0;
+	_loads_sized = false;
+}
+
+// Decodes a binary region file on the WorkerThreadPool, reading mappable maps from a memory mapping
+//	p_decode - pointer to the RegionDecode, kept alive by the RegionLoad until the task is done
+void Terrain3DData::_decode_region_file(const uint64_t p_decode) {
+	RegionDecode *decode = reinterpret_cast<RegionDecode *>(p_decode);
+	decode->region = RegionFile::map(decode->path);
+}
+
+/** Adds and removes regions without the full rebuild of update_maps(). The region_id of a
+ * removed region is given to the last region, so region ids stay compact and only the region map
+ * entries and texture array layers of moved, replaced and new regions change. Their layers are
+ * uploaded by flush_map_updates() at the end of the frame. See _upload_queued_layers().
+ *	p_erase - remove the regions from _regions, otherwise only mark them deleted, as
+ *		remove_region() does
+ *	p_sanitized - the added regions were sanitized already, as by _process_loads()
+ */
+void Terrain3DData::_commit_regions(const TypedArray<Terrain3DRegion> &p_added, const TypedArray<Vector2i> &p_removed,
+		const bool p_erase, const bool p_sanitized) {
+	Terrain3DInstancer *instancer = _terrain->get_instancer();
+	const int mesh_count = _terrain->get_assets().is_valid() ? _terrain->get_assets()->get_mesh_count() : 0;
+	for (int i = 0; i < p_removed.size(); i++) {
+		Vector2i region_loc = p_removed[i];
+		for (int m = 0; m < mesh_count; m++) {
+			instancer->_destroy_mmi_by_location(region_loc, m);
+		}
+	}
+
+	auto remove = [&](const Vector2i &p_region_loc) {
+		if (p_erase) {
+			_regions.erase(p_region_loc);
+		} else if (Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions.get(p_region_loc, Variant()))) {
+			region->set_deleted(true);
+		}
+	};
+
+	// Fall back to a full rebuild if one is pending anyway
+	if (_region_map_dirty || _queued_rebuilds != 0 || _generated_height_maps.is_dirty() ||
+			_generated_control_maps.is_dirty() || _generated_color_maps.is_dirty() ||
+			_height_maps.size() != _region_locations.size() || _control_maps.size() != _region_locations.size() ||
+			_color_maps.size() != _region_locations.size()) {
+		for (int i = 0; i < p_removed.size(); i++) {
+			remove(p_removed[i]);
+		}
+		for (int i = 0; i < p_added.size(); i++) {
+			Ref<Terrain3DRegion> region = p_added[i];
+			if (get_region_map_index(region->get_location()) < 0) {
+				LOG(ERROR, "Location ", region->get_location(), " out of bounds. Max: ",
+						-REGION_MAP_SIZE / 2, " to ", REGION_MAP_SIZE / 2 - 1);
+				continue;
+			}
+			_add_region(region, !p_sanitized);
+		}
+		_region_map_dirty = true;
+		queue_map_update(TYPE_MAX, true, false);
+		instancer->_update_mmis();
+		return;
+	}
+
+	const TypedArray<Vector2i> old_locations = _region_locations.duplicate();
+	_region_locations = TypedArray<Vector2i>(); // enforce new pointer
+	_region_locations.append_array(old_locations);
+	for (int i = 0; i < p_removed.size(); i++) {
+		Vector2i region_loc = p_removed[i];
+		remove(region_loc);
+		int region_id = _region_locations.find(region_loc);
+		if (region_id < 0) {
+			continue;
+		}
+		int last_id = _region_locations.size() - 1;
+		RegionMap::set_entry(_region_map, region_loc + (REGION_MAP_VSIZE / 2), 0);
+		if (region_id != last_id) {
+			Vector2i moved_loc = _region_locations[last_id];
+			_region_locations[region_id] = moved_loc;
+			_height_maps[region_id] = _height_maps[last_id];
+			_control_maps[region_id] = _control_maps[last_id];
+			_color_maps[region_id] = _color_maps[last_id];
+			RegionMap::set_entry(_region_map, moved_loc + (REGION_MAP_VSIZE / 2), region_id + 1);
+		}
+		_region_locations.remove_at(last_id);
+		_height_maps.remove_at(last_id);
+		_control_maps.remove_at(last_id);
+		_color_maps.remove_at(last_id);
+	}
+	std::vector<int> replaced_ids;
+	for (int i = 0; i < p_added.size(); i++) {
+		Ref<Terrain3DRegion> region = p_added[i];
+		Vector2i region_loc = region->get_location();
+		if (get_region_map_index(region_loc) < 0) {
+			LOG(ERROR, "Location ", region_loc, " out of bounds. Max: ",
+					-REGION_MAP_SIZE / 2, " to ", REGION_MAP_SIZE / 2 - 1);
+			continue;
+		}
+		int region_id = _region_locations.find(region_loc);
+		if (region_id < 0 && _region_locations.size() >= MAX_REGIONS) {
+			LOG(ERROR, "Cannot add region ", region_loc, ". The maximum of ", MAX_REGIONS, " active regions is reached");
+			continue;
+		}
+		if (!p_sanitized) {
+			region->sanitize_maps();
+		}
+		region->set_deleted(false);
+		_regions[region_loc] = region;
+		if (region_id < 0) {
+			_region_locations.push_back(region_loc);
+			RegionMap::set_entry(_region_map, region_loc + (REGION_MAP_VSIZE / 2), _region_locations.size());
+			_height_maps.push_back(region->read_map(TYPE_HEIGHT));
+			_control_maps.push_back(region->read_map(TYPE_CONTROL));
+			_color_maps.push_back(region->read_map(TYPE_COLOR));
+		} else {
+			LOG(INFO, "Overwriting existing region at ", region_loc);
+			for (int m = 0; m < mesh_count; m++) {
+				instancer->_destroy_mmi_by_location(region_loc, m);
+			}
+			_height_maps[region_id] = region->read_map(TYPE_HEIGHT);
+			_control_maps[region_id] = region->read_map(TYPE_CONTROL);
+			_color_maps[region_id] = region->read_map(TYPE_COLOR);
+			replaced_ids.push_back(region_id);
+		}
+	}
+
+	_queued_layers.resize(_region_locations.size(), false);
+	for (int i = 0; i < _region_locations.size(); i++) {
+		if (i >= old_locations.size() || _region_locations[i] != old_locations[i]) {
+			_queued_layers[i] = true;
+		}
+	}
+	for (const int region_id : replaced_ids) {
+		_queued_layers[region_id] = true;
+	}
+	_queue_flush();
+	calc_height_range();
+
+	update_region_ptrs();
+	// Builds the pyramids of new regions and refreshes the edges next to them
+	_build_height_pyramids(false, false, false);
+	for (int i = 0; i < p_removed.size(); i++) {
+		Vector2i region_loc = p_removed[i];
+		for (const Vector2i &offset : { Vector2i(-1, 0), Vector2i(0, -1), Vector2i(-1, -1) }) {
+			int region_id = get_region_id(region_loc + offset);
+			if (region_id >= 0) {
+				_update_height_pyramid_edges(region_id);
+			}
+		}
+	}
+	_publish_snapshot();
+	emit_signal("region_map_changed");
+	for (int i = 0; i < p_added.size(); i++) {
+		Ref<Terrain3DRegion> region = p_added[i];
+		if (has_region(region->get_location())) {
+			instancer->_update_mmis(region->get_location());
+		}
+	}
+}
+
+// Stores a region to be activated by the next full update_maps(). Bounds are checked by the caller.
+Error Terrain3DData::_add_region(const Ref<Terrain3DRegion> &p_region, const bool p_sanitize) {
+	Vector2i region_loc = p_region->get_location();
+	if (!_region_locations.has(region_loc) && _region_locations.size() >= MAX_REGIONS) {
+		LOG(ERROR, "Cannot add region ", region_loc, ". The maximum of ", MAX_REGIONS, " active regions is reached");
+		return FAILED;
+	}
+	if (p_sanitize) {
+		p_region->sanitize_maps();
+	}
+	p_region->set_deleted(false);
+	if (!_region_locations.has(region_loc)) {
+		_region_locations.push_back(region_loc);
+	} else {
+		LOG(INFO, "Overwriting ", (_regions.has(region_loc)) ? "deleted" : "existing", " region at ", region_loc);
+	}
+	_regions[region_loc] = p_region;
+	_region_map_dirty = true;
+	LOG(DEBUG, "Storing region ", region_loc, " version ", vformat("%.3f", p_region->get_version()), " id: ", _region_locations.size());
+	return OK;
+}
+
+/** Returns the location and path of each region file in p_dir, Resource or binary. Binary region
+ * files are preferred over Resource files of the same location. Used by the streaming index and
+ * load_directory_async() so both see the same files.
+ */
+std::vector<std::pair<Vector2i, String>> Terrain3DData::_get_region_files(const String &p_dir) const {
+	std::vector<std::pair<Vector2i, String>> result;
+	PackedStringArray files = Util::get_files(p_dir, "terrain3d*.res");
+	files.append_array(Util::get_files(p_dir, "terrain3d*." + String(RegionFile::EXTENSION)));
+	std::unordered_map<Vector2i, int, Vector2iHash> indices;
+	for (int i = 0; i < files.size(); i++) {
+		String fname = files[i];
+		Vector2i loc = Util::filename_to_location(fname);
+		if (loc.x == INT32_MAX || get_region_map_index(loc) < 0) {
+			LOG(ERROR, "Cannot get a valid region location from file name: ", fname);
+			continue;
+		}
+		String path = p_dir + String("/") + fname;
+		auto it = indices.find(loc);
+		if (it == indices.end()) {
+			indices[loc] = int(result.size());
+			result.push_back({ loc, path });
+		} else if (RegionFile::is_region_file(fname)) {
+			result[it->second].second = path;
+		}
+	}
+	return result;
+}
+
+// Indexes the region files in p_dir for streaming, without loading any
+void Terrain3DData::_index_directory(const String &p_dir) {
+	if (p_dir.is_empty()) {
+		LOG(ERROR, "Specified directory name is blank");
+		return;
+	}
+	LOG(INFO, "Indexing region files in ", p_dir, " for streaming");
+	std::vector<std::pair<Vector2i, String>> files = _get_region_files(p_dir);
+	if (files.empty()) {
+		LOG(INFO, "No Terrain3D region files found in: ", p_dir);
+		return;
+	}
+	_clear();
+	for (const std::pair<Vector2i, String> &file : files) {
+		_streamed_regions[file.first].path = file.second;
+	}
+	LOG(INFO, "Indexed ", int(_streamed_regions.size()), " region files");
+}
+
+/** Queues the region files within the streaming radius of p_global_position to load in the
+ * background, nearest first. Regions loaded this way are unloaded again, least recently used
+ * first, once outside of the radius while over the memory budget. Modified regions are never
+ * unloaded. Called by Terrain3D every physics frame while region streaming is enabled. The first
+ * call waits for the regions within the radius, so the terrain near the spawn point is ready.
+ */
+void Terrain3DData::_update_streaming(const Vector3 &p_global_position) {
+	if (_streamed_regions.empty() || _region_size <= 0) {
+		return;
+	}
+	_stream_tick++;
+	const bool blocking = !_stream_started;
+	_stream_started = true;
+	const real_t radius = _terrain->get_streaming_radius();
+	const real_t region_width = real_t(_region_size) * _vertex_spacing;
+	const Vector2 pos = v3v2(p_global_position);
+
+	// Find the unloaded regions within the radius, and mark the rest as used
+	std::vector<std::pair<real_t, Vector2i>> wanted;
+	int queued = 0;
+	for (auto &it : _streamed_regions) {
+		StreamedRegion &streamed = it.second;
+		queued += streamed.requested ? 1 : 0;
+		const Vector2 region_min = Vector2(it.first) * region_width;
+		const Vector2 region_max = region_min + Vector2(region_width, region_width);
+		const real_t distance = pos.distance_to(pos.clamp(region_min, region_max));
+		if (distance > radius) {
+			continue;
+		}
+		streamed.last_used = _stream_tick;
+		if (!streamed.requested && !streamed.failed && !_regions.has(it.first)) {
+			wanted.push_back({ distance, it.first });
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+	for (const auto &it : wanted) {
+		if (!blocking && queued >= LOAD_REQUESTS) {
+			break;
+		}
+		StreamedRegion &streamed = _streamed_regions[it.second];
+		if (_queue_load(it.second, streamed.path, true)) {
+			streamed.requested = true;
+			queued++;
+		}
+	}
+	if (blocking) {
+		_process_loads(true);
+	}
+
+	// Unload the least recently used regions outside of the radius while over budget
+	TypedArray<Vector2i> removed;
+	const uint64_t budget = uint64_t(_terrain->get_streaming_memory_budget()) * 1024 * 1024;
+	if (_stream_memory > budget) {
+		std::vector<std::pair<uint64_t, Vector2i>> unused;
+		for (const auto &it : _streamed_regions) {
+			const StreamedRegion &streamed = it.second;
+			if (streamed.memory == 0 || streamed.last_used == _stream_tick) {
+				continue;
+			}
+			Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions.get(it.first, Variant()));
+			if (region && !region->is_modified() && !region->is_edited() && !region->is_deleted()) {
+				unused.push_back({ streamed.last_used, it.first });
+			}
+		}
+		std::sort(unused.begin(), unused.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+		for (const auto &it : unused) {
+			if (_stream_memory <= budget) {
+				break;
+			}
+			StreamedRegion &streamed = _streamed_regions[it.second];
+			_stream_memory -= streamed.memory;
+			streamed.memory = 0;
+			removed.push_back(it.second);
+		}
+	}
+	if (!removed.is_empty()) {
+		LOG(INFO, "Unloading ", removed.size(), " streamed regions. Memory used: ", int64_t(_stream_memory / (1024 * 1024)), " MB");
+		_commit_regions(TypedArray<Terrain3DRegion>(), removed);
+	}
+}
+
+// Forgets the streaming index. Call _cancel_loads() first.
+void Terrain3DData::_stop_streaming() {
+	_streamed_regions.clear();
+	_stream_tick = 0;
+	_stream_memory = 0;
+	_stream_started = false;
+}
+
+// Refreshes the map pointers of the region already assigned to this slot
+void Terrain3DData::_update_region_ptrs(const int p_region_id) {
+	RegionPtrs &ptrs = _region_ptrs[p_region_id];
+	Terrain3DRegion *region = ptrs.region;
+	ptrs = RegionPtrs();
+	if (!region) {
+		return;
+	}
+	ptrs.region = region;
+	ptrs.offset = region->get_location() * _region_size;
+	// Maps with an unexpected format or size keep a null pointer and are read via the Image API.
+	// Memory mapped maps are validated when mapped. Sparse maps are read through their tiles.
+	auto get_ptr = [&](const MapType p_map_type) -> const uint8_t * {
+		if (const uint8_t *mapped = region->get_mapped_ptr(p_map_type)) {
+			return mapped;
+		}
+		if (region->is_sparse(p_map_type)) {
+			return nullptr;
+		}
+		Image *map = region->get_map_ptr(p_map_type);
+		if (!map || map->get_format() != FORMAT[p_map_type] || map->get_size() != _region_sizev) {
+			return nullptr;
+		}
+		return map->ptr();
+	};
+	ptrs.height = reinterpret_cast<const float *>(get_ptr(TYPE_HEIGHT));
+	ptrs.control = reinterpret_cast<const uint32_t *>(get_ptr(TYPE_CONTROL));
+	ptrs.color = get_ptr(TYPE_COLOR);
+	ptrs.sparse_height = region->get_sparse_map(TYPE_HEIGHT).get();
+	ptrs.sparse_control = region->get_sparse_map(TYPE_CONTROL).get();
+	ptrs.pyramid = region->get_height_pyramid().get();
+}
+
+// Returns p_maps with the released maps of memory mapped and sparse regions copied into temporary
+// Images for upload
+TypedArray<Image> Terrain3DData::_get_upload_maps(const MapType p_map_type, const TypedArray<Image> &p_maps) const {
+	TypedArray<Image> maps = p_maps.duplicate();
+	for (int i = 0; i < maps.size() && i < _region_locations.size(); i++) {
+		Ref<Image> map = maps[i];
+		if (map.is_valid()) {
+			continue;
+		}
+		const Terrain3DRegion *region = get_region_ptr(_region_locations[i]);
+		if (region) {
+			maps[i] = region->read_map(p_map_type);
+		}
+	}
+	return maps;
+}
+
+// Drops the copies of memory mapped and sparse maps once uploaded, so only the mapping or the
+// tiles hold their data
+void Terrain3DData::_release_map_copies() {
+	TypedArray<Image> *maps[TYPE_MAX] = { &_height_maps, &_control_maps, &_color_maps };
+	for (int i = 0; i < _region_locations.size(); i++) {
+		const Terrain3DRegion *region = get_region_ptr(_region_locations[i]);
+		if (!region) {
+			continue;
+		}
+		for (int m = 0; m < TYPE_MAX; m++) {
+			const MapType map_type = MapType(m);
+			if ((region->get_mapped_ptr(map_type) || region->is_sparse(map_type)) && i < maps[m]->size()) {
+				(*maps[m])[i] = Ref<Image>();
+			}
+		}
+	}
+}
+
+// Uploads the pages of the region map for the shader, which reads the page table from a uniform.
+// Recreated only when pages are added, which changes its size.
+void Terrain3DData::_update_region_map_texture() {
+	const int page_count = RegionMap::get_page_count(_region_map);
+	PackedByteArray bytes;
+	bytes.resize(page_count * RegionMap::BLOCK_AREA * sizeof(float));
+	float *pixels = reinterpret_cast<float *>(bytes.ptrw());
+	const int32_t *pages = _region_map.ptr() + RegionMap::PAGE_TABLE_SIZE;
+	for (int i = 0; i < page_count * RegionMap::BLOCK_AREA; i++) {
+		pixels[i] = float(pages[i]);
+	}
+	Ref<Image> img = Image::create_from_data(RegionMap::BLOCK_SIZE, RegionMap::BLOCK_SIZE * page_count, false, Image::FORMAT_RF, bytes);
+	Ref<Image> prev = _generated_region_map.get_image();
+	if (_generated_region_map.get_rid().is_valid() && prev.is_valid() && prev->get_size() == img->get_size()) {
+		LOG(EXTREME, "Updating region map texture, pages: ", page_count);
+		RS->texture_2d_update(_generated_region_map.get_rid(), img, 0);
+		return;
+	}
+	LOG(EXTREME, "Creating region map texture, pages: ", page_count);
+	_generated_region_map.clear();
+	_generated_region_map.create(img);
+}
+
+// Rebuilds the region map and region ids from the active regions if marked dirty
+void Terrain3DData::_update_region_map() {
+	if (!_region_map_dirty) {
+		return;
+	}
+	LOG(EXTREME, "Regenerating ", REGION_MAP_VSIZE, " region map array from active regions");
+	RegionMap::clear(_region_map);
+	_region_map_dirty = false;
+	_region_locations = TypedArray<Vector2i>(); // enforce new pointer
+	Array locs = _regions.keys();
+	int region_id = 0;
+	for (int i = 0; i < locs.size(); i++) {
+		Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions[locs[i]]);
+		if (region && !region->is_deleted()) {
+			if (region_id >= MAX_REGIONS) {
+				LOG(ERROR, "Region ", region->get_location(), " not activated. The maximum of ", MAX_REGIONS, " active regions is reached");
+				continue;
+			}
+			region_id += 1; // Begin at 1 since 0 = no region
+			if (get_region_map_index(region->get_location()) >= 0) {
+				RegionMap::set_entry(_region_map, region->get_location() + (REGION_MAP_VSIZE / 2), region_id);
+				_region_locations.push_back(region->get_location());
+			}
+		}
+	}
+	_update_region_map_texture();
+	// Listeners may query the new regions
+	update_region_ptrs();
+	_region_map_changed = true;
+	emit_signal("region_map_changed");
+}
+
+/** Uploads the texture array layers of regions added, moved or replaced by _commit_regions().
+ * The arrays are only recreated when they need more layers, and then with spare layers so the
+ * next regions are written into the existing arrays.
+ */
+void Terrain3DData::_upload_queued_layers() {
+	std::vector<bool> layers;
+	layers.swap(_queued_layers);
+	// The region map may now point at the new layers
+	_update_region_map_texture();
+	const int region_count = _region_locations.size();
+	const int capacity = MIN(MAX_REGIONS, region_count + MAX(LOAD_COMMITS, region_count / SPARE_LAYERS_DIVISOR));
+	int uploads = 0;
+	auto update_texture = [&](GeneratedTexture &p_texture, const TypedArray<Image> &p_maps, const MapType p_map_type) {
+		if (p_maps.is_empty()) {
+			p_texture.clear();
+		} else if (p_texture.get_rid().is_valid() && p_maps.size() <= p_texture.get_layer_count()) {
+			for (int i = 0; i < p_maps.size() && i < int(layers.size()); i++) {
+				if (!layers[i]) {
+					continue;
+				}
+				// Released maps of memory mapped and sparse regions are read from the region
+				Ref<Image> map = p_maps[i];
+				if (map.is_null()) {
+					const Terrain3DRegion *region = get_region_ptr(_region_locations[i]);
+					map = region ? region->read_map(p_map_type) : Ref<Image>();
+				}
+				if (map.is_valid()) {
+					p_texture.update(map, i);
+					uploads++;
+				}
+			}
+		} else {
+			TypedArray<Image> upload = _get_upload_maps(p_map_type, p_maps);
+			while (upload.size() < capacity) {
+				upload.push_back(upload.back());
+			}
+			LOG(DEBUG, "Recreating ", TYPESTR[p_map_type], " texture array with ", upload.size(), " layers for ", region_count, " regions");
+			p_texture.clear();
+			p_texture.create(upload);
+		}
+	};
+	update_texture(_generated_height_maps, _height_maps, TYPE_HEIGHT);
+	update_texture(_generated_control_maps, _control_maps, TYPE_CONTROL);
+	update_texture(_generated_color_maps, _color_maps, TYPE_COLOR);
+	LOG(EXTREME, "Uploaded ", uploads, " texture array layers of committed regions");
+	_release_map_copies();
+	_publish_snapshot();
+	emit_signal("height_maps_changed");
+	emit_signal("control_maps_changed");
+	emit_signal("color_maps_changed");
+	emit_signal("maps_changed");
+}
+
+void Terrain3DData::_publish_snapshot() {
+	std::atomic_store(&_snapshot, std::shared_ptr<const DataSnapshot>(std::make_shared<DataSnapshot>(this)));
+}
+
+// The live maps are only modified on the main thread, so it reads them directly. Worker threads
+// spawned from the main thread may too, as it waits on them. Other threads read the last snapshot,
+// which is kept alive by r_snapshot. Returns nullptr if no snapshot has been published yet.
+const MapSampler *Terrain3DData::_get_thread_sampler(std::shared_ptr<const DataSnapshot> &r_snapshot) const {
+	if (OS::get_singleton()->get_thread_caller_id() == OS::get_singleton()->get_main_thread_id()) {
+		return &_sampler;
+	}
+	r_snapshot = get_snapshot();
+	return r_snapshot ? &r_snapshot->get_sampler() : nullptr;
+}
+
+/** Builds height pyramids for regions that need them, and refreshes the edge cells of the others
+ * whose neighbors may have changed, since those read the first row and column of the next regions.
+ * Called by update_maps() once the region pointers are current.
+ *	p_all - rebuild all pyramids, otherwise only those missing or of the wrong size
+ *	p_all_edges - refresh the edges of all regions, otherwise only those next to rebuilt regions
+ *	p_edited_edges - also refresh those next to regions marked edited
+ */
+void Terrain3DData::_build_height_pyramids(const bool p_all, const bool p_all_edges, const bool p_edited_edges) {
+	const int region_count = int(_region_ptrs.size());
+	std::vector<int> builds;
+	std::vector<bool> built(region_count, false);
+	for (int i = 0; i < region_count; i++) {
+		Terrain3DRegion *region = _region_ptrs[i].region;
+		if (!region || region->is_deleted()) {
+			continue;
+		}
+		std::shared_ptr<HeightPyramid> pyramid = region->get_height_pyramid();
+		if (p_all || !pyramid || pyramid->get_size() != _region_size) {
+			builds.push_back(i);
+			built[i] = true;
+		}
+	}
+	if (!builds.empty()) {
+		LOG(DEBUG, "Building height pyramids for ", builds.size(), " regions");
+		// Each task only writes to its own region
+		Util::parallel_for(int(builds.size()), [&](const int p_from, const int p_to) {
+			for (int i = p_from; i < p_to; i++) {
+				RegionPtrs &ptrs = _region_ptrs[builds[i]];
+				std::shared_ptr<HeightPyramid> pyramid = std::make_shared<HeightPyramid>();
+				pyramid->build(_sampler, ptrs);
+				ptrs.region->set_height_pyramid(pyramid);
+				ptrs.pyramid = pyramid.get();
+			}
+		}, 1);
+	}
+
+	std::vector<bool> edges(region_count, p_all_edges);
+	for (int i = 0; i < region_count; i++) {
+		Terrain3DRegion *region = _region_ptrs[i].region;
+		if (!region || (!built[i] && !(p_edited_edges && region->is_edited()))) {
+			continue;
+		}
+		// Regions whose last row or column reads this one
+		const Vector2i region_loc = region->get_location();
+		edges[i] = true;
+		for (const Vector2i &offset : { Vector2i(-1, 0), Vector2i(0, -1), Vector2i(-1, -1) }) {
+			int region_id = get_region_id(region_loc + offset);
+			if (region_id >= 0) {
+				edges[region_id] = true;
+			}
+		}
+	}
+	for (int i = 0; i < region_count; i++) {
+		if (edges[i] && !built[i]) {
+			_update_height_pyramid_edges(i);
+		}
+	}
+}
+
+// Recalculates the last row and column of a region's height pyramid, which read its neighbors
+void Terrain3DData::_update_height_pyramid_edges(const int p_region_id) {
+	_update_height_pyramid(p_region_id, Rect2i(_region_size - 1, 0, 1, _region_size));
+	_update_height_pyramid(p_region_id, Rect2i(0, _region_size - 1, _region_size, 1));
+}
+
+// Recalculates cells of one region's height pyramid, given in region pixels. The pyramid is
+// copied first if a snapshot still reads it.
+void Terrain3DData::_update_height_pyramid(const int p_region_id, const Rect2i &p_cells) {
+	RegionPtrs &ptrs = _region_ptrs[p_region_id];
+	if (!ptrs.region || ptrs.region->is_deleted()) {
+		return;
+	}
+	std::shared_ptr<HeightPyramid> pyramid = ptrs.region->get_height_pyramid();
+	if (!pyramid || pyramid->get_size() != _region_size) {
+		return; // Built by the next update_maps()
+	}
+	// Held by the region, this function, and any snapshots
+	if (pyramid.use_count() > 2) {
+		pyramid = std::make_shared<HeightPyramid>(*pyramid);
+		ptrs.region->set_height_pyramid(pyramid);
+		ptrs.pyramid = pyramid.get();
+	}
+	pyramid->update(_sampler, ptrs, p_cells);
+}
+
+// Refreshes the height pyramids over the vertices written by set_pixel() since the last call
+void Terrain3DData::_update_dirty_pyramids() {
+	for (const auto &it : _dirty_pyramids) {
+		_update_height_pyramids(Rect2i(it.first * _region_size + it.second.position, it.second.size));
+	}
+	_dirty_pyramids.clear();
+}
+
+// Recalculates the pyramid cells of all quads touching the given descaled vertices, which may
+// extend into the regions to the left and above.
+void Terrain3DData::_update_height_pyramids(const Rect2i &p_vertices) {
+	const Rect2i cells = Rect2i(p_vertices.position - Vector2i(1, 1), p_vertices.size + Vector2i(1, 1));
+	const Vector2i loc_from = Vector2i((Vector2(cells.position) / real_t(_region_size)).floor());
+	const Vector2i loc_to = Vector2i((Vector2(cells.get_end() - Vector2i(1, 1)) / real_t(_region_size)).floor());
+	for (int y = loc_from.y; y <= loc_to.y; y++) {
+		for (int x = loc_from.x; x <= loc_to.x; x++) {
+			const Vector2i region_loc = Vector2i(x, y);
+			int region_id = get_region_id(region_loc);
+			if (region_id >= 0 && region_id < int(_region_ptrs.size())) {
+				_update_height_pyramid(region_id, Rect2i(cells.position - region_loc * _region_size, cells.size));
+			}
+		}
+	}
+}
+
+// Answers a batch of queries, grouped by region so each region's buffers are read while hot, and
+// split across worker threads. p_sample(ptrs, descaled_pos) is called for each position in a
+// region, and p_none is stored for the others.
+template <typename T, typename F>
+static void batch_query(const MapSampler &p_sampler, const PackedVector3Array &p_global_positions, T *r_out,
+		const T &p_none, const F &p_sample) {
+	const int count = p_global_positions.size();
+	const Vector3 *positions = p_global_positions.ptr();
+	const int batch_size = 1024;
+
+	// Find each region. Group 0 is no region, others are region_id + 1
+	std::vector<int> groups(count);
+	Util::parallel_for(count, [&](const int p_from, const int p_to) {
+		for (int i = p_from; i < p_to; i++) {
+			const MapSampler::RegionPtrs *ptrs = p_sampler.get_region_ptrs(v3v2(positions[i]) / p_sampler.vertex_spacing);
+			groups[i] = ptrs ? int(ptrs - p_sampler.regions) + 1 : 0;
+		}
+	}, batch_size);
+
+	// Counting sort queries by group
+	std::vector<int> group_start(p_sampler.region_count + 2, 0);
+	for (int i = 0; i < count; i++) {
+		group_start[groups[i] + 1]++;
+	}
+	for (size_t g = 1; g < group_start.size(); g++) {
+		group_start[g] += group_start[g - 1];
+	}
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++) {
+		order[group_start[groups[i]]++] = i;
+	}
+
+	// Sample
+	Util::parallel_for(count, [&](const int p_from, const int p_to) {
+		for (int i = p_from; i < p_to; i++) {
+			int q = order[i];
+			int group = groups[q];
+			r_out[q] = group ? p_sample(p_sampler.regions[group - 1], v3v2(positions[q]) / p_sampler.vertex_spacing) : p_none;
+		}
+	}, batch_size);
+}
+
 ///////////////////////////
 // Public Functions
 ///////////////////////////
@@ -55,13 +908,22 @@ void Terrain3DData::initialize(Terrain3D *p_terrain) {
 	LOG(INFO, "Initializing data");
 	bool prev_initialized = _terrain != nullptr;
 	_terrain = p_terrain;
-	_region_map.resize(REGION_MAP_SIZE * REGION_MAP_SIZE);
+	if (_region_map.is_empty()) {
+		RegionMap::clear(_region_map);
+	}
 	_vertex_spacing = _terrain->get_vertex_spacing();
 	if (!prev_initialized && !_terrain->get_data_directory().is_empty()) {
-		load_directory(_terrain->get_data_directory());
+		if (_terrain->get_mapped_regions() && !IS_EDITOR) {
+			map_directory(_terrain->get_data_directory());
+		} else if (_terrain->get_region_streaming() && !IS_EDITOR) {
+			_index_directory(_terrain->get_data_directory());
+		} else {
+			load_directory(_terrain->get_data_directory());
+		}
 	}
 	_region_size = _terrain->get_region_size();
 	_region_sizev = Vector2i(_region_size, _region_size);
+	update_region_ptrs();
 }
 
 void Terrain3DData::set_region_locations(const TypedArray<Vector2i> &p_locations) {
@@ -71,6 +933,34 @@ void Terrain3DData::set_region_locations(const TypedArray<Vector2i> &p_locations
 	update_maps(TYPE_MAX, false, false); // only rebuild region map
 }
 
+/** Returns the region map as a flat REGION_MAP_SIZE^2 array indexed by get_region_map_index(),
+ * as before it was stored in pages. It's built on request from the blocks in use, so prefer
+ * get_region_id() for lookups, and get_region_map_pages() for the stored layout.
+ */
+PackedInt32Array Terrain3DData::get_region_map() const {
+	PackedInt32Array flat_map;
+	flat_map.resize(REGION_MAP_SIZE * REGION_MAP_SIZE);
+	flat_map.fill(0);
+	if (_region_map.size() < RegionMap::PAGE_TABLE_SIZE + RegionMap::BLOCK_AREA) {
+		return flat_map;
+	}
+	const int32_t *pages = _region_map.ptr();
+	int32_t *flat = flat_map.ptrw();
+	for (int block = 0; block < RegionMap::PAGE_TABLE_SIZE; block++) {
+		const int page = pages[block];
+		if (page == 0) {
+			continue;
+		}
+		const int32_t *src = pages + RegionMap::PAGE_TABLE_SIZE + page * RegionMap::BLOCK_AREA;
+		const Vector2i origin = Vector2i(block % RegionMap::BLOCKS, block / RegionMap::BLOCKS) * RegionMap::BLOCK_SIZE;
+		for (int y = 0; y < RegionMap::BLOCK_SIZE; y++) {
+			memcpy(flat + (origin.y + y) * REGION_MAP_SIZE + origin.x, src + y * RegionMap::BLOCK_SIZE,
+					RegionMap::BLOCK_SIZE * sizeof(int32_t));
+		}
+	}
+	return flat_map;
+}
+
 // Returns an array of active regions, optionally a shallow or deep copy
 TypedArray<Terrain3DRegion> Terrain3DData::get_regions_active(const bool p_copy, const bool p_deep) const {
 	TypedArray<Terrain3DRegion> region_arr;
@@ -174,7 +1064,7 @@ void Terrain3DData::change_region_size(int p_new_size) {
 	}
 
 	calc_height_range(true);
-	update_maps(TYPE_MAX, true, true);
+	queue_map_update(TYPE_MAX, true, true);
 	_terrain->get_instancer()->update_mmis(true);
 }
 
@@ -249,21 +1139,18 @@ Error Terrain3DData::add_region(const Ref<Terrain3DRegion> &p_region, const bool
 				-REGION_MAP_SIZE / 2, " to ", REGION_MAP_SIZE / 2 - 1);
 		return FAILED;
 	}
-	p_region->sanitize_maps();
-	p_region->set_deleted(false);
-	if (!_region_locations.has(region_loc)) {
-		_region_locations.push_back(region_loc);
-	} else {
-		LOG(INFO, "Overwriting ", (_regions.has(region_loc)) ? "deleted" : "existing", " region at ", region_loc);
-	}
-	_regions[region_loc] = p_region;
-	_region_map_dirty = true;
-	LOG(DEBUG, "Storing region ", region_loc, " version ", vformat("%.3f", p_region->get_version()), " id: ", _region_locations.size());
 	if (p_update) {
-		update_maps(TYPE_MAX, true, false);
-		_terrain->get_instancer()->update_mmis(true);
+		if (!_region_locations.has(region_loc) && _region_locations.size() >= MAX_REGIONS) {
+			LOG(ERROR, "Cannot add region ", region_loc, ". The maximum of ", MAX_REGIONS, " active regions is reached");
+			return FAILED;
+		}
+		// Only writes the layer of this region
+		TypedArray<Terrain3DRegion> added;
+		added.push_back(p_region);
+		_commit_regions(added, TypedArray<Vector2i>(), false);
+		return OK;
 	}
-	return OK;
+	return _add_region(p_region, true);
 }
 
 void Terrain3DData::remove_regionp(const Vector3 &p_global_position, const bool p_update) {
@@ -291,22 +1178,77 @@ void Terrain3DData::remove_region(const Ref<Terrain3DRegion> &p_region, const bo
 		LOG(ERROR, "Region ", region_loc, " not found in region_locations. Returning");
 		return;
 	}
+	if (p_update) {
+		// Moves the last region into its slot, writing one layer
+		TypedArray<Vector2i> removed;
+		removed.push_back(region_loc);
+		_commit_regions(TypedArray<Terrain3DRegion>(), removed, false);
+		return;
+	}
 	p_region->set_deleted(true);
 	_region_locations.remove_at(region_id);
 	_region_map_dirty = true;
 	LOG(DEBUG, "Removing from region_locations, new size: ", _region_locations.size());
-	if (p_update) {
-		LOG(DEBUG, "Updating generated maps");
-		update_maps(TYPE_MAX, true, false);
-		_terrain->get_instancer()->update_mmis(true);
-	}
 }
 
+/** Saves all modified regions to p_dir, and removes the files of regions marked for deletion.
+ * Modified regions are written in parallel on the WorkerThreadPool, from copies so the live maps
+ * are never changed. See Terrain3DRegion::write().
+ */
 void Terrain3DData::save_directory(const String &p_dir) {
 	LOG(INFO, "Saving data files to ", p_dir);
+	uint64_t start_time = Time::get_singleton()->get_ticks_usec();
+	const bool save_16_bit = _terrain->get_save_16_bit();
+	struct SaveJob {
+		Ref<Terrain3DRegion> region;
+		String path;
+		Error err = OK;
+		uint64_t bytes = 0;
+		uint64_t usec = 0;
+	};
+	std::vector<SaveJob> jobs;
 	Array locations = _regions.keys();
 	for (int i = 0; i < locations.size(); i++) {
-		save_region(locations[i], p_dir, _terrain->get_save_16_bit());
+		Vector2i region_loc = locations[i];
+		Ref<Terrain3DRegion> region = get_region(region_loc);
+		if (region.is_null() || region->is_deleted() || !region->is_modified()) {
+			save_region(region_loc, p_dir, save_16_bit);
+			continue;
+		}
+		SaveJob job;
+		job.region = region;
+		job.path = p_dir + String("/") + Util::location_to_filename(region_loc);
+		region->take_over_path(job.path);
+		region->set_version(CURRENT_VERSION);
+		jobs.push_back(job);
+	}
+
+	// The main thread waits, so the maps can't change while they're written
+	Util::parallel_for(int(jobs.size()), [&](const int p_from, const int p_to) {
+		for (int i = p_from; i < p_to; i++) {
+			SaveJob &job = jobs[i];
+			uint64_t job_start = Time::get_singleton()->get_ticks_usec();
+			job.err = job.region->write(job.path, save_16_bit, &job.bytes);
+			job.usec = Time::get_singleton()->get_ticks_usec() - job_start;
+		}
+	}, 1);
+
+	uint64_t total_bytes = 0;
+	int saved = 0;
+	for (const SaveJob &job : jobs) {
+		if (job.err != OK) {
+			LOG(ERROR, "Could not save file: ", job.path, ", error: ", UtilityFunctions::error_string(job.err), " (", job.err, ")");
+			continue;
+		}
+		job.region->set_modified(false);
+		total_bytes += job.bytes;
+		saved++;
+		LOG(MESG, "Wrote", (save_16_bit) ? " 16-bit" : "", " region ", job.region->get_location(), " to ", job.path, ": ",
+				int64_t(job.bytes / 1024), " KB in ", vformat("%.1f", double(job.usec) / 1000.0), " ms");
+	}
+	if (saved > 0) {
+		LOG(MESG, "Saved ", saved, " regions, ", int64_t(total_bytes / 1024), " KB in ",
+				vformat("%.1f", double(Time::get_singleton()->get_ticks_usec() - start_time) / 1000.0), " ms");
 	}
 	if (IS_EDITOR && !EditorInterface::get_singleton()->get_resource_filesystem()->is_scanning()) {
 		EditorInterface::get_singleton()->get_resource_filesystem()->scan();
@@ -378,18 +1320,9 @@ void Terrain3DData::load_directory(const String &p_dir) {
 			continue;
 		}
 		LOG(INFO, "Loaded region: ", loc, " size: ", region->get_region_size());
-		if (_regions.is_empty()) {
-			_terrain->set_region_size((Terrain3D::RegionSize)region->get_region_size());
-		} else {
-			if (_terrain->get_region_size() != (Terrain3D::RegionSize)region->get_region_size()) {
-				LOG(ERROR, "Region size mismatch. First loaded: ", _terrain->get_region_size(), " next: ",
-						region->get_region_size(), " in file: ", path);
-				return;
-			}
+		if (_setup_loaded_region(region, loc, path, _regions.is_empty()) != OK) {
+			return;
 		}
-		region->take_over_path(path);
-		region->set_location(loc);
-		region->set_version(CURRENT_VERSION); // Sends upgrade warning if old version
 		add_region(region, false);
 	}
 	update_maps(TYPE_MAX, true, false);
@@ -408,21 +1341,99 @@ void Terrain3DData::load_region(const Vector2i &p_region_loc, const String &p_di
 		LOG(ERROR, "Cannot load region at ", path);
 		return;
 	}
-	if (_regions.is_empty()) {
-		_terrain->set_region_size((Terrain3D::RegionSize)region->get_region_size());
-	} else {
-		if (_terrain->get_region_size() != (Terrain3D::RegionSize)region->get_region_size()) {
-			LOG(ERROR, "Region size mismatch. First loaded: ", _terrain->get_region_size(), " next: ",
-					region->get_region_size(), " in file: ", path);
-			return;
-		}
+	if (_setup_loaded_region(region, p_region_loc, path, _regions.is_empty()) != OK) {
+		return;
 	}
-	region->take_over_path(path);
-	region->set_location(p_region_loc);
-	region->set_version(CURRENT_VERSION); // Sends upgrade warning if old version
 	add_region(region, p_update);
 }
 
+/** Loads all region files in p_dir in the background, replacing the current data, as with
+ * load_directory(). Regions are added to the terrain a few per frame as they finish, emitting
+ * region_loaded for each and load_progress.
+ */
+Error Terrain3DData::load_directory_async(const String &p_dir) {
+	if (p_dir.is_empty()) {
+		LOG(ERROR, "Specified directory name is blank");
+		return ERR_INVALID_PARAMETER;
+	}
+	LOG(INFO, "Loading region files in the background from ", p_dir);
+	std::vector<std::pair<Vector2i, String>> files = _get_region_files(p_dir);
+	if (files.empty()) {
+		LOG(INFO, "No Terrain3D region files found in: ", p_dir);
+		return ERR_FILE_NOT_FOUND;
+	}
+	_clear();
+	update_maps(TYPE_MAX, true, false);
+	for (const std::pair<Vector2i, String> &file : files) {
+		_queue_load(file.first, file.second);
+	}
+	return OK;
+}
+
+/** Loads a region file in the background, as with load_region(). The region is added to the
+ * terrain once ready, emitting region_loaded and load_progress.
+ */
+Error Terrain3DData::load_region_async(const Vector2i &p_region_loc, const String &p_dir) {
+	LOG(INFO, "Loading region in the background from location ", p_region_loc);
+	if (get_region_map_index(p_region_loc) < 0) {
+		LOG(ERROR, "Location ", p_region_loc, " out of bounds. Max: ",
+				-REGION_MAP_SIZE / 2, " to ", REGION_MAP_SIZE / 2 - 1);
+		return ERR_PARAMETER_RANGE_ERROR;
+	}
+	String path = p_dir + String("/") + Util::location_to_filename(p_region_loc);
+	if (!FileAccess::file_exists(path)) {
+		LOG(ERROR, "File ", path, " doesn't exist");
+		return ERR_FILE_NOT_FOUND;
+	}
+	if (!_queue_load(p_region_loc, path)) {
+		LOG(INFO, "Region ", p_region_loc, " is already loading");
+	}
+	return OK;
+}
+
+/** Loads all region files in p_dir written by Terrain3DRegion.save_binary(), replacing the current
+ * data. The height and control maps of mappable files are read directly from read only memory
+ * mappings of the files, which the OS pages in on demand and shares between processes. Only a
+ * temporary copy is made to upload them to the GPU. Files are decoded in parallel.
+ */
+Error Terrain3DData::map_directory(const String &p_dir) {
+	if (p_dir.is_empty()) {
+		LOG(ERROR, "Specified directory name is blank");
+		return ERR_INVALID_PARAMETER;
+	}
+	LOG(INFO, "Mapping region files from ", p_dir);
+	PackedStringArray files = Util::get_files(p_dir, "terrain3d*.t3dr");
+	if (files.size() == 0) {
+		LOG(INFO, "No Terrain3D binary region files found in: ", p_dir);
+		return ERR_FILE_NOT_FOUND;
+	}
+	_clear();
+	std::vector<Ref<Terrain3DRegion>> regions(files.size());
+	Util::parallel_for(files.size(), [&](const int p_from, const int p_to) {
+		for (int i = p_from; i < p_to; i++) {
+			regions[i] = Terrain3DRegion::load_mapped(p_dir + String("/") + files[i]);
+		}
+	}, 1);
+	int mapped = 0;
+	for (int i = 0; i < files.size(); i++) {
+		String fname = files[i];
+		Vector2i loc = Util::filename_to_location(fname);
+		if (loc.x == INT32_MAX || regions[i].is_null()) {
+			LOG(ERROR, "Cannot load region at ", p_dir + String("/") + fname);
+			continue;
+		}
+		if (_setup_loaded_region(regions[i], loc, p_dir + String("/") + fname, _regions.is_empty()) != OK) {
+			return FAILED;
+		}
+		add_region(regions[i], false);
+		mapped += regions[i]->is_mapped() ? 1 : 0;
+	}
+	update_maps(TYPE_MAX, true, false);
+	LOG(INFO, "Loaded ", _regions.size(), " regions, ", mapped, " memory mapped");
+	return OK;
+}
+
+// The maps of memory mapped and sparse regions are returned as copies, which aren't written back
 TypedArray<Image> Terrain3DData::get_maps(const MapType p_map_type) const {
 	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
 		LOG(ERROR, "Specified map type out of range");
@@ -430,14 +1441,11 @@ TypedArray<Image> Terrain3DData::get_maps(const MapType p_map_type) const {
 	}
 	switch (p_map_type) {
 		case TYPE_HEIGHT:
-			return get_height_maps();
-			break;
+			return _get_upload_maps(TYPE_HEIGHT, _height_maps);
 		case TYPE_CONTROL:
-			return get_control_maps();
-			break;
+			return _get_upload_maps(TYPE_CONTROL, _control_maps);
 		case TYPE_COLOR:
-			return get_color_maps();
-			break;
+			return _get_upload_maps(TYPE_COLOR, _color_maps);
 		default:
 			break;
 	}
@@ -445,17 +1453,31 @@ TypedArray<Image> Terrain3DData::get_maps(const MapType p_map_type) const {
 }
 
 void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regions, const bool p_generate_mipmaps) {
+	// Store height and control maps written as Images in tiles again, so the snapshot shares them
+	bool compacted = false;
+	for (int i = 0; i < _region_locations.size(); i++) {
+		Terrain3DRegion *region = get_region_ptr(_region_locations[i]);
+		if (region) {
+			compacted = region->compact_map(TYPE_HEIGHT) || compacted;
+			compacted = region->compact_map(TYPE_CONTROL) || compacted;
+		}
+	}
+	if (compacted) {
+		update_region_ptrs();
+	}
+
 	// Generate region color mipmaps
 	if (p_generate_mipmaps && (p_map_type == TYPE_COLOR || p_map_type == TYPE_MAX)) {
 		LOG(EXTREME, "Regenerating color mipmaps");
 		for (int i = 0; i < _region_locations.size(); i++) {
 			Vector2i region_loc = _region_locations[i];
 			Terrain3DRegion *region = get_region_ptr(region_loc);
-			// Generate all or only those marked edited
-			if (region && (p_all_regions || region->is_edited())) {
-				region->get_color_map()->generate_mipmaps();
+			// Generate all or only those marked edited. Sparse maps get them when copied for upload.
+			if (region && !region->is_sparse(TYPE_COLOR) && (p_all_regions || region->is_edited())) {
+				region->get_map_ptrw(TYPE_COLOR)->generate_mipmaps();
 			}
 		}
+		update_region_ptrs();
 	}
 
 	// Mark texture arrays dirty for rebuilding
@@ -480,31 +1502,12 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 		}
 	}
 
-	bool any_changed = false;
-
-	// Rebuild region map if dirty
-	if (_region_map_dirty) {
-		LOG(EXTREME, "Regenerating ", REGION_MAP_VSIZE, " region map array from active regions");
-		_region_map.clear();
-		_region_map.resize(REGION_MAP_SIZE * REGION_MAP_SIZE);
-		_region_map_dirty = false;
-		_region_locations = TypedArray<Vector2i>(); // enforce new pointer
-		Array locs = _regions.keys();
-		int region_id = 0;
-		for (int i = 0; i < locs.size(); i++) {
-			Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions[locs[i]]);
-			if (region && !region->is_deleted()) {
-				region_id += 1; // Begin at 1 since 0 = no region
-				int map_index = get_region_map_index(region->get_location());
-				if (map_index >= 0) {
-					_region_map[map_index] = region_id;
-					_region_locations.push_back(region->get_location());
-				}
-			}
-		}
-		any_changed = true;
-		emit_signal("region_map_changed");
-	}
+	// Rebuild region map if dirty. It may have been rebuilt already by queue_map_update().
+	_update_region_map();
+	bool region_map_changed = _region_map_changed;
+	bool any_changed = region_map_changed;
+	bool heights_changed = false;
+	_region_map_changed = false;
 
 	// Rebulid height maps if dirty
 	if (_generated_height_maps.is_dirty()) {
@@ -514,16 +1517,17 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 			Vector2i region_loc = _region_locations[i];
 			Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions[region_loc]);
 			if (region) {
-				_height_maps.push_back(region->get_height_map());
+				_height_maps.push_back(region->read_map(TYPE_HEIGHT));
 			} else {
 				LOG(ERROR, "Can't find region ", region_loc, ", _regions: ", _regions,
 						", locations: ", _region_locations, ". Please report this error.");
 				return;
 			}
 		}
-		_generated_height_maps.create(_height_maps);
+		_generated_height_maps.create(_get_upload_maps(TYPE_HEIGHT, _height_maps));
 		calc_height_range();
 		any_changed = true;
+		heights_changed = true;
 		emit_signal("height_maps_changed");
 	}
 
@@ -535,10 +1539,10 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 			Vector2i region_loc = _region_locations[i];
 			Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions[region_loc]);
 			if (region) {
-				_control_maps.push_back(region->get_control_map());
+				_control_maps.push_back(region->read_map(TYPE_CONTROL));
 			}
 		}
-		_generated_control_maps.create(_control_maps);
+		_generated_control_maps.create(_get_upload_maps(TYPE_CONTROL, _control_maps));
 		any_changed = true;
 		emit_signal("control_maps_changed");
 	}
@@ -551,7 +1555,7 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 			Vector2i region_loc = _region_locations[i];
 			Terrain3DRegion *region = cast_to<Terrain3DRegion>(_regions[region_loc]);
 			if (region) {
-				_color_maps.push_back(region->get_color_map());
+				_color_maps.push_back(region->read_map(TYPE_COLOR));
 			}
 		}
 		_generated_color_maps.create(_color_maps);
@@ -561,6 +1565,7 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 
 	// If no maps have been rebuilt, update only individual regions in the array.
 	// Regions marked Edited have been changed by Terrain3DEditor::_operate_map or undo / redo processing.
+	// Only the area painted since the last upload is sent, if the editor recorded it.
 	if (!any_changed) {
 		for (int i = 0; i < _region_locations.size(); i++) {
 			Vector2i region_loc = _region_locations[i];
@@ -569,21 +1574,21 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 				int region_id = get_region_id(region_loc);
 				switch (p_map_type) {
 					case TYPE_HEIGHT:
-						_generated_height_maps.update(region->get_height_map(), region_id);
+						_generated_height_maps.update(region->read_map(TYPE_HEIGHT), region_id, region->take_dirty_rect(TYPE_HEIGHT));
 						emit_signal("height_maps_changed");
 						break;
 					case TYPE_CONTROL:
-						_generated_control_maps.update(region->get_control_map(), region_id);
+						_generated_control_maps.update(region->read_map(TYPE_CONTROL), region_id, region->take_dirty_rect(TYPE_CONTROL));
 						emit_signal("control_maps_changed");
 						break;
 					case TYPE_COLOR:
-						_generated_color_maps.update(region->get_color_map(), region_id);
+						_generated_color_maps.update(region->read_map(TYPE_COLOR), region_id, region->take_dirty_rect(TYPE_COLOR));
 						emit_signal("color_maps_changed");
 						break;
 					default:
-						_generated_height_maps.update(region->get_height_map(), region_id);
-						_generated_control_maps.update(region->get_control_map(), region_id);
-						_generated_color_maps.update(region->get_color_map(), region_id);
+						_generated_height_maps.update(region->read_map(TYPE_HEIGHT), region_id, region->take_dirty_rect(TYPE_HEIGHT));
+						_generated_control_maps.update(region->read_map(TYPE_CONTROL), region_id, region->take_dirty_rect(TYPE_CONTROL));
+						_generated_color_maps.update(region->read_map(TYPE_COLOR), region_id, region->take_dirty_rect(TYPE_COLOR));
 						emit_signal("height_maps_changed");
 						emit_signal("control_maps_changed");
 						emit_signal("color_maps_changed");
@@ -592,33 +1597,191 @@ void Terrain3DData::update_maps(const MapType p_map_type, const bool p_all_regio
 			}
 		}
 	}
+	_release_map_copies();
+	update_region_ptrs();
+	_build_height_pyramids(heights_changed, region_map_changed, p_map_type == TYPE_HEIGHT || p_map_type == TYPE_MAX);
+	_update_dirty_pyramids();
+	_publish_snapshot();
 	emit_signal("maps_changed");
 }
 
+/** Queues update_maps() to run once at the end of the frame, merged with other queued updates.
+ * Use this instead of update_maps() when many changes may be made in one frame. The region map
+ * is rebuilt immediately, so new regions can be queried, but texture arrays and signals wait for
+ * flush_map_updates(). Parameters are the same as update_maps().
+ */
+void Terrain3DData::queue_map_update(const MapType p_map_type, const bool p_all_regions, const bool p_generate_mipmaps) {
+	if (p_map_type < 0 || p_map_type > TYPE_MAX) {
+		LOG(ERROR, "Specified map type out of range");
+		return;
+	}
+	// Bit TYPE_MAX marks the region map for rebuilding, as update_maps(TYPE_MAX, true) does
+	const uint32_t types = (p_map_type == TYPE_MAX) ? (1u << (TYPE_MAX + 1)) - 1u : 1u << p_map_type;
+	if (p_all_regions) {
+		_queued_rebuilds |= types;
+		if (p_map_type == TYPE_MAX) {
+			_region_map_dirty = true;
+		}
+	} else {
+		_queued_updates |= types;
+	}
+	_queued_mipmaps = _queued_mipmaps || p_generate_mipmaps;
+	_update_region_map();
+	_queue_flush();
+}
+
+// Defers flush_map_updates() to the end of the frame, once
+void Terrain3DData::_queue_flush() {
+	if (!_flush_queued) {
+		_flush_queued = true;
+		callable_mp(this, &Terrain3DData::flush_map_updates).call_deferred();
+	}
+}
+
+/** Runs the map updates queued by queue_map_update() now, as one call to update_maps().
+ * Called automatically at the end of the frame. Call it before reading the texture arrays, or
+ * clearing the edited flag of regions, in the same frame as queuing.
+ */
+void Terrain3DData::flush_map_updates() {
+	_flush_queued = false;
+	if (_queued_rebuilds == 0 && _queued_updates == 0 && _queued_layers.empty()) {
+		return;
+	}
+	const uint32_t all = (1u << (TYPE_MAX + 1)) - 1u;
+	uint32_t rebuilds = _queued_rebuilds;
+	uint32_t updates = _queued_updates;
+	const bool mipmaps = _queued_mipmaps;
+	_queued_rebuilds = 0;
+	_queued_updates = 0;
+	_queued_mipmaps = false;
+	// Layer updates are skipped when any array is rebuilt, so those maps are rebuilt as well
+	if (rebuilds != 0) {
+		rebuilds |= updates & ~(1u << TYPE_MAX);
+		updates = 0;
+		_queued_layers.clear();
+	} else if (!_queued_layers.empty()) {
+		_upload_queued_layers();
+		if (updates == 0) {
+			return;
+		}
+	}
+	LOG(DEBUG, "Flushing queued map updates, rebuilds: ", rebuilds, ", updates: ", updates);
+	if (rebuilds == all) {
+		update_maps(TYPE_MAX, true, mipmaps);
+		return;
+	}
+	const uint32_t types = (rebuilds | updates) & ~(1u << TYPE_MAX);
+	MapType map_type = TYPE_MAX;
+	for (int i = 0; i < TYPE_MAX; i++) {
+		if (types == 1u << i) {
+			map_type = MapType(i);
+		}
+	}
+	// Mark the arrays dirty directly, as update_maps() only rebuilds one type or all
+	GeneratedTexture *textures[TYPE_MAX] = { &_generated_height_maps, &_generated_control_maps, &_generated_color_maps };
+	for (int i = 0; i < TYPE_MAX; i++) {
+		if (rebuilds & (1u << i)) {
+			textures[i]->clear();
+		}
+	}
+	update_maps(map_type, false, mipmaps);
+}
+
+/** Refreshes the raw map pointers used by the query functions.
+ * Called by update_maps(). Writing to an Image may reallocate its buffer, so call this after
+ * modifying the maps of a region directly, before querying it again.
+ *	p_region_loc - refresh only this region, or all regions if V2I_MAX
+ */
+void Terrain3DData::update_region_ptrs(const Vector2i &p_region_loc) {
+	if (p_region_loc == V2I_MAX) {
+		_region_ptrs.resize(_region_locations.size());
+		for (int i = 0; i < _region_locations.size(); i++) {
+			_region_ptrs[i].region = cast_to<Terrain3DRegion>(_regions[_region_locations[i]]);
+			_update_region_ptrs(i);
+		}
+		_sampler.region_map = _region_map.ptr();
+		_sampler.region_map_size = REGION_MAP_SIZE;
+		_sampler.regions = _region_ptrs.data();
+		_sampler.region_count = int(_region_ptrs.size());
+		_sampler.region_size = _region_size;
+		_sampler.vertex_spacing = _vertex_spacing;
+		return;
+	}
+	int region_id = get_region_id(p_region_loc);
+	if (region_id >= 0 && region_id < int(_region_ptrs.size())) {
+		_update_region_ptrs(region_id);
+	}
+}
+
 void Terrain3DData::set_pixel(const MapType p_map_type, const Vector3 &p_global_position, const Color &p_pixel) {
 	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
 		LOG(ERROR, "Specified map type out of range");
 		return;
 	}
-	Vector2i region_loc = get_region_location(p_global_position);
-	Terrain3DRegion *region = get_region_ptr(region_loc);
-	if (!region) {
+	const RegionPtrs *ptrs;
+	int index = _get_pixel_index(p_global_position, ptrs);
+	if (index < 0) {
 		LOG(ERROR, "No active region found at: ", p_global_position);
 		return;
 	}
-	if (region->is_deleted()) {
-		LOG(ERROR, "No active region found at: ", p_global_position);
-		return;
+	int region_id = int(ptrs - _region_ptrs.data());
+	Terrain3DRegion *region = ptrs->region;
+	const Vector2i pixel = Vector2i(index % _region_size, index / _region_size);
+	// Pointers are only refreshed if the write moved the map, which is at most once after each
+	// snapshot, rather than per pixel. Height pyramids are refreshed by update_maps().
+	const void *live_ptr = nullptr;
+	const SparseMap *live_sparse = nullptr;
+	switch (p_map_type) {
+		case TYPE_HEIGHT:
+			live_ptr = ptrs->height;
+			live_sparse = ptrs->sparse_height;
+			break;
+		case TYPE_CONTROL:
+			live_ptr = ptrs->control;
+			live_sparse = ptrs->sparse_control;
+			break;
+		default:
+			live_ptr = ptrs->color;
+			break;
 	}
-	Vector2i global_offset = region_loc * _region_size;
-	Vector3 descaled_pos = p_global_position / _vertex_spacing;
-	Vector2i img_pos = Vector2i(descaled_pos.x - global_offset.x, descaled_pos.z - global_offset.y);
-	img_pos = img_pos.clamp(V2I_ZERO, Vector2i(_region_size - 1, _region_size - 1));
-	Image *map = region->get_map_ptr(p_map_type);
-	if (map) {
-		map->set_pixelv(img_pos, p_pixel);
-		region->set_modified(true);
+	// Sparse maps only give the written tile its own pixels. They're copied first if a snapshot
+	// shares them.
+	if (SparseMap *sparse = region->get_sparse_map_ptrw(p_map_type)) {
+		sparse->set_pixel(pixel.x, pixel.y, p_pixel);
+		if (live_sparse && live_sparse != sparse) {
+			_update_region_ptrs(region_id);
+		}
+	} else {
+		Image *map = region->get_map_ptrw(p_map_type);
+		if (!map) {
+			if (region->get_mapped_ptr(p_map_type)) {
+				LOG(ERROR, "Cannot write to memory mapped ", TYPESTR[p_map_type], " of region ", region->get_location());
+			}
+			return;
+		}
+		// Write directly into the buffer if it has the expected format. ptrw() separates the buffer
+		// if it's shared. The next update_maps() stores a height or control map in tiles again.
+		if (!live_ptr) {
+			map->set_pixelv(pixel, p_pixel);
+		} else if (p_map_type == TYPE_COLOR) {
+			uint8_t *rgba = map->ptrw() + index * 4;
+			rgba[0] = uint8_t(CLAMP(p_pixel.r * 255.0, 0., 255.));
+			rgba[1] = uint8_t(CLAMP(p_pixel.g * 255.0, 0., 255.));
+			rgba[2] = uint8_t(CLAMP(p_pixel.b * 255.0, 0., 255.));
+			rgba[3] = uint8_t(CLAMP(p_pixel.a * 255.0, 0., 255.));
+		} else {
+			reinterpret_cast<float *>(map->ptrw())[index] = p_pixel.r;
+		}
+		if (live_ptr && live_ptr != map->ptr()) {
+			_update_region_ptrs(region_id);
+		}
+	}
+	region->add_dirty_rect(p_map_type, Rect2i(pixel, Vector2i(1, 1)));
+	if (p_map_type == TYPE_HEIGHT) {
+		Rect2i &dirty = _dirty_pyramids[region->get_location()];
+		dirty = dirty.has_area() ? dirty.merge(Rect2i(pixel, Vector2i(1, 1))) : Rect2i(pixel, Vector2i(1, 1));
 	}
+	region->set_modified(true);
 }
 
 Color Terrain3DData::get_pixel(const MapType p_map_type, const Vector3 &p_global_position) const {
@@ -626,62 +1789,114 @@ Color Terrain3DData::get_pixel(const MapType p_map_type, const Vector3 &p_global
 		LOG(ERROR, "Specified map type out of range");
 		return COLOR_NAN;
 	}
-	Vector2i region_loc = get_region_location(p_global_position);
-	Terrain3DRegion *region = get_region_ptr(region_loc);
-	if (!region) {
+	const RegionPtrs *ptrs;
+	int index = _get_pixel_index(p_global_position, ptrs);
+	if (index < 0) {
 		return COLOR_NAN;
 	}
-	if (region->is_deleted()) {
-		return COLOR_NAN;
+	switch (p_map_type) {
+		case TYPE_HEIGHT:
+			if (ptrs->height) {
+				return Color(ptrs->height[index], 0.f, 0.f, 1.f);
+			}
+			break;
+		case TYPE_CONTROL:
+			if (ptrs->control) {
+				return Color(as_float(ptrs->control[index]), 0.f, 0.f, 1.f);
+			}
+			break;
+		case TYPE_COLOR:
+			if (ptrs->color) {
+				const uint8_t *pixel = ptrs->color + index * 4;
+				return Color(pixel[0] / 255.0, pixel[1] / 255.0, pixel[2] / 255.0, pixel[3] / 255.0);
+			}
+			break;
+		default:
+			break;
+	}
+	if (std::shared_ptr<const SparseMap> sparse = ptrs->region->get_sparse_map(p_map_type)) {
+		return sparse->get_pixel(index % _region_size, index / _region_size);
 	}
-	Vector2i global_offset = region_loc * _region_size;
-	Vector3 descaled_pos = p_global_position / _vertex_spacing;
-	Vector2i img_pos = Vector2i(descaled_pos.x - global_offset.x, descaled_pos.z - global_offset.y);
-	img_pos = img_pos.clamp(V2I_ZERO, Vector2i(_region_size - 1, _region_size - 1));
-	Image *map = region->get_map_ptr(p_map_type);
+	// Fall back to the Image API for maps not in the expected format
+	Image *map = ptrs->region->get_map_ptr(p_map_type);
 	if (map) {
-		return map->get_pixelv(img_pos);
+		return map->get_pixelv(Vector2i(index % _region_size, index / _region_size));
 	} else {
 		return COLOR_NAN;
 	}
 }
 
 real_t Terrain3DData::get_height(const Vector3 &p_global_position) const {
-	if (is_hole(get_control(p_global_position))) {
-		return NAN;
-	}
-	Vector3 pos = p_global_position;
-	const real_t &step = _vertex_spacing;
-	pos.y = 0.f;
-	// Round to nearest vertex
-	Vector3 pos_round = pos.snapped(Vector3(step, 0.f, step));
-	// If requested position is close to a vertex, return its height
-	if ((pos - pos_round).length_squared() < 0.0001f) {
-		return get_pixel(TYPE_HEIGHT, pos).r;
-	} else {
-		// Otherwise, bilinearly interpolate 4 surrounding vertices
-		Vector3 pos00 = Vector3(floor(pos.x / step) * step, 0.f, floor(pos.z / step) * step);
-		real_t ht00 = get_pixel(TYPE_HEIGHT, pos00).r;
-		Vector3 pos01 = pos00 + Vector3(0.f, 0.f, step);
-		real_t ht01 = get_pixel(TYPE_HEIGHT, pos01).r;
-		Vector3 pos10 = pos00 + Vector3(step, 0.f, 0.f);
-		real_t ht10 = get_pixel(TYPE_HEIGHT, pos10).r;
-		Vector3 pos11 = pos00 + Vector3(step, 0.f, step);
-		real_t ht11 = get_pixel(TYPE_HEIGHT, pos11).r;
-		return bilerp(ht00, ht01, ht10, ht11, pos00, pos11, pos);
-	}
+	return _sampler.get_height(v3v2(p_global_position) / _vertex_spacing);
+}
+
+/** Batched version of get_height() for many positions in one call.
+ * Safe to call from any thread. Large batches are split across the WorkerThreadPool.
+ * Returns the heights in the order of p_global_positions.
+ */
+PackedFloat32Array Terrain3DData::get_heights(const PackedVector3Array &p_global_positions) const {
+	PackedFloat32Array heights;
+	heights.resize(p_global_positions.size());
+	if (p_global_positions.is_empty()) {
+		return heights;
+	}
+	std::shared_ptr<const DataSnapshot> snapshot;
+	const MapSampler *sampler = _get_thread_sampler(snapshot);
+	if (!sampler) {
+		heights.fill(NAN);
+		return heights;
+	}
+	batch_query(*sampler, p_global_positions, heights.ptrw(), float(NAN),
+			[sampler](const MapSampler::RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) {
+				return float(sampler->sample_height(p_ptrs, p_descaled_pos));
+			});
+	return heights;
 }
 
 Vector3 Terrain3DData::get_normal(const Vector3 &p_global_position) const {
-	if (get_region_idp(p_global_position) < 0 || is_hole(get_control(p_global_position))) {
-		return Vector3(NAN, NAN, NAN);
-	}
-	real_t height = get_height(p_global_position);
-	real_t u = height - get_height(p_global_position + Vector3(_vertex_spacing, 0.0f, 0.0f));
-	real_t v = height - get_height(p_global_position + Vector3(0.f, 0.f, _vertex_spacing));
-	Vector3 normal = Vector3(u, _vertex_spacing, v);
-	normal.normalize();
-	return normal;
+	Vector2 descaled_pos = v3v2(p_global_position) / _vertex_spacing;
+	const RegionPtrs *ptrs = _sampler.get_region_ptrs(descaled_pos);
+	return ptrs ? _sampler.sample_normal(*ptrs, descaled_pos) : Vector3(NAN, NAN, NAN);
+}
+
+// Batched version of get_normal(). See get_heights().
+PackedVector3Array Terrain3DData::get_normals(const PackedVector3Array &p_global_positions) const {
+	PackedVector3Array normals;
+	normals.resize(p_global_positions.size());
+	if (p_global_positions.is_empty()) {
+		return normals;
+	}
+	std::shared_ptr<const DataSnapshot> snapshot;
+	const MapSampler *sampler = _get_thread_sampler(snapshot);
+	if (!sampler) {
+		normals.fill(Vector3(NAN, NAN, NAN));
+		return normals;
+	}
+	batch_query(*sampler, p_global_positions, normals.ptrw(), Vector3(NAN, NAN, NAN),
+			[sampler](const MapSampler::RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) {
+				return sampler->sample_normal(p_ptrs, p_descaled_pos);
+			});
+	return normals;
+}
+
+// Batched version of get_control(). See get_heights().
+PackedInt64Array Terrain3DData::get_controls(const PackedVector3Array &p_global_positions) const {
+	PackedInt64Array controls;
+	controls.resize(p_global_positions.size());
+	if (p_global_positions.is_empty()) {
+		return controls;
+	}
+	std::shared_ptr<const DataSnapshot> snapshot;
+	const MapSampler *sampler = _get_thread_sampler(snapshot);
+	if (!sampler) {
+		controls.fill(UINT32_MAX);
+		return controls;
+	}
+	batch_query(*sampler, p_global_positions, controls.ptrw(), int64_t(UINT32_MAX),
+			[sampler](const MapSampler::RegionPtrs &p_ptrs, const Vector2 &p_descaled_pos) {
+				return int64_t(sampler->sample_control(p_ptrs, p_descaled_pos));
+			});
+	return controls;
 }
 
 bool Terrain3DData::is_in_slope(const Vector3 &p_global_position, const Vector2 &p_slope_range, const bool p_invert) const {
@@ -692,27 +1907,10 @@ bool Terrain3DData::is_in_slope(const Vector3 &p_global_position, const Vector2
 	}
 
 	// Adapted from get_normal to work with holes
-	Vector3 slope_normal;
-	{
-		if (get_region_idp(p_global_position) < 0) {
-			return false;
-		}
-		// Adapted from get_height() to work with holes
-		auto get_height = [&](Vector3 pos) -> real_t {
-			real_t step = _terrain->get_vertex_spacing();
-			// Round to nearest vertex
-			Vector3 pos_round = pos.snapped(Vector3(step, 0.f, step));
-			real_t height = get_pixel(TYPE_HEIGHT, pos_round).r;
-			return std::isnan(height) ? 0.f : height;
-		};
-
-		const real_t vertex_spacing = _terrain->get_vertex_spacing();
-		const real_t height = get_height(p_global_position);
-		const real_t u = height - get_height(p_global_position + Vector3(vertex_spacing, 0.0f, 0.0f));
-		const real_t v = height - get_height(p_global_position + Vector3(0.f, 0.f, vertex_spacing));
-		slope_normal = Vector3(u, vertex_spacing, v);
-		slope_normal.normalize();
+	if (get_region_idp(p_global_position) < 0) {
+		return false;
 	}
+	const Vector3 slope_normal = _sampler.get_vertex_normal(Vector2i((v3v2(p_global_position) / _vertex_spacing).round()));
 
 	const real_t slope_angle = Math::acos(slope_normal.dot(Vector3(0.f, 1.f, 0.f)));
 	const real_t slope_angle_degrees = Math::rad_to_deg(slope_angle);
@@ -810,6 +2008,84 @@ Vector3 Terrain3DData::get_mesh_vertex(const int32_t p_lod, const HeightFilter p
 	return Vector3(p_global_position.x, height, p_global_position.z);
 }
 
+/**
+ * Returns the first point where a ray hits the terrain surface within p_max_distance, or NANs if
+ * it doesn't. Unlike get_intersection(), this intersects the interpolated surface exactly, using
+ * the height pyramid of each region to skip over empty space. Holes and areas without regions are
+ * never hit. A ray starting below the surface hits at its origin.
+ */
+Vector3 Terrain3DData::raycast(const Vector3 &p_origin, const Vector3 &p_direction, const real_t p_max_distance) const {
+	std::shared_ptr<const DataSnapshot> snapshot;
+	const MapSampler *sampler = _get_thread_sampler(snapshot);
+	MapSampler::RayHit hit;
+	if (sampler && sampler->raycast(p_origin, p_direction, p_max_distance, hit)) {
+		return hit.position;
+	}
+	return Vector3(NAN, NAN, NAN);
+}
+
+/**
+ * Batched version of raycast(), which casts each ray of p_origins along the matching entry of
+ * p_directions. Rays are split across worker threads, and it may be called from any thread.
+ * Returns a Dictionary of arrays with one entry per ray:
+ *	positions - PackedVector3Array of hit points, or NANs on a miss
+ *	normals - PackedVector3Array of surface normals at the hits, or NANs on a miss
+ *	region_ids - PackedInt32Array of the regions hit, or -1 on a miss
+ */
+Dictionary Terrain3DData::raycast_batch(const PackedVector3Array &p_origins, const PackedVector3Array &p_directions, const real_t p_max_distance) const {
+	Dictionary result;
+	if (p_origins.size() != p_directions.size()) {
+		LOG(ERROR, "Received ", p_origins.size(), " origins but ", p_directions.size(), " directions");
+		return result;
+	}
+	const int count = p_origins.size();
+	PackedVector3Array positions;
+	PackedVector3Array normals;
+	PackedInt32Array region_ids;
+	positions.resize(count);
+	normals.resize(count);
+	region_ids.resize(count);
+	std::shared_ptr<const DataSnapshot> snapshot;
+	const MapSampler *sampler = count > 0 ? _get_thread_sampler(snapshot) : nullptr;
+	if (sampler) {
+		const Vector3 *origins = p_origins.ptr();
+		const Vector3 *directions = p_directions.ptr();
+		Vector3 *r_positions = positions.ptrw();
+		Vector3 *r_normals = normals.ptrw();
+		int32_t *r_region_ids = region_ids.ptrw();
+		Util::parallel_for(count, [&](const int p_from, const int p_to) {
+			for (int i = p_from; i < p_to; i++) {
+				MapSampler::RayHit hit;
+				if (sampler->raycast(origins[i], directions[i], p_max_distance, hit)) {
+					r_positions[i] = hit.position;
+					r_normals[i] = hit.normal;
+					r_region_ids[i] = hit.region_id;
+				} else {
+					r_positions[i] = Vector3(NAN, NAN, NAN);
+					r_normals[i] = Vector3(NAN, NAN, NAN);
+					r_region_ids[i] = -1;
+				}
+			}
+		}, 64);
+	} else {
+		positions.fill(Vector3(NAN, NAN, NAN));
+		normals.fill(Vector3(NAN, NAN, NAN));
+		region_ids.fill(-1);
+	}
+	result["positions"] = positions;
+	result["normals"] = normals;
+	result["region_ids"] = region_ids;
+	return result;
+}
+
+// Recalculates the height pyramids over an area after its heights were modified directly, eg by
+// Terrain3DEditor. update_maps() refreshes them over the heights written by set_pixel().
+void Terrain3DData::update_height_pyramids(const AABB &p_global_aabb) {
+	const Vector2 from = (v3v2(p_global_aabb.position) / _vertex_spacing).floor();
+	const Vector2 to = (v3v2(p_global_aabb.get_end()) / _vertex_spacing).ceil();
+	_update_height_pyramids(Rect2i(Vector2i(from), Vector2i(to - from) + Vector2i(1, 1)));
+}
+
 void Terrain3DData::add_edited_area(const AABB &p_area) {
 	if (_edited_area.has_surface()) {
 		_edited_area = _edited_area.merge(p_area);
@@ -1095,7 +2371,7 @@ Ref<Image> Terrain3DData::layered_to_image(const MapType p_map_type) const {
 		LOG(DEBUG, "Region to blit: ", region_loc, " Export image coords: ", img_location);
 		Terrain3DRegion *region = get_region_ptr(region_loc);
 		if (region) {
-			img->blit_rect(region->get_map(map_type), Rect2i(V2I_ZERO, _region_sizev), img_location);
+			img->blit_rect(region->read_map(map_type), Rect2i(V2I_ZERO, _region_sizev), img_location);
 		}
 	}
 	return img;
@@ -1104,8 +2380,8 @@ Ref<Image> Terrain3DData::layered_to_image(const MapType p_map_type) const {
 void Terrain3DData::print_audit_data() const {
 	LOG(INFO, "Dumping data");
 	LOG(INFO, "Region_locations size: ", _region_locations.size(), " ", _region_locations);
-	LOG(INFO, "Region map");
-	for (int i = 0; i < _region_map.size(); i++) {
+	LOG(INFO, "Region map pages: ", RegionMap::get_page_count(_region_map));
+	for (int i = RegionMap::PAGE_TABLE_SIZE; i < _region_map.size(); i++) {
 		if (_region_map[i]) {
 			LOG(INFO, "Region id: ", _region_map[i], " array index: ", i);
 		}
@@ -1128,6 +2404,7 @@ void Terrain3DData::_bind_methods() {
 	BIND_ENUM_CONSTANT(HEIGHT_FILTER_MINIMUM);
 
 	BIND_CONSTANT(REGION_MAP_SIZE);
+	BIND_CONSTANT(MAX_REGIONS);
 
 	ClassDB::bind_method(D_METHOD("get_region_count"), &Terrain3DData::get_region_count);
 	ClassDB::bind_method(D_METHOD("set_region_locations", "region_locations"), &Terrain3DData::set_region_locations);
@@ -1135,6 +2412,8 @@ void Terrain3DData::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_regions_active", "copy", "deep"), &Terrain3DData::get_regions_active, DEFVAL(false), DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("get_regions_all"), &Terrain3DData::get_regions_all);
 	ClassDB::bind_method(D_METHOD("get_region_map"), &Terrain3DData::get_region_map);
+	ClassDB::bind_method(D_METHOD("get_region_map_pages"), &Terrain3DData::get_region_map_pages);
+	ClassDB::bind_method(D_METHOD("get_region_map_rid"), &Terrain3DData::get_region_map_rid);
 	ClassDB::bind_static_method("Terrain3DData", D_METHOD("get_region_map_index", "region_location"), &Terrain3DData::get_region_map_index);
 
 	ClassDB::bind_method(D_METHOD("do_for_regions", "area", "callback"), &Terrain3DData::do_for_regions);
@@ -1165,12 +2444,18 @@ void Terrain3DData::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("save_region", "region_location", "directory", "16_bit"), &Terrain3DData::save_region, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("load_directory", "directory"), &Terrain3DData::load_directory);
 	ClassDB::bind_method(D_METHOD("load_region", "region_location", "directory", "update"), &Terrain3DData::load_region, DEFVAL(true));
+	ClassDB::bind_method(D_METHOD("load_directory_async", "directory"), &Terrain3DData::load_directory_async);
+	ClassDB::bind_method(D_METHOD("load_region_async", "region_location", "directory"), &Terrain3DData::load_region_async);
+	ClassDB::bind_method(D_METHOD("is_loading"), &Terrain3DData::is_loading);
+	ClassDB::bind_method(D_METHOD("map_directory", "directory"), &Terrain3DData::map_directory);
 
 	ClassDB::bind_method(D_METHOD("get_height_maps"), &Terrain3DData::get_height_maps);
 	ClassDB::bind_method(D_METHOD("get_control_maps"), &Terrain3DData::get_control_maps);
 	ClassDB::bind_method(D_METHOD("get_color_maps"), &Terrain3DData::get_color_maps);
 	ClassDB::bind_method(D_METHOD("get_maps", "map_type"), &Terrain3DData::get_maps);
 	ClassDB::bind_method(D_METHOD("update_maps", "map_type", "all_maps ", "generate_mipmaps"), &Terrain3DData::update_maps, DEFVAL(TYPE_MAX), DEFVAL(true), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("queue_map_update", "map_type", "all_regions", "generate_mipmaps"), &Terrain3DData::queue_map_update, DEFVAL(TYPE_MAX), DEFVAL(true), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("flush_map_updates"), &Terrain3DData::flush_map_updates);
 	ClassDB::bind_method(D_METHOD("get_height_maps_rid"), &Terrain3DData::get_height_maps_rid);
 	ClassDB::bind_method(D_METHOD("get_control_maps_rid"), &Terrain3DData::get_control_maps_rid);
 	ClassDB::bind_method(D_METHOD("get_color_maps_rid"), &Terrain3DData::get_color_maps_rid);
@@ -1179,10 +2464,12 @@ void Terrain3DData::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_pixel", "map_type", "global_position"), &Terrain3DData::get_pixel);
 	ClassDB::bind_method(D_METHOD("set_height", "global_position", "height"), &Terrain3DData::set_height);
 	ClassDB::bind_method(D_METHOD("get_height", "global_position"), &Terrain3DData::get_height);
+	ClassDB::bind_method(D_METHOD("get_heights", "global_positions"), &Terrain3DData::get_heights);
 	ClassDB::bind_method(D_METHOD("set_color", "global_position", "color"), &Terrain3DData::set_color);
 	ClassDB::bind_method(D_METHOD("get_color", "global_position"), &Terrain3DData::get_color);
 	ClassDB::bind_method(D_METHOD("set_control", "global_position", "control"), &Terrain3DData::set_control);
 	ClassDB::bind_method(D_METHOD("get_control", "global_position"), &Terrain3DData::get_control);
+	ClassDB::bind_method(D_METHOD("get_controls", "global_positions"), &Terrain3DData::get_controls);
 	ClassDB::bind_method(D_METHOD("set_roughness", "global_position", "roughness"), &Terrain3DData::set_roughness);
 	ClassDB::bind_method(D_METHOD("get_roughness", "global_position"), &Terrain3DData::get_roughness);
 
@@ -1204,9 +2491,13 @@ void Terrain3DData::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_control_auto", "global_position"), &Terrain3DData::get_control_auto);
 
 	ClassDB::bind_method(D_METHOD("get_normal", "global_position"), &Terrain3DData::get_normal);
+	ClassDB::bind_method(D_METHOD("get_normals", "global_positions"), &Terrain3DData::get_normals);
 	ClassDB::bind_method(D_METHOD("is_in_slope", "global_position", "slope_range", "invert"), &Terrain3DData::is_in_slope, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("get_texture_id", "global_position"), &Terrain3DData::get_texture_id);
 	ClassDB::bind_method(D_METHOD("get_mesh_vertex", "lod", "filter", "global_position"), &Terrain3DData::get_mesh_vertex);
+	ClassDB::bind_method(D_METHOD("raycast", "origin", "direction", "max_distance"), &Terrain3DData::raycast, DEFVAL(4000.0));
+	ClassDB::bind_method(D_METHOD("raycast_batch", "origins", "directions", "max_distance"), &Terrain3DData::raycast_batch, DEFVAL(4000.0));
+	ClassDB::bind_method(D_METHOD("update_height_pyramids", "global_aabb"), &Terrain3DData::update_height_pyramids);
 
 	ClassDB::bind_method(D_METHOD("get_height_range"), &Terrain3DData::get_height_range);
 	ClassDB::bind_method(D_METHOD("calc_height_range", "recursive"), &Terrain3DData::calc_height_range, DEFVAL(false));
@@ -1227,4 +2518,6 @@ void Terrain3DData::_bind_methods() {
 	ADD_SIGNAL(MethodInfo("control_maps_changed"));
 	ADD_SIGNAL(MethodInfo("color_maps_changed"));
 	ADD_SIGNAL(MethodInfo("maps_edited", PropertyInfo(Variant::AABB, "edited_area")));
+	ADD_SIGNAL(MethodInfo("region_loaded", PropertyInfo(Variant::OBJECT, "region", PROPERTY_HINT_RESOURCE_TYPE, "Terrain3DRegion")));
+	ADD_SIGNAL(MethodInfo("load_progress", PropertyInfo(Variant::INT, "loaded"), PropertyInfo(Variant::INT, "total")));
 }
@@ -3,8 +3,15 @@
 #ifndef TERRAIN3D_DATA_CLASS_H
 #define TERRAIN3D_DATA_CLASS_H
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "constants.h"
+#include "data_snapshot.h"
 #include "generated_texture.h"
+#include "map_sampler.h"
+#include "region_map.h"
 #include "terrain_3d_region.h"
 
 class Terrain3D;
@@ -15,11 +22,16 @@ class Terrain3DData : public Object {
 	GDCLASS(Terrain3DData, Object);
 	CLASS_NAME();
 	friend Terrain3D;
+	friend DataSnapshot;
 
 public: // Constants
 	static inline const real_t CURRENT_VERSION = 0.93f;
-	static inline const int REGION_MAP_SIZE = 32;
+	static inline const int REGION_MAP_SIZE = RegionMap::SIZE;
+	static inline const int MAX_REGIONS = 1024; // Active regions, the size of _region_locations in the shaders
 	static inline const Vector2i REGION_MAP_VSIZE = Vector2i(REGION_MAP_SIZE, REGION_MAP_SIZE);
+	static inline const int LOAD_REQUESTS = 4; // Region files decoded at once in the background
+	static inline const int LOAD_COMMITS = 4; // Regions loaded in the background added per frame
+	static inline const int SPARE_LAYERS_DIVISOR = 8; // Texture arrays are grown by 1/8 of the regions
 
 	enum HeightFilter {
 		HEIGHT_FILTER_NEAREST,
@@ -66,18 +78,108 @@ private:
 	// Editing occurs on the Image arrays above, which are converted to Texture arrays
 	// below for the shader.
 
-	// 32x32 grid with region_id:int at its location, no region = 0, region_ids >= 1
+	// Two level map of region_id:int by location, no region = 0, region_ids >= 1. See RegionMap
 	PackedInt32Array _region_map;
+	GeneratedTexture _generated_region_map; // Pages of _region_map for the shader
 	bool _region_map_dirty = true;
+	bool _region_map_changed = false; // Rebuilt since the last update_maps()
+
+	// Map updates requested by queue_map_update(), merged until flush_map_updates(). Bits are
+	// 1 << MapType, and 1 << TYPE_MAX for the region map.
+	uint32_t _queued_rebuilds = 0; // Texture arrays rebuilt from all regions
+	uint32_t _queued_updates = 0; // Layers of edited regions updated
+	bool _queued_mipmaps = false;
+	bool _flush_queued = false; // flush_map_updates() is deferred to the end of the frame
+	std::vector<bool> _queued_layers; // By region_id, layers to upload after _commit_regions()
+
+	// Raw pointers into the map buffers of each active region, indexed by region_id, so
+	// queries can read memory directly instead of going through Dictionary and Image lookups.
+	// Rebuilt by update_maps(). Image data is copy on write, so the pointers of a region must be
+	// refreshed with update_region_ptrs() after writing to its maps.
+	typedef MapSampler::RegionPtrs RegionPtrs;
+	std::vector<RegionPtrs> _region_ptrs;
+	MapSampler _sampler; // Reads the live maps, only safe while the main thread isn't writing
+	// Vertices written by set_pixel() since the last update_maps(), whose height pyramids it
+	// refreshes, by region location
+	std::unordered_map<Vector2i, Rect2i, Vector2iHash> _dirty_pyramids;
+
+	// Immutable copy of the above for reading from other threads, replaced after update_maps()
+	std::shared_ptr<const DataSnapshot> _snapshot;
 
 	// These contain the TextureArray RIDs from the RenderingServer
 	GeneratedTexture _generated_height_maps;
 	GeneratedTexture _generated_control_maps;
 	GeneratedTexture _generated_color_maps;
 
+	// Regions loading in the background, in the order requested. Resource files are decoded by
+	// ResourceLoader threads, and binary region files by RegionFile on the WorkerThreadPool. Their
+	// maps are then sanitized on the WorkerThreadPool, and they are added to the terrain on the
+	// main thread by _process_loads(), a few each frame.
+	struct RegionDecode {
+		String path;
+		Ref<Terrain3DRegion> region; // Written by the decoding task
+	};
+	struct RegionLoad {
+		Vector2i location;
+		String path;
+		Ref<Terrain3DRegion> region; // Set once decoded
+		std::shared_ptr<RegionDecode> decode; // Binary region files only, while decoding
+		int64_t task_id = -1; // Decoding a binary region file if requested, else sanitizing the maps
+		bool requested = false; // Decoding
+		bool ready = false;
+		bool failed = false;
+		bool streamed = false; // Requested by region streaming
+	};
+	std::vector<RegionLoad> _loads;
+	int _loads_total = 0; // Counted since the queue was last empty, for load_progress
+	int _loads_done = 0;
+	bool _loads_sized = false; // The region size was taken from a queued region
+
+	// Region streaming, enabled by Terrain3D::region_streaming. The region files in the data
+	// directory are indexed by location, and only loaded while near the camera.
+	struct StreamedRegion {
+		String path;
+		uint64_t last_used = 0; // _stream_tick when last within the streaming radius
+		uint64_t memory = 0; // Bytes used by the maps if loaded by streaming, else 0
+		bool requested = false; // Queued in _loads
+		bool failed = false;
+	};
+	std::unordered_map<Vector2i, StreamedRegion, Vector2iHash> _streamed_regions;
+	uint64_t _stream_tick = 0;
+	uint64_t _stream_memory = 0; // Bytes used by all regions loaded by streaming
+	bool _stream_started = false;
+
 	// Functions
 	void _clear();
-	void _copy_paste_dfr(const Terrain3DRegion *p_src_region, const Rect2i &p_src_rect, const Rect2i &p_dst_rect, const Terrain3DRegion *p_dst_region);
+	Error _setup_loaded_region(const Ref<Terrain3DRegion> &p_region, const Vector2i &p_region_loc, const String &p_path,
+			const bool p_set_size);
+	bool _queue_load(const Vector2i &p_region_loc, const String &p_path, const bool p_streamed = false);
+	void _process_loads(const bool p_blocking = false);
+	void _cancel_loads();
+	static void _decode_region_file(const uint64_t p_decode);
+	void _commit_regions(const TypedArray<Terrain3DRegion> &p_added, const TypedArray<Vector2i> &p_removed,
+			const bool p_erase = true, const bool p_sanitized = false);
+	Error _add_region(const Ref<Terrain3DRegion> &p_region, const bool p_sanitize);
+	void _upload_queued_layers();
+	void _queue_flush();
+	std::vector<std::pair<Vector2i, String>> _get_region_files(const String &p_dir) const;
+	void _index_directory(const String &p_dir);
+	void _update_streaming(const Vector3 &p_global_position);
+	void _stop_streaming();
+	void _update_region_map();
+	void _update_region_map_texture();
+	void _update_region_ptrs(const int p_region_id);
+	TypedArray<Image> _get_upload_maps(const MapType p_map_type, const TypedArray<Image> &p_maps) const;
+	void _release_map_copies();
+	int _get_pixel_index(const Vector3 &p_global_position, const RegionPtrs *&r_ptrs) const;
+	void _publish_snapshot();
+	void _build_height_pyramids(const bool p_all, const bool p_all_edges, const bool p_edited_edges);
+	void _update_height_pyramid_edges(const int p_region_id);
+	void _update_height_pyramid(const int p_region_id, const Rect2i &p_cells);
+	void _update_height_pyramids(const Rect2i &p_vertices);
+	void _update_dirty_pyramids();
+	const MapSampler *_get_thread_sampler(std::shared_ptr<const DataSnapshot> &r_snapshot) const;
+	void _copy_paste_dfr(const Terrain3DRegion *p_src_region, const Rect2i &p_src_rect, const Rect2i &p_dst_rect, Terrain3DRegion *p_dst_region);
 
 public:
 	Terrain3DData() {}
@@ -91,7 +193,9 @@ public:
 	TypedArray<Vector2i> get_region_locations() const { return _region_locations; }
 	TypedArray<Terrain3DRegion> get_regions_active(const bool p_copy = false, const bool p_deep = false) const;
 	Dictionary get_regions_all() const { return _regions; }
-	PackedInt32Array get_region_map() const { return _region_map; }
+	PackedInt32Array get_region_map() const;
+	PackedInt32Array get_region_map_pages() const { return _region_map; }
+	RID get_region_map_rid() const { return _generated_region_map.get_rid(); }
 	static int get_region_map_index(const Vector2i &p_region_loc);
 
 	void do_for_regions(const Rect2i &p_area, const Callable &p_callback);
@@ -124,25 +228,35 @@ public:
 	void save_region(const Vector2i &p_region_loc, const String &p_dir, const bool p_16_bit = false);
 	void load_directory(const String &p_dir);
 	void load_region(const Vector2i &p_region_loc, const String &p_dir, const bool p_update = true);
+	Error load_directory_async(const String &p_dir);
+	Error load_region_async(const Vector2i &p_region_loc, const String &p_dir);
+	bool is_loading() const { return !_loads.empty(); }
+	Error map_directory(const String &p_dir);
 
 	// Maps
-	TypedArray<Image> get_height_maps() const { return _height_maps; }
-	TypedArray<Image> get_control_maps() const { return _control_maps; }
-	TypedArray<Image> get_color_maps() const { return _color_maps; }
+	TypedArray<Image> get_height_maps() const { return get_maps(TYPE_HEIGHT); }
+	TypedArray<Image> get_control_maps() const { return get_maps(TYPE_CONTROL); }
+	TypedArray<Image> get_color_maps() const { return get_maps(TYPE_COLOR); }
 	TypedArray<Image> get_maps(const MapType p_map_type) const;
 	void update_maps(const MapType p_map_type = TYPE_MAX, const bool p_all_regions = true, const bool p_generate_mipmaps = false);
+	void queue_map_update(const MapType p_map_type = TYPE_MAX, const bool p_all_regions = true, const bool p_generate_mipmaps = false);
+	void flush_map_updates();
 	RID get_height_maps_rid() const { return _generated_height_maps.get_rid(); }
 	RID get_control_maps_rid() const { return _generated_control_maps.get_rid(); }
 	RID get_color_maps_rid() const { return _generated_color_maps.get_rid(); }
+	void update_region_ptrs(const Vector2i &p_region_loc = V2I_MAX);
+	std::shared_ptr<const DataSnapshot> get_snapshot() const { return std::atomic_load(&_snapshot); }
 
 	void set_pixel(const MapType p_map_type, const Vector3 &p_global_position, const Color &p_pixel);
 	Color get_pixel(const MapType p_map_type, const Vector3 &p_global_position) const;
 	void set_height(const Vector3 &p_global_position, const real_t p_height);
 	real_t get_height(const Vector3 &p_global_position) const;
+	PackedFloat32Array get_heights(const PackedVector3Array &p_global_positions) const;
 	void set_color(const Vector3 &p_global_position, const Color &p_color);
 	Color get_color(const Vector3 &p_global_position) const;
 	void set_control(const Vector3 &p_global_position, const uint32_t p_control);
 	uint32_t get_control(const Vector3 &p_global_position) const;
+	PackedInt64Array get_controls(const PackedVector3Array &p_global_positions) const;
 	void set_roughness(const Vector3 &p_global_position, const real_t p_roughness);
 	real_t get_roughness(const Vector3 &p_global_position) const;
 
@@ -165,9 +279,13 @@ public:
 	bool get_control_auto(const Vector3 &p_global_position) const;
 
 	Vector3 get_normal(const Vector3 &p_global_position) const;
+	PackedVector3Array get_normals(const PackedVector3Array &p_global_positions) const;
 	bool is_in_slope(const Vector3 &p_global_position, const Vector2 &p_slope_range, const bool p_invert = false) const;
 	Vector3 get_texture_id(const Vector3 &p_global_position) const;
 	Vector3 get_mesh_vertex(const int32_t p_lod, const HeightFilter p_filter, const Vector3 &p_global_position) const;
+	Vector3 raycast(const Vector3 &p_origin, const Vector3 &p_direction, const real_t p_max_distance = 4000.f) const;
+	Dictionary raycast_batch(const PackedVector3Array &p_origins, const PackedVector3Array &p_directions, const real_t p_max_distance = 4000.f) const;
+	void update_height_pyramids(const AABB &p_global_aabb);
 
 	void add_edited_area(const AABB &p_area);
 	void clear_edited_area() { _edited_area = AABB(); }
@@ -194,15 +312,15 @@ VARIANT_ENUM_CAST(Terrain3DData::HeightFilter);
 
 // Inline Region Functions
 
-// Verifies the location is within the bounds of the _region_map array and
-// the world, returning the _region_map index, which contains the region_id.
-// Valid region locations are -16, -16 to 15, 15, or when offset: 0, 0 to 31, 31
-// If any bits other than 0x1F are set, it's out of bounds and returns -1
+// Verifies the location is within the bounds of the world, returning its index in a
+// REGION_MAP_SIZE^2 grid, or -1 if out of bounds.
+// Valid region locations are -128, -128 to 127, 127, or when offset: 0, 0 to 255, 255
+// If any bits other than 0xFF are set, it's out of bounds and returns -1
 inline int Terrain3DData::get_region_map_index(const Vector2i &p_region_loc) {
 	// Offset world to positive values only
 	Vector2i loc = p_region_loc + (REGION_MAP_VSIZE / 2);
-	// Catch values > 31
-	if ((uint32_t(loc.x | loc.y) & uint32_t(~0x1F)) > 0) {
+	// Catch values > 255
+	if ((uint32_t(loc.x | loc.y) & uint32_t(~(REGION_MAP_SIZE - 1))) > 0) {
 		return -1;
 	}
 	return loc.y * REGION_MAP_SIZE + loc.x;
@@ -216,9 +334,8 @@ inline Vector2i Terrain3DData::get_region_location(const Vector3 &p_global_posit
 
 // Returns id of any active region. -1 if out of bounds or no region, or region id
 inline int Terrain3DData::get_region_id(const Vector2i &p_region_loc) const {
-	int map_index = get_region_map_index(p_region_loc);
-	if (map_index >= 0) {
-		int region_id = _region_map[map_index] - 1; // 0 = no region
+	if (get_region_map_index(p_region_loc) >= 0) {
+		int region_id = RegionMap::get_entry(_region_map.ptr(), p_region_loc + (REGION_MAP_VSIZE / 2)) - 1; // 0 = no region
 		if (region_id >= 0 && region_id < _region_locations.size()) {
 			return region_id;
 		}
@@ -247,6 +364,18 @@ inline Ref<Terrain3DRegion> Terrain3DData::get_regionp(const Vector3 &p_global_p
 
 // Inline Map Functions
 
+// Returns the index of the pixel containing the global position within the maps of its region,
+// and the region pointers in r_ptrs. Returns -1 if there is no active region.
+inline int Terrain3DData::_get_pixel_index(const Vector3 &p_global_position, const RegionPtrs *&r_ptrs) const {
+	Vector2 descaled_pos = v3v2(p_global_position) / _vertex_spacing;
+	r_ptrs = _sampler.get_region_ptrs(descaled_pos);
+	if (!r_ptrs) {
+		return -1;
+	}
+	Vector2i img_pos = _sampler.get_pixel_position(*r_ptrs, descaled_pos);
+	return img_pos.y * _region_size + img_pos.x;
+}
+
 inline void Terrain3DData::set_height(const Vector3 &p_global_position, const real_t p_height) {
 	set_pixel(TYPE_HEIGHT, p_global_position, Color(p_height, 0.f, 0.f, 1.f));
 }
@@ -268,8 +397,9 @@ inline void Terrain3DData::set_control(const Vector3 &p_global_position, const u
 }
 
 inline uint32_t Terrain3DData::get_control(const Vector3 &p_global_position) const {
-	real_t val = get_pixel(TYPE_CONTROL, p_global_position).r;
-	return (std::isnan(val)) ? UINT32_MAX : as_uint(val);
+	Vector2 descaled_pos = v3v2(p_global_position) / _vertex_spacing;
+	const RegionPtrs *ptrs = _sampler.get_region_ptrs(descaled_pos);
+	return ptrs ? _sampler.sample_control(*ptrs, descaled_pos) : UINT32_MAX;
 }
 
 inline void Terrain3DData::set_control_base_id(const Vector3 &p_global_position, const uint8_t p_base) {
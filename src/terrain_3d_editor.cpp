@@ -3,8 +3,10 @@
 #include <godot_cpp/classes/editor_undo_redo_manager.hpp>
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/time.hpp>
+#include <algorithm>
 
 #include "logger.h"
+#include "sparse_map.h"
 #include "terrain_3d_data.h"
 #include "terrain_3d_editor.h"
 #include "terrain_3d_util.h"
@@ -24,6 +26,78 @@ void Terrain3DEditor::_send_region_aabb(const Vector2i &p_region_loc, const Vect
 	_terrain->get_data()->add_edited_area(edited_area);
 }
 
+/** Returns the brush image resampled to p_pixels x p_pixels, with rotation and gamma applied,
+ * indexed by x * p_pixels + y. Alpha is -1 outside of the brush image.
+ * Stamps are cached, so each rotation is only resampled once per brush, size and gamma. The
+ * least recently used are dropped past BRUSH_STAMP_CACHE_BYTES. Only one stamp of an exact angle
+ * is kept. Returns nullptr if a single stamp exceeds the budget, to sample with _get_brush_alpha().
+ *	p_rotation - the bucket of p_buckets evenly spaced rotations, or -1 to use p_angle exactly
+ */
+const std::vector<float> *Terrain3DEditor::_get_brush_stamp(const Image *p_image, const int p_pixels, const int p_rotation,
+		const int p_buckets, const real_t p_angle, const real_t p_gamma) {
+	const size_t stamp_bytes = size_t(p_pixels) * p_pixels * sizeof(float);
+	if (stamp_bytes > size_t(BRUSH_STAMP_CACHE_BYTES)) {
+		LOG(EXTREME, "Brush of ", p_pixels, "x", p_pixels, " exceeds the stamp cache, sampling per pixel");
+		return nullptr;
+	}
+	for (size_t i = 0; i < _brush_stamps.size(); i++) {
+		const BrushStamp &stamp = _brush_stamps[i];
+		if (stamp.image == p_image && stamp.pixels == p_pixels && stamp.rotation == p_rotation && stamp.gamma == p_gamma &&
+				(p_rotation < 0 ? stamp.angle == p_angle : stamp.buckets == p_buckets)) {
+			std::rotate(_brush_stamps.begin() + i, _brush_stamps.begin() + i + 1, _brush_stamps.end());
+			return &_brush_stamps.back().alphas;
+		}
+	}
+
+	// Drop the previous stamp of an exact angle, and the least recently used past the budget
+	if (p_rotation < 0) {
+		_brush_stamps.erase(std::remove_if(_brush_stamps.begin(), _brush_stamps.end(),
+									[](const BrushStamp &p_stamp) { return p_stamp.rotation < 0; }),
+				_brush_stamps.end());
+	}
+	size_t bytes = stamp_bytes;
+	for (const BrushStamp &cached : _brush_stamps) {
+		bytes += cached.alphas.size() * sizeof(float);
+	}
+	while (!_brush_stamps.empty() && bytes > size_t(BRUSH_STAMP_CACHE_BYTES)) {
+		bytes -= _brush_stamps.front().alphas.size() * sizeof(float);
+		_brush_stamps.erase(_brush_stamps.begin());
+	}
+
+	BrushStamp stamp;
+	stamp.image = p_image;
+	stamp.pixels = p_pixels;
+	stamp.rotation = p_rotation;
+	stamp.buckets = p_buckets;
+	stamp.angle = p_angle;
+	stamp.gamma = p_gamma;
+	stamp.alphas.resize(size_t(p_pixels) * p_pixels);
+	Util::parallel_for(p_pixels, [&](const int p_from, const int p_to) {
+		for (int x = p_from; x < p_to; x++) {
+			for (int y = 0; y < p_pixels; y++) {
+				stamp.alphas[x * p_pixels + y] = _get_brush_alpha(p_image, p_pixels, Vector2i(x, y), p_angle, p_gamma);
+			}
+		}
+	}, BRUSH_STAMP_BATCH);
+	LOG(EXTREME, "Created brush stamp of ", p_pixels, "x", p_pixels, ", rotation ", p_rotation, "/", p_buckets, ", cached: ", _brush_stamps.size());
+	_brush_stamps.push_back(std::move(stamp));
+	return &_brush_stamps.back().alphas;
+}
+
+// Returns the alpha of one pixel of the brush resampled to p_pixels x p_pixels, or -1 outside of
+// the brush image
+float Terrain3DEditor::_get_brush_alpha(const Image *p_image, const int p_pixels, const Vector2i &p_pixel, const real_t p_angle,
+		const real_t p_gamma) const {
+	const Vector2i img_size = p_image->get_size();
+	Vector2 brush_uv = Vector2(p_pixel) / real_t(p_pixels);
+	Vector2i brush_pixel_position = Vector2i(_get_rotated_uv(brush_uv, p_angle) * img_size);
+	if (!_is_in_bounds(brush_pixel_position, img_size)) {
+		return -1.f;
+	}
+	float brush_alpha = Math::pow(p_image->get_pixelv(brush_pixel_position).r, float(p_gamma));
+	return std::isnan(brush_alpha) ? 0.f : CLAMP(brush_alpha, 0.f, 1.f);
+}
+
 // Process location to add new region, mark as deleted, or just retrieve
 Terrain3DRegion *Terrain3DEditor::_operate_region(const Vector2i &p_region_loc) {
 	bool changed = false;
@@ -109,7 +183,6 @@ void Terrain3DEditor::_operate_map(const Vector3 &p_global_position, const real_
 		LOG(ERROR, "Invalid brush image. Returning");
 		return;
 	}
-	Vector2i img_size = _brush_data["brush_image_size"];
 	real_t brush_size = CLAMP(real_t(_brush_data.get("size", 10.f)), 2.f, 4096.f); // Meters
 
 	// Typicall we multiply mouse pressure & strength setting, but
@@ -154,6 +227,14 @@ void Terrain3DEditor::_operate_map(const Vector3 &p_global_position, const real_
 	if (_brush_data["align_to_view"]) {
 		rot += p_camera_direction;
 	}
+	// Quantize rotations that change every event, so the brush stamps can be reused. Others are
+	// used exactly.
+	int rotation_buckets = MAX(1, int(_brush_data.get("rotation_buckets", 64)));
+	int rotation = -1;
+	if (real_t(_brush_data["jitter"]) > 0.f || bool(_brush_data["align_to_view"])) {
+		rotation = int(Math::round(Math::fposmod(rot, real_t(Math_TAU)) / real_t(Math_TAU) * rotation_buckets)) % rotation_buckets;
+		rot = real_t(rotation) * real_t(Math_TAU) / rotation_buckets;
+	}
 	// Rotate the decal to align with the brush
 	if (IS_EDITOR && _terrain->get_plugin()) {
 		cast_to<Node>(_terrain->get_plugin()->get("ui"))->call("set_decal_rotation", rot);
@@ -173,364 +254,485 @@ void Terrain3DEditor::_operate_map(const Vector3 &p_global_position, const real_
 
 	// MAP Operations
 	real_t vertex_spacing = _terrain->get_vertex_spacing();
+	bool background_none = _terrain->get_material()->get_world_background() == Terrain3DMaterial::NONE;
+	if (dynamic_angle) {
+		// Angle from mouse movement.
+		angle = Vector2(-_operation_movement.x, _operation_movement.z).angle();
+		// Avoid negative, align texture "up" with mouse direction.
+		angle = real_t(Math::fmod(Math::rad_to_deg(angle) + 450.f, real_t(360.f)));
+	}
 
 	// save region count before brush pixel loop. Any regions added will have caused an Array
 	// rebuild at the end of the last _operate() call, but until painting is finished we only
 	// need to track if _added_removed_locations has changed between now and the end of the loop
 	int regions_added_removed = _added_removed_locations.size();
 
-	for (real_t x = 0.f; x < brush_size; x += vertex_spacing) {
-		for (real_t y = 0.f; y < brush_size; y += vertex_spacing) {
-			Vector2 brush_offset = Vector2(x, y) - (Vector2(brush_size, brush_size) / 2.f);
-			Vector3 brush_global_position =
-					Vector3(p_global_position.x + brush_offset.x + .5f, p_global_position.y,
-							p_global_position.z + brush_offset.y + .5f);
-
-			// Get region for current brush pixel global position
-			Vector2i region_loc = data->get_region_location(brush_global_position);
+	// One brush pixel per vertex, with the brush alpha from the cached stamp
+	const int brush_pixels = int(Math::ceil(brush_size / vertex_spacing));
+	const std::vector<float> *alphas = _get_brush_stamp(brush_image, brush_pixels, rotation, rotation_buckets, rot, gamma);
+
+	// Prepare the regions under the brush on the main thread, adding any new ones, so the workers
+	// only read them
+	struct BrushRegion {
+		Terrain3DRegion *region = nullptr;
+		SparseMap *sparse = nullptr; // Written instead of map for height and control maps
+		Image *map = nullptr;
+		const uint8_t *src = nullptr; // Set if the map is in the expected format and size
+		uint8_t *dst = nullptr; // Set on the first write, once backed up for undo
+		int backup = -1; // Index in _tile_backups
+		Rect2i dirty;
+		bool written = false;
+	};
+	const Vector2 brush_start = Vector2(p_global_position.x, p_global_position.z) - Vector2(brush_size, brush_size) / 2.f + V2(.5f);
+	const Vector2 brush_end = brush_start + V2((brush_pixels - 1) * vertex_spacing);
+	const Vector2i min_loc = data->get_region_location(Vector3(brush_start.x, 0.f, brush_start.y));
+	const Vector2i loc_count = data->get_region_location(Vector3(brush_end.x, 0.f, brush_end.y)) - min_loc + V2I(1);
+	const Image::Format map_format = (map_type == TYPE_COLOR) ? Image::FORMAT_RGBA8 : Image::FORMAT_RF;
+	std::vector<BrushRegion> regions(loc_count.x * loc_count.y);
+	for (int ry = 0; ry < loc_count.y; ry++) {
+		for (int rx = 0; rx < loc_count.x; rx++) {
+			Vector2i region_loc = min_loc + Vector2i(rx, ry);
 			Terrain3DRegion *region = _operate_region(region_loc);
 			// If no region and can't make one, skip
 			if (!region) {
 				continue;
 			}
-
-			// Get map for this region and tool
-			Image *map = region->get_map_ptr(map_type);
-			if (!map) {
-				continue;
-			}
-
-			// Identify position on map image
-			Vector2 uv_position = _get_uv_position(brush_global_position, region_size, vertex_spacing);
-			Vector2i map_pixel_position = Vector2i(uv_position * region_size);
-			if (!_is_in_bounds(map_pixel_position, region_vsize)) {
-				continue;
+			BrushRegion &brush_region = regions[ry * loc_count.x + rx];
+			brush_region.region = region;
+			// Height and control maps are written in their tiles, copying only those touched if a
+			// snapshot shares them. Others are expanded. Either may replace the map, so refresh the
+			// pointers read by the workers.
+			if (map_type != TYPE_COLOR && region->is_sparse(map_type)) {
+				brush_region.sparse = region->get_sparse_map_ptrw(map_type);
+			} else {
+				brush_region.map = region->get_map_ptrw(map_type);
 			}
-
-			Vector2 brush_uv = Vector2(x, y) / brush_size;
-			Vector2i brush_pixel_position = Vector2i(_get_rotated_uv(brush_uv, rot) * img_size);
-			if (!_is_in_bounds(brush_pixel_position, img_size)) {
-				continue;
+			data->update_region_ptrs(region_loc);
+			if (brush_region.map && brush_region.map->get_format() == map_format &&
+					brush_region.map->get_size() == region_vsize) {
+				brush_region.src = brush_region.map->ptr();
 			}
-
-			Vector3 edited_position = brush_global_position;
-			edited_position.y = data->get_height(edited_position);
-			edited_area = edited_area.expand(edited_position);
-
-			// Start brushing on the map
-			real_t brush_alpha = brush_image->get_pixelv(brush_pixel_position).r;
-			brush_alpha = real_t(Math::pow(double(brush_alpha), double(gamma)));
-			brush_alpha = std::isnan(brush_alpha) || std::isnan(brush_alpha) ? 0.f : CLAMP(brush_alpha, 0.f, 1.f);
-			Color src = map->get_pixelv(map_pixel_position);
-			Color dest = src;
-
-			if (map_type == TYPE_HEIGHT) {
-				real_t srcf = src.r;
-				// In case data in existing map has nan or inf saved, check, and reset to real number if required.
-				srcf = std::isnan(srcf) || std::isnan(srcf) ? 0.f : srcf;
-				real_t destf = srcf;
-
-				switch (_operation) {
-					case ADD: {
-						if (_tool == HEIGHT) {
-							// Height
-							destf = Math::lerp(srcf, height, CLAMP(brush_alpha * strength, 0.f, 1.f));
-						} else if (modifier_alt && !std::isnan(p_global_position.y)) {
-							// Lift troughs
-							real_t brush_center_y = p_global_position.y + brush_alpha * strength;
-							destf = Math::clamp(brush_center_y, srcf, srcf + brush_alpha * strength);
-						} else {
-							// Raise
-							destf = srcf + (brush_alpha * strength);
-						}
-						break;
+		}
+	}
+	// Reads the map tiles or buffers directly, or through the Image API if not in the expected format
+	auto read_pixel = [&](const BrushRegion &p_region, const Vector2i &p_pixel) -> Color {
+		if (p_region.sparse) {
+			return p_region.sparse->get_pixel(p_pixel.x, p_pixel.y);
+		}
+		if (!p_region.src) {
+			return p_region.map->get_pixelv(p_pixel);
+		}
+		const int index = p_pixel.y * region_size + p_pixel.x;
+		if (map_type == TYPE_COLOR) {
+			const uint8_t *rgba = p_region.src + index * 4;
+			return Color(rgba[0] / 255.f, rgba[1] / 255.f, rgba[2] / 255.f, rgba[3] / 255.f);
+		}
+		return Color(reinterpret_cast<const float *>(p_region.src)[index], 0.f, 0.f, 1.f);
+	};
+
+	// Split the brush into tiles, processed on the WorkerThreadPool. Workers only read the maps
+	// and collect the new pixel values, so AVERAGE reads neighbors from before this operation.
+	struct BrushWrite {
+		int region = 0;
+		Vector2i pixel;
+		Color value;
+	};
+	struct BrushTile {
+		Rect2i pixels;
+		AABB area;
+		std::vector<BrushWrite> writes;
+	};
+	std::vector<BrushTile> tiles;
+	for (int ty = 0; ty < brush_pixels; ty += BRUSH_TILE_SIZE) {
+		for (int tx = 0; tx < brush_pixels; tx += BRUSH_TILE_SIZE) {
+			BrushTile tile;
+			tile.pixels = Rect2i(tx, ty, MIN(BRUSH_TILE_SIZE, brush_pixels - tx), MIN(BRUSH_TILE_SIZE, brush_pixels - ty));
+			tile.area = edited_area;
+			tiles.push_back(tile);
+		}
+	}
+	Util::parallel_for(int(tiles.size()), [&](const int p_from, const int p_to) {
+		for (int t = p_from; t < p_to; t++) {
+			BrushTile &tile = tiles[t];
+			for (int bx = tile.pixels.position.x; bx < tile.pixels.get_end().x; bx++) {
+				for (int by = tile.pixels.position.y; by < tile.pixels.get_end().y; by++) {
+					real_t brush_alpha = alphas ? (*alphas)[bx * brush_pixels + by] :
+												  _get_brush_alpha(brush_image, brush_pixels, Vector2i(bx, by), rot, gamma);
+					if (brush_alpha < 0.f) {
+						continue;
 					}
-					case SUBTRACT: {
-						if (_tool == HEIGHT) {
-							// Height, but GDScript has already picked height at cursor
-							destf = Math::lerp(srcf, height, CLAMP(brush_alpha * strength, 0.f, 1.f));
-						} else if (modifier_alt && !std::isnan(p_global_position.y)) {
-							// Flatten peaks
-							real_t brush_center_y = p_global_position.y - brush_alpha * strength;
-							destf = Math::clamp(brush_center_y, srcf - brush_alpha * strength, srcf);
-						} else {
-							// Lower
-							destf = srcf - (brush_alpha * strength);
-						}
-						break;
+					Vector2 brush_offset = Vector2(bx, by) * vertex_spacing - (Vector2(brush_size, brush_size) / 2.f);
+					Vector3 brush_global_position =
+							Vector3(p_global_position.x + brush_offset.x + .5f, p_global_position.y,
+									p_global_position.z + brush_offset.y + .5f);
+
+					// Get region for current brush pixel global position
+					Vector2i region_offset = data->get_region_location(brush_global_position) - min_loc;
+					if (!_is_in_bounds(region_offset, loc_count)) {
+						continue;
 					}
-					case AVERAGE: {
-						Vector3 left_position = brush_global_position - Vector3(vertex_spacing, 0.f, 0.f);
-						Vector3 right_position = brush_global_position + Vector3(vertex_spacing, 0.f, 0.f);
-						Vector3 down_position = brush_global_position - Vector3(0.f, 0.f, vertex_spacing);
-						Vector3 up_position = brush_global_position + Vector3(0.f, 0.f, vertex_spacing);
-						real_t bg_srcf_zero = _terrain->get_material()->get_world_background() == 0u ? srcf : 0.0;
-						real_t left = data->get_pixel(map_type, left_position).r;
-						if (std::isnan(left)) {
-							left = bg_srcf_zero;
-						}
-						real_t right = data->get_pixel(map_type, right_position).r;
-						if (std::isnan(right)) {
-							right = bg_srcf_zero;
-						}
-						real_t up = data->get_pixel(map_type, up_position).r;
-						if (std::isnan(up)) {
-							up = bg_srcf_zero;
-						}
-						real_t down = data->get_pixel(map_type, down_position).r;
-						if (std::isnan(down)) {
-							down = bg_srcf_zero;
-						}
-						real_t avg = (srcf + left + right + up + down) * 0.2f;
-						destf = Math::lerp(srcf, avg, CLAMP(brush_alpha * strength * 2.f, .02f, 1.f));
-						break;
+					const int region_index = region_offset.y * loc_count.x + region_offset.x;
+					const BrushRegion &brush_region = regions[region_index];
+					if (!brush_region.map && !brush_region.sparse) {
+						continue;
 					}
-					case GRADIENT: {
-						if (gradient_points.size() == 2) {
-							Vector3 point_1 = gradient_points[0];
-							Vector3 point_2 = gradient_points[1];
-
-							Vector2 point_1_xz = Vector2(point_1.x, point_1.z);
-							Vector2 point_2_xz = Vector2(point_2.x, point_2.z);
-							Vector2 brush_xz = Vector2(brush_global_position.x, brush_global_position.z);
-
-							if (_operation_movement.length_squared() > 0.f) {
-								// Ramp up/down only in the direction of movement, to avoid giving winding
-								// paths one edge higher than the other.
-								Vector2 movement_xz = Vector2(_operation_movement.x, _operation_movement.z).normalized();
-								Vector2 offset = movement_xz * Vector2(brush_offset).dot(movement_xz);
-								brush_xz = Vector2(p_global_position.x + offset.x, p_global_position.z + offset.y);
-							}
 
-							Vector2 dir = point_2_xz - point_1_xz;
-							real_t weight = dir.normalized().dot(brush_xz - point_1_xz) / dir.length();
-							weight = Math::clamp(weight, (real_t)0.0f, (real_t)1.0f);
-							real_t height = Math::lerp(point_1.y, point_2.y, weight);
-							destf = Math::lerp(srcf, height, CLAMP(brush_alpha * strength, 0.f, 1.f));
-						}
-						break;
+					// Identify position on map image
+					Vector2 uv_position = _get_uv_position(brush_global_position, region_size, vertex_spacing);
+					Vector2i map_pixel_position = Vector2i(uv_position * region_size);
+					if (!_is_in_bounds(map_pixel_position, region_vsize)) {
+						continue;
 					}
-					default:
-						break;
-				}
-				dest = Color(destf, 0.f, 0.f, 1.f);
-				region->update_height(destf);
-				data->update_master_height(destf);
-				edited_position.y = destf;
-				edited_area = edited_area.expand(edited_position);
-
-			} else if (map_type == TYPE_CONTROL) {
-				// Get current bit field from pixel
-				uint32_t base_id = get_base(src.r);
-				uint32_t overlay_id = get_overlay(src.r);
-				real_t blend = real_t(get_blend(src.r)) / 255.f;
-				uint32_t uvrotation = get_uv_rotation(src.r);
-				uint32_t uvscale = get_uv_scale(src.r);
-				bool hole = is_hole(src.r);
-				bool navigation = is_nav(src.r);
-				bool autoshader = is_auto(src.r);
-				// Lookup to shift values saved to control map so that 0 (default) is the first entry
-				// Shader scale array is aligned to match this.
-				std::array<uint32_t, 8> scale_align = { 5, 6, 7, 0, 1, 2, 3, 4 };
-
-				switch (_tool) {
-					case TEXTURE: {
-						if (!data->is_in_slope(brush_global_position, slope_range, modifier_alt)) {
-							continue;
-						}
+
+					Vector3 edited_position = brush_global_position;
+					edited_position.y = data->get_height(edited_position);
+					tile.area = tile.area.expand(edited_position);
+
+					// Start brushing on the map
+					Color src = read_pixel(brush_region, map_pixel_position);
+					Color dest = src;
+
+					if (map_type == TYPE_HEIGHT) {
+						real_t srcf = src.r;
+						// In case data in existing map has nan or inf saved, check, and reset to real number if required.
+						srcf = std::isnan(srcf) || std::isnan(srcf) ? 0.f : srcf;
+						real_t destf = srcf;
+
 						switch (_operation) {
-							// Base Paint
-							case REPLACE: {
-								if (brush_alpha > 0.5f) {
-									if (enable_texture) {
-										// Set base & overlay texture
-										base_id = asset_id;
-										overlay_id = asset_id;
-										// Erase blend value
-										blend = 0.f;
-										autoshader = false;
-									}
-									// Set angle & scale
-									if (base_id == asset_id && enable_angle && !autoshader) {
-										if (dynamic_angle) {
-											// Angle from mouse movement.
-											angle = Vector2(-_operation_movement.x, _operation_movement.z).angle();
-											// Avoid negative, align texture "up" with mouse direction.
-											angle = real_t(Math::fmod(Math::rad_to_deg(angle) + 450.f, real_t(360.f)));
-										}
-										// Convert from degrees to 0 - 15 value range
-										uvrotation = uint32_t(CLAMP(Math::round(angle / 22.5f), 0.f, 15.f));
-									}
-									if (base_id == asset_id && enable_scale && !autoshader) {
-										// Offset negative and convert from percentage to 0 - 7 bit value range
-										// Maintain 0 = 0, remap negatives to end.
-										uvscale = scale_align[uint8_t(CLAMP(Math::round((scale + 60.f) / 20.f), 0.f, 7.f))];
-									}
+							case ADD: {
+								if (_tool == HEIGHT) {
+									// Height
+									destf = Math::lerp(srcf, height, CLAMP(brush_alpha * strength, 0.f, 1.f));
+								} else if (modifier_alt && !std::isnan(p_global_position.y)) {
+									// Lift troughs
+									real_t brush_center_y = p_global_position.y + brush_alpha * strength;
+									destf = Math::clamp(brush_center_y, srcf, srcf + brush_alpha * strength);
+								} else {
+									// Raise
+									destf = srcf + (brush_alpha * strength);
 								}
 								break;
 							}
-
-							// Overlay Spray
-							case ADD: {
-								real_t spray_strength = CLAMP(strength * 0.05f, 0.004f, .25f);
-								real_t brush_value = CLAMP(brush_alpha * spray_strength, 0.f, 1.f);
-								if (enable_texture && brush_alpha * strength * 11.f > 0.1f) {
-									// Painted area, set overlay immediatley
-									if (base_id == overlay_id && blend < 0.004f) {
-										overlay_id = asset_id;
+							case SUBTRACT: {
+								if (_tool == HEIGHT) {
+									// Height, but GDScript has already picked height at cursor
+									destf = Math::lerp(srcf, height, CLAMP(brush_alpha * strength, 0.f, 1.f));
+								} else if (modifier_alt && !std::isnan(p_global_position.y)) {
+									// Flatten peaks
+									real_t brush_center_y = p_global_position.y - brush_alpha * strength;
+									destf = Math::clamp(brush_center_y, srcf - brush_alpha * strength, srcf);
+								} else {
+									// Lower
+									destf = srcf - (brush_alpha * strength);
+								}
+								break;
+							}
+							case AVERAGE: {
+								Vector3 left_position = brush_global_position - Vector3(vertex_spacing, 0.f, 0.f);
+								Vector3 right_position = brush_global_position + Vector3(vertex_spacing, 0.f, 0.f);
+								Vector3 down_position = brush_global_position - Vector3(0.f, 0.f, vertex_spacing);
+								Vector3 up_position = brush_global_position + Vector3(0.f, 0.f, vertex_spacing);
+								real_t bg_srcf_zero = background_none ? srcf : 0.0;
+								real_t left = data->get_pixel(map_type, left_position).r;
+								if (std::isnan(left)) {
+									left = bg_srcf_zero;
+								}
+								real_t right = data->get_pixel(map_type, right_position).r;
+								if (std::isnan(right)) {
+									right = bg_srcf_zero;
+								}
+								real_t up = data->get_pixel(map_type, up_position).r;
+								if (std::isnan(up)) {
+									up = bg_srcf_zero;
+								}
+								real_t down = data->get_pixel(map_type, down_position).r;
+								if (std::isnan(down)) {
+									down = bg_srcf_zero;
+								}
+								real_t avg = (srcf + left + right + up + down) * 0.2f;
+								destf = Math::lerp(srcf, avg, CLAMP(brush_alpha * strength * 2.f, .02f, 1.f));
+								break;
+							}
+							case GRADIENT: {
+								if (gradient_points.size() == 2) {
+									Vector3 point_1 = gradient_points[0];
+									Vector3 point_2 = gradient_points[1];
+
+									Vector2 point_1_xz = Vector2(point_1.x, point_1.z);
+									Vector2 point_2_xz = Vector2(point_2.x, point_2.z);
+									Vector2 brush_xz = Vector2(brush_global_position.x, brush_global_position.z);
+
+									if (_operation_movement.length_squared() > 0.f) {
+										// Ramp up/down only in the direction of movement, to avoid giving winding
+										// paths one edge higher than the other.
+										Vector2 movement_xz = Vector2(_operation_movement.x, _operation_movement.z).normalized();
+										Vector2 offset = movement_xz * Vector2(brush_offset).dot(movement_xz);
+										brush_xz = Vector2(p_global_position.x + offset.x, p_global_position.z + offset.y);
 									}
-									// Overlay and base texture are the same, reduce blend value
-									if (base_id == asset_id) {
-										blend = CLAMP(blend - brush_value, 0.f, 1.f);
-										if (blend < 0.5f && brush_alpha > 0.5f) {
-											autoshader = false;
+
+									Vector2 dir = point_2_xz - point_1_xz;
+									real_t weight = dir.normalized().dot(brush_xz - point_1_xz) / dir.length();
+									weight = Math::clamp(weight, (real_t)0.0f, (real_t)1.0f);
+									real_t height = Math::lerp(point_1.y, point_2.y, weight);
+									destf = Math::lerp(srcf, height, CLAMP(brush_alpha * strength, 0.f, 1.f));
+								}
+								break;
+							}
+							default:
+								break;
+						}
+						dest = Color(destf, 0.f, 0.f, 1.f);
+						edited_position.y = destf;
+						tile.area = tile.area.expand(edited_position);
+
+					} else if (map_type == TYPE_CONTROL) {
+						// Get current bit field from pixel
+						uint32_t base_id = get_base(src.r);
+						uint32_t overlay_id = get_overlay(src.r);
+						real_t blend = real_t(get_blend(src.r)) / 255.f;
+						uint32_t uvrotation = get_uv_rotation(src.r);
+						uint32_t uvscale = get_uv_scale(src.r);
+						bool hole = is_hole(src.r);
+						bool navigation = is_nav(src.r);
+						bool autoshader = is_auto(src.r);
+						// Lookup to shift values saved to control map so that 0 (default) is the first entry
+						// Shader scale array is aligned to match this.
+						std::array<uint32_t, 8> scale_align = { 5, 6, 7, 0, 1, 2, 3, 4 };
+
+						switch (_tool) {
+							case TEXTURE: {
+								if (!data->is_in_slope(brush_global_position, slope_range, modifier_alt)) {
+									continue;
+								}
+								switch (_operation) {
+									// Base Paint
+									case REPLACE: {
+										if (brush_alpha > 0.5f) {
+											if (enable_texture) {
+												// Set base & overlay texture
+												base_id = asset_id;
+												overlay_id = asset_id;
+												// Erase blend value
+												blend = 0.f;
+												autoshader = false;
+											}
+											// Set angle & scale
+											if (base_id == asset_id && enable_angle && !autoshader) {
+												// Convert from degrees to 0 - 15 value range
+												uvrotation = uint32_t(CLAMP(Math::round(angle / 22.5f), 0.f, 15.f));
+											}
+											if (base_id == asset_id && enable_scale && !autoshader) {
+												// Offset negative and convert from percentage to 0 - 7 bit value range
+												// Maintain 0 = 0, remap negatives to end.
+												uvscale = scale_align[uint8_t(CLAMP(Math::round((scale + 60.f) / 20.f), 0.f, 7.f))];
+											}
 										}
-									} else {
-										// Overlay and base are separate, increase blend value
-										blend = CLAMP(blend + brush_value, 0.f, 1.f);
-										// Overlay already visible, limit ID changes to high brush alpha
-										if (blend > 0.5f && brush_alpha > 0.5f) {
-											overlay_id = asset_id;
-											// Only remove auto shader when blend is past threshold.
-											autoshader = false;
+										break;
+									}
+
+									// Overlay Spray
+									case ADD: {
+										real_t spray_strength = CLAMP(strength * 0.05f, 0.004f, .25f);
+										real_t brush_value = CLAMP(brush_alpha * spray_strength, 0.f, 1.f);
+										if (enable_texture && brush_alpha * strength * 11.f > 0.1f) {
+											// Painted area, set overlay immediatley
+											if (base_id == overlay_id && blend < 0.004f) {
+												overlay_id = asset_id;
+											}
+											// Overlay and base texture are the same, reduce blend value
+											if (base_id == asset_id) {
+												blend = CLAMP(blend - brush_value, 0.f, 1.f);
+												if (blend < 0.5f && brush_alpha > 0.5f) {
+													autoshader = false;
+												}
+											} else {
+												// Overlay and base are separate, increase blend value
+												blend = CLAMP(blend + brush_value, 0.f, 1.f);
+												// Overlay already visible, limit ID changes to high brush alpha
+												if (blend > 0.5f && brush_alpha > 0.5f) {
+													overlay_id = asset_id;
+													// Only remove auto shader when blend is past threshold.
+													autoshader = false;
+												}
+												// Overlay not visible at brush edge, write new ID ready for potential next pass
+												if (blend <= 0.5f && brush_alpha <= 0.5f) {
+													overlay_id = asset_id;
+												}
+											}
 										}
-										// Overlay not visible at brush edge, write new ID ready for potential next pass
-										if (blend <= 0.5f && brush_alpha <= 0.5f) {
-											overlay_id = asset_id;
+										if ((base_id == asset_id && blend < 0.5f) || (base_id != asset_id && blend >= 0.5f)) {
+											// Set angle & scale
+											if (enable_angle && !autoshader && brush_alpha > 0.5f) {
+												// Convert from degrees to 0 - 15 value range
+												uvrotation = uint32_t(CLAMP(Math::round(angle / 22.5f), 0.f, 15.f));
+											}
+											if (enable_scale && !autoshader && brush_alpha > 0.5f) {
+												// Offset negative and convert from percentage to 0 - 7 bit value range
+												// Maintain 0 = 0, remap negatives to end.
+												uvscale = scale_align[uint8_t(CLAMP(Math::round((scale + 60.f) / 20.f), 0.f, 7.f))];
+											}
 										}
+										break;
 									}
-								}
-								if ((base_id == asset_id && blend < 0.5f) || (base_id != asset_id && blend >= 0.5f)) {
-									// Set angle & scale
-									if (enable_angle && !autoshader && brush_alpha > 0.5f) {
-										if (dynamic_angle) {
-											// Angle from mouse movement.
-											angle = Vector2(-_operation_movement.x, _operation_movement.z).angle();
-											// Avoid negative, align texture "up" with mouse direction.
-											angle = real_t(Math::fmod(Math::rad_to_deg(angle) + 450.f, real_t(360.f)));
+
+									// Overlay Spray reduce
+									case SUBTRACT: {
+										real_t spray_strength = CLAMP(strength * 0.05f, 0.004f, .25f);
+										real_t brush_value = CLAMP(brush_alpha * spray_strength, 0.f, 1.f);
+										blend = CLAMP(blend - brush_value, 0.f, 1.f);
+										// Reset to painted state
+										if (blend < 0.004f) {
+											overlay_id = base_id;
 										}
-										// Convert from degrees to 0 - 15 value range
-										uvrotation = uint32_t(CLAMP(Math::round(angle / 22.5f), 0.f, 15.f));
+										break;
 									}
-									if (enable_scale && !autoshader && brush_alpha > 0.5f) {
-										// Offset negative and convert from percentage to 0 - 7 bit value range
-										// Maintain 0 = 0, remap negatives to end.
-										uvscale = scale_align[uint8_t(CLAMP(Math::round((scale + 60.f) / 20.f), 0.f, 7.f))];
+
+									default: {
+										break;
 									}
 								}
 								break;
 							}
-
-							// Overlay Spray reduce
-							case SUBTRACT: {
-								real_t spray_strength = CLAMP(strength * 0.05f, 0.004f, .25f);
-								real_t brush_value = CLAMP(brush_alpha * spray_strength, 0.f, 1.f);
-								blend = CLAMP(blend - brush_value, 0.f, 1.f);
-								// Reset to painted state
-								if (blend < 0.004f) {
-									overlay_id = base_id;
+							case AUTOSHADER: {
+								if (brush_alpha > 0.5f) {
+									autoshader = (_operation == ADD);
+									uvscale = 0.f;
+									uvrotation = 0.f;
+								}
+								break;
+							}
+							case HOLES: {
+								if (brush_alpha > 0.5f) {
+									hole = (_operation == ADD);
+								}
+								break;
+							}
+							case NAVIGATION: {
+								if (brush_alpha > 0.5f) {
+									navigation = (_operation == ADD);
 								}
 								break;
 							}
-
 							default: {
 								break;
 							}
 						}
-						break;
-					}
-					case AUTOSHADER: {
-						if (brush_alpha > 0.5f) {
-							autoshader = (_operation == ADD);
-							uvscale = 0.f;
-							uvrotation = 0.f;
+
+						// Convert back to bitfield
+						uint32_t blend_int = uint32_t(CLAMP(Math::round(blend * 255.f), 0.f, 255.f));
+						uint32_t bits = enc_base(base_id) | enc_overlay(overlay_id) |
+								enc_blend(blend_int) | enc_uv_rotation(uvrotation) |
+								enc_uv_scale(uvscale) | enc_hole(hole) |
+								enc_nav(navigation) | enc_auto(autoshader);
+
+						// Write back to pixel in FORMAT_RF. Must be a 32-bit float
+						dest = Color(as_float(bits), 0.f, 0.f, 1.f);
+
+					} else if (map_type == TYPE_COLOR) {
+						// Filter by visible texture, read in place so sparse control maps aren't expanded
+						if (texture_filter) {
+							float src_ctrl = brush_region.region->get_pixel(TYPE_CONTROL, map_pixel_position).r; // Must be float
+							int tex_id = (get_blend(src_ctrl) > 110 - margin) ? get_overlay(src_ctrl) : get_base(src_ctrl);
+							if (tex_id != asset_id) {
+								continue;
+							}
 						}
-						break;
-					}
-					case HOLES: {
-						if (brush_alpha > 0.5f) {
-							hole = (_operation == ADD);
+						if (!data->is_in_slope(brush_global_position, slope_range, modifier_alt)) {
+							continue;
 						}
-						break;
-					}
-					case NAVIGATION: {
-						if (brush_alpha > 0.5f) {
-							navigation = (_operation == ADD);
+						switch (_tool) {
+							case COLOR:
+								dest = src.lerp((_operation == ADD) ? color : COLOR_WHITE, brush_alpha * strength);
+								dest.a = src.a;
+								break;
+							case ROUGHNESS:
+								/* Roughness received from UI is -100 to 100. Changed to 0,1 before storing.
+								 * To convert 0,1 back to -100,100 use: 200 * (color.a - 0.5)
+								 * However Godot stores values as 8-bit ints. Roundtrip is = int(a*255)/255.0
+								 * Roughness 0 is saved as 0.5, but retreived is 0.498, or -0.4 roughness
+								 * We round the final amount in tool_settings.gd:_on_picked().
+								 */
+								if (_operation == ADD) {
+									dest.a = Math::lerp(real_t(src.a), real_t(.5f + .5f * roughness), brush_alpha * strength);
+								} else {
+									dest.a = Math::lerp(real_t(src.a), real_t(.5f), brush_alpha * strength);
+								}
+								break;
+							default:
+								break;
 						}
-						break;
-					}
-					default: {
-						break;
-					}
-				}
-
-				// Convert back to bitfield
-				uint32_t blend_int = uint32_t(CLAMP(Math::round(blend * 255.f), 0.f, 255.f));
-				uint32_t bits = enc_base(base_id) | enc_overlay(overlay_id) |
-						enc_blend(blend_int) | enc_uv_rotation(uvrotation) |
-						enc_uv_scale(uvscale) | enc_hole(hole) |
-						enc_nav(navigation) | enc_auto(autoshader);
-
-				// Write back to pixel in FORMAT_RF. Must be a 32-bit float
-				dest = Color(as_float(bits), 0.f, 0.f, 1.f);
-
-			} else if (map_type == TYPE_COLOR) {
-				// Filter by visible texture
-				if (texture_filter) {
-					Image *cmap = region->get_map_ptr(TYPE_CONTROL);
-					if (!cmap) {
-						continue;
 					}
-					float src_ctrl = cmap->get_pixelv(map_pixel_position).r; // Must be float
-					int tex_id = (get_blend(src_ctrl) > 110 - margin) ? get_overlay(src_ctrl) : get_base(src_ctrl);
-					if (tex_id != asset_id) {
-						continue;
-					}
-				}
-				if (!data->is_in_slope(brush_global_position, slope_range, modifier_alt)) {
-					continue;
+					tile.writes.push_back({ region_index, map_pixel_position, dest });
 				}
-				switch (_tool) {
-					case COLOR:
-						dest = src.lerp((_operation == ADD) ? color : COLOR_WHITE, brush_alpha * strength);
-						dest.a = src.a;
-						break;
-					case ROUGHNESS:
-						/* Roughness received from UI is -100 to 100. Changed to 0,1 before storing.
-						 * To convert 0,1 back to -100,100 use: 200 * (color.a - 0.5)
-						 * However Godot stores values as 8-bit ints. Roundtrip is = int(a*255)/255.0
-						 * Roughness 0 is saved as 0.5, but retreived is 0.498, or -0.4 roughness
-						 * We round the final amount in tool_settings.gd:_on_picked().
-						 */
-						if (_operation == ADD) {
-							dest.a = Math::lerp(real_t(src.a), real_t(.5f + .5f * roughness), brush_alpha * strength);
-						} else {
-							dest.a = Math::lerp(real_t(src.a), real_t(.5f), brush_alpha * strength);
-						}
-						break;
-					default:
-						break;
+			}
+		}
+	}, BRUSH_TILE_BATCH);
+
+	// Write the results in order on the main thread, straight into the map tiles or buffers
+	for (const BrushTile &tile : tiles) {
+		edited_area = edited_area.merge(tile.area);
+		for (const BrushWrite &write : tile.writes) {
+			BrushRegion &brush_region = regions[write.region];
+			if (!brush_region.written) {
+				// Save only the tiles written, or the whole region if they can't be copied
+				brush_region.backup = _get_tile_backup(brush_region.region, map_type);
+				if (brush_region.backup < 0) {
+					backup_region(brush_region.region);
 				}
+				// Separates the buffer shared with the undo backup
+				brush_region.dst = brush_region.src ? brush_region.map->ptrw() : nullptr;
+				brush_region.dirty = Rect2i(write.pixel, V2I(1));
+				brush_region.written = true;
+			}
+			if (brush_region.backup >= 0) {
+				_backup_tile(brush_region.backup, write.pixel);
 			}
-			backup_region(region);
-			map->set_pixelv(map_pixel_position, dest);
+			const int index = write.pixel.y * region_size + write.pixel.x;
+			if (brush_region.sparse) {
+				brush_region.sparse->set_pixel(write.pixel.x, write.pixel.y, write.value);
+			} else if (!brush_region.dst) {
+				brush_region.map->set_pixelv(write.pixel, write.value);
+			} else if (map_type == TYPE_COLOR) {
+				uint8_t *rgba = brush_region.dst + index * 4;
+				rgba[0] = uint8_t(CLAMP(write.value.r * 255.f, 0.f, 255.f));
+				rgba[1] = uint8_t(CLAMP(write.value.g * 255.f, 0.f, 255.f));
+				rgba[2] = uint8_t(CLAMP(write.value.b * 255.f, 0.f, 255.f));
+				rgba[3] = uint8_t(CLAMP(write.value.a * 255.f, 0.f, 255.f));
+			} else {
+				reinterpret_cast<float *>(brush_region.dst)[index] = write.value.r;
+			}
+			brush_region.dirty = brush_region.dirty.merge(Rect2i(write.pixel, V2I(1)));
+			if (map_type == TYPE_HEIGHT) {
+				brush_region.region->update_height(write.value.r);
+				data->update_master_height(write.value.r);
+			}
+		}
+	}
+	for (const BrushRegion &brush_region : regions) {
+		if (brush_region.written) {
+			brush_region.region->add_dirty_rect(map_type, brush_region.dirty);
+			// The writes may have separated a buffer shared with the undo backup
+			data->update_region_ptrs(brush_region.region->get_location());
 		}
 	}
+	if (map_type == TYPE_HEIGHT) {
+		data->update_height_pyramids(edited_area);
+	}
 	// Regenerate color mipmaps for edited regions
 	if (map_type == TYPE_COLOR) {
-		for (int i = 0; i < _edited_regions.size(); i++) {
-			Terrain3DRegion *region = cast_to<Terrain3DRegion>(_edited_regions[i]);
-			if (region) {
-				region->get_map(map_type)->generate_mipmaps();
+		for (const BrushRegion &brush_region : regions) {
+			if (brush_region.written) {
+				brush_region.map->generate_mipmaps();
 			}
 		}
 	}
-	// If no added or removed regions, update only changed texture array layers from the edited regions in the rendering server
+	// If no added or removed regions, update only changed texture array layers from the edited regions in the rendering server.
+	// Queued, so several brush events in one frame upload once.
 	if (_added_removed_locations.size() == regions_added_removed) {
-		data->update_maps(map_type, false, false);
+		data->queue_map_update(map_type, false, false);
 	} else {
 		// If region qty was changed, must fully rebuild the maps
-		data->update_maps(map_type, true, map_type == TYPE_COLOR);
+		data->queue_map_update(map_type, true, map_type == TYPE_COLOR);
 	}
 	data->add_edited_area(edited_area);
 
@@ -543,6 +745,98 @@ void Terrain3DEditor::_operate_map(const Vector3 &p_global_position, const real_
 	}
 }
 
+// Returns the index of the tile backup of the map in _tile_backups, adding one on first use in an
+// operation. Returns -1 if not operating, or the map isn't sparse or in a format with 4 bytes per
+// pixel.
+int Terrain3DEditor::_get_tile_backup(Terrain3DRegion *p_region, const MapType p_map_type) {
+	if (!_is_operating || !p_region) {
+		return -1;
+	}
+	for (int i = 0; i < int(_tile_backups.size()); i++) {
+		if (_tile_backups[i].region.ptr() == p_region && _tile_backups[i].map_type == p_map_type) {
+			return i;
+		}
+	}
+	const Image *map = p_region->get_map_ptr(p_map_type);
+	const int region_size = p_region->get_region_size();
+	const bool valid_image = map && map->get_size() == V2I(region_size) &&
+			(map->get_format() == Image::FORMAT_RF || map->get_format() == Image::FORMAT_RGBA8);
+	if (!valid_image && !p_region->is_sparse(p_map_type)) {
+		return -1;
+	}
+	LOG(DEBUG, "Storing original tiles of region: ", p_region->get_location(), " map type: ", p_map_type);
+	TileBackup backup;
+	backup.region = Ref<Terrain3DRegion>(p_region);
+	backup.map_type = p_map_type;
+	const int tiles_per_side = region_size / UNDO_TILE_SIZE;
+	backup.saved.resize(tiles_per_side * tiles_per_side, false);
+	_tile_backups.push_back(backup);
+	p_region->set_edited(true);
+	p_region->set_modified(true);
+	return int(_tile_backups.size()) - 1;
+}
+
+// Saves the tile containing the pixel, unless already saved in this operation
+void Terrain3DEditor::_backup_tile(const int p_backup, const Vector2i &p_pixel) {
+	TileBackup &backup = _tile_backups[p_backup];
+	const int tiles_per_side = backup.region->get_region_size() / UNDO_TILE_SIZE;
+	const int tile = (p_pixel.y / UNDO_TILE_SIZE) * tiles_per_side + p_pixel.x / UNDO_TILE_SIZE;
+	if (backup.saved[tile]) {
+		return;
+	}
+	backup.saved[tile] = true;
+	backup.tiles.push_back(tile);
+	backup.data.push_back(_read_tile(backup.region.ptr(), backup.map_type, tile));
+}
+
+// Copies a tile of a sparse map, or an Image map with 4 bytes per pixel. Tiles are numbered row
+// major.
+PackedByteArray Terrain3DEditor::_read_tile(const Terrain3DRegion *p_region, const MapType p_map_type, const int p_tile) {
+	PackedByteArray data;
+	std::shared_ptr<const SparseMap> sparse = p_region->get_sparse_map(p_map_type);
+	Image *map = p_region->get_map_ptr(p_map_type);
+	if (!sparse && !map) {
+		return data;
+	}
+	const int width = p_region->get_region_size();
+	const Vector2i origin = Vector2i(p_tile % (width / UNDO_TILE_SIZE), p_tile / (width / UNDO_TILE_SIZE)) * UNDO_TILE_SIZE;
+	const int row_bytes = UNDO_TILE_SIZE * 4;
+	data.resize(UNDO_TILE_SIZE * row_bytes);
+	if (sparse) {
+		sparse->read_rect(Rect2i(origin, V2I(UNDO_TILE_SIZE)), reinterpret_cast<uint32_t *>(data.ptrw()));
+		return data;
+	}
+	const uint8_t *src = map->ptr();
+	uint8_t *dst = data.ptrw();
+	for (int y = 0; y < UNDO_TILE_SIZE; y++) {
+		memcpy(dst + y * row_bytes, src + (int64_t(origin.y + y) * width + origin.x) * 4, row_bytes);
+	}
+	return data;
+}
+
+// Writes a tile copied by _read_tile() back into the map. Sparse maps only copy that tile.
+void Terrain3DEditor::_write_tile(Terrain3DRegion *p_region, const MapType p_map_type, const int p_tile, const PackedByteArray &p_data) {
+	const int row_bytes = UNDO_TILE_SIZE * 4;
+	if (p_data.size() != UNDO_TILE_SIZE * row_bytes) {
+		return;
+	}
+	const int width = p_region->get_region_size();
+	const Vector2i origin = Vector2i(p_tile % (width / UNDO_TILE_SIZE), p_tile / (width / UNDO_TILE_SIZE)) * UNDO_TILE_SIZE;
+	if (SparseMap *sparse = p_region->get_sparse_map_ptrw(p_map_type)) {
+		sparse->write_rect(Rect2i(origin, V2I(UNDO_TILE_SIZE)), reinterpret_cast<const uint32_t *>(p_data.ptr()));
+		return;
+	}
+	Image *map = p_region->get_map_ptrw(p_map_type);
+	if (!map) {
+		return;
+	}
+	const uint8_t *src = p_data.ptr();
+	uint8_t *dst = map->ptrw();
+	for (int y = 0; y < UNDO_TILE_SIZE; y++) {
+		memcpy(dst + (int64_t(origin.y + y) * width + origin.x) * 4, src + y * row_bytes, row_bytes);
+	}
+}
+
 void Terrain3DEditor::_store_undo() {
 	IS_INIT_COND_MESG(!_terrain->get_plugin(), "_terrain isn't initialized, returning", VOID);
 	if (_tool < 0 || _tool >= TOOL_MAX) {
@@ -555,6 +849,66 @@ void Terrain3DEditor::_store_undo() {
 	// Store original and current backups of edited regions
 	_undo_data["edited_regions"] = _original_regions;
 	redo_data["edited_regions"] = _edited_regions;
+	// Store original and current copies of the edited map tiles in the undo store, which
+	// compresses them. The snapshots only keep their ids.
+	if (!_tile_backups.empty()) {
+		Array undo_tiles;
+		Array redo_tiles;
+		for (const TileBackup &backup : _tile_backups) {
+			Dictionary undo_entry;
+			undo_entry["location"] = backup.region->get_location();
+			undo_entry["map_type"] = backup.map_type;
+			undo_entry["tiles"] = backup.tiles;
+			Dictionary redo_entry = undo_entry.duplicate();
+			PackedInt64Array undo_ids;
+			PackedInt64Array redo_ids;
+			for (int i = 0; i < backup.tiles.size(); i++) {
+				undo_ids.push_back(_undo_store.store(backup.data[i], UNDO_TILE_SIZE, UNDO_TILE_SIZE));
+				redo_ids.push_back(_undo_store.store(_read_tile(backup.region.ptr(), backup.map_type, backup.tiles[i]), UNDO_TILE_SIZE, UNDO_TILE_SIZE));
+			}
+			undo_entry["ids"] = undo_ids;
+			redo_entry["ids"] = redo_ids;
+			undo_tiles.push_back(undo_entry);
+			redo_tiles.push_back(redo_entry);
+		}
+		_undo_data["edited_tiles"] = undo_tiles;
+		redo_data["edited_tiles"] = redo_tiles;
+		LOG(INFO, "Undo tile memory: ", _undo_store.get_usage());
+	}
+	// Store original and current buffers of the edited instance cells. Buffers are shared until
+	// written, so this doesn't copy them.
+	if (!_instance_backups.empty()) {
+		Array undo_instances;
+		Array redo_instances;
+		for (const InstanceBackup &backup : _instance_backups) {
+			const InstanceData *instances = backup.region->get_instances_ptr();
+			PackedInt32Array mesh_ids;
+			Array cells;
+			Array undo_buffers;
+			Array redo_buffers;
+			for (const int mesh_id : backup.cells.get_mesh_ids()) {
+				const InstanceData::CellMap *current = instances->get_cells(mesh_id);
+				for (const auto &cell_it : *backup.cells.get_cells(mesh_id)) {
+					mesh_ids.push_back(mesh_id);
+					cells.push_back(cell_it.first);
+					undo_buffers.push_back(cell_it.second.buffer);
+					auto it = current ? current->find(cell_it.first) : InstanceData::CellMap::const_iterator();
+					redo_buffers.push_back((current && it != current->end()) ? it->second.buffer : PackedFloat32Array());
+				}
+			}
+			Dictionary undo_entry;
+			undo_entry["location"] = backup.region->get_location();
+			undo_entry["mesh_ids"] = mesh_ids;
+			undo_entry["cells"] = cells;
+			Dictionary redo_entry = undo_entry.duplicate();
+			undo_entry["buffers"] = undo_buffers;
+			redo_entry["buffers"] = redo_buffers;
+			undo_instances.push_back(undo_entry);
+			redo_instances.push_back(redo_entry);
+		}
+		_undo_data["edited_instances"] = undo_instances;
+		redo_data["edited_instances"] = redo_instances;
+	}
 
 	// Store regions that were added or removed
 	if (_added_removed_locations.size() > 0) {
@@ -596,6 +950,23 @@ void Terrain3DEditor::_apply_undo(const Dictionary &p_data) {
 
 	Terrain3DData *data = _terrain->get_data();
 
+	// Tiles may have been dropped to stay within the undo memory budget. Apply all or nothing.
+	if (p_data.has("edited_tiles")) {
+		Array entries = p_data["edited_tiles"];
+		for (int i = 0; i < entries.size(); i++) {
+			Dictionary entry = entries[i];
+			PackedInt64Array ids = entry["ids"];
+			for (int t = 0; t < ids.size(); t++) {
+				if (!_undo_store.has(ids[t])) {
+					LOG(ERROR, "This undo step exceeded the undo memory budget and was discarded. Increase ",
+							"Editor Settings / Terrain3D / Config / Undo Memory Budget MB to keep more history");
+					return;
+				}
+			}
+		}
+	}
+
+	Dictionary replaced_locations;
 	if (p_data.has("edited_regions")) {
 		Util::print_arr("Edited regions", p_data["edited_regions"]);
 		TypedArray<Terrain3DRegion> undo_regions = p_data["edited_regions"];
@@ -610,11 +981,94 @@ void Terrain3DEditor::_apply_undo(const Dictionary &p_data) {
 			Dictionary regions = data->get_regions_all();
 			regions[region->get_location()] = region;
 			region->set_modified(true);
-			// Tell update_maps() this region has layers that can be individually updated
+			// Tell update_maps() this region has layers that can be individually updated, in full
 			region->set_edited(true);
+			region->clear_dirty_rects();
+			replaced_locations[region->get_location()] = true;
 		}
 	}
 
+	TypedArray<Terrain3DRegion> tile_regions;
+	if (p_data.has("edited_tiles")) {
+		Array entries = p_data["edited_tiles"];
+		LOG(DEBUG, "Backup has ", entries.size(), " edited maps");
+		for (int i = 0; i < entries.size(); i++) {
+			Dictionary entry = entries[i];
+			Vector2i region_loc = entry["location"];
+			MapType map_type = MapType(int(entry["map_type"]));
+			Terrain3DRegion *region = data->get_region_ptr(region_loc);
+			if (!region || (!region->is_sparse(map_type) && !region->get_map_ptr(map_type))) {
+				LOG(ERROR, "Region ", region_loc, " saved in undo data has no map type ", map_type, ". Please report this error.");
+				continue;
+			}
+			PackedInt32Array tiles = entry["tiles"];
+			PackedInt64Array ids = entry["ids"];
+			Rect2i restored;
+			for (int t = 0; t < tiles.size() && t < ids.size(); t++) {
+				_write_tile(region, map_type, tiles[t], _undo_store.fetch(ids[t]));
+				const int tiles_per_side = region->get_region_size() / UNDO_TILE_SIZE;
+				Vector2i origin = Vector2i(tiles[t] % tiles_per_side, tiles[t] / tiles_per_side) * UNDO_TILE_SIZE;
+				Rect2i tile_rect = Rect2i(origin, V2I(UNDO_TILE_SIZE));
+				region->add_dirty_rect(map_type, tile_rect);
+				restored = restored.has_area() ? restored.merge(tile_rect) : tile_rect;
+			}
+			if (map_type == TYPE_HEIGHT) {
+				region->calc_height_range();
+			} else if (map_type == TYPE_COLOR) {
+				Image *map = region->get_map_ptr(map_type);
+				if (map && map->has_mipmaps()) {
+					map->generate_mipmaps();
+				}
+			}
+			// Regions replaced above are uploaded in full
+			if (replaced_locations.has(region_loc)) {
+				region->clear_dirty_rects();
+			}
+			data->update_region_ptrs(region_loc);
+			// Refresh the pyramids raycasts use over the restored heights
+			if (map_type == TYPE_HEIGHT && restored.has_area()) {
+				const real_t vertex_spacing = _terrain->get_vertex_spacing();
+				const Vector2 position = Vector2(region_loc * region->get_region_size() + restored.position) * vertex_spacing;
+				const Vector2 size = Vector2(restored.size) * vertex_spacing;
+				data->update_height_pyramids(AABB(Vector3(position.x, 0.f, position.y), Vector3(size.x, 0.f, size.y)));
+			}
+			region->set_modified(true);
+			// Tell update_maps() to upload the restored tiles of this region
+			region->set_edited(true);
+			tile_regions.push_back(region);
+		}
+	}
+	if (p_data.has("edited_instances")) {
+		Terrain3DInstancer *instancer = _terrain->get_instancer();
+		Array entries = p_data["edited_instances"];
+		LOG(DEBUG, "Backup has ", entries.size(), " regions with edited instances");
+		for (int i = 0; i < entries.size(); i++) {
+			Dictionary entry = entries[i];
+			Vector2i region_loc = entry["location"];
+			Terrain3DRegion *region = data->get_region_ptr(region_loc);
+			if (!region) {
+				LOG(ERROR, "Region ", region_loc, " saved in undo data not found. Please report this error.");
+				continue;
+			}
+			InstanceData *instances = region->get_instances_ptr();
+			PackedInt32Array mesh_ids = entry["mesh_ids"];
+			Array cells = entry["cells"];
+			Array buffers = entry["buffers"];
+			for (int c = 0; c < mesh_ids.size() && c < cells.size() && c < buffers.size(); c++) {
+				PackedFloat32Array buffer = buffers[c];
+				if (buffer.is_empty()) {
+					instancer->_destroy_mmi_by_cell(region_loc, mesh_ids[c], cells[c]);
+					instances->erase_cell(mesh_ids[c], cells[c]);
+				} else {
+					InstanceData::Cell &cell = instances->get_or_add_cell(mesh_ids[c], cells[c]);
+					cell.buffer = buffer;
+					cell.modified = true;
+				}
+			}
+			region->set_modified(true);
+			instancer->_update_mmis(region_loc);
+		}
+	}
 	if (p_data.has("edited_area")) {
 		LOG(DEBUG, "Edited area: ", p_data["edited_area"]);
 		data->add_edited_area(p_data["edited_area"]);
@@ -657,6 +1111,9 @@ void Terrain3DEditor::_apply_undo(const Dictionary &p_data) {
 		data->update_maps(TYPE_MAX, false, false);
 	}
 	// After TextureArray updates clear edited regions flag.
+	for (int i = 0; i < tile_regions.size(); i++) {
+		cast_to<Terrain3DRegion>(tile_regions[i])->set_edited(false);
+	}
 	if (p_data.has("edited_regions")) {
 		TypedArray<Terrain3DRegion> undo_regions = p_data["edited_regions"];
 		for (int i = 0; i < undo_regions.size(); i++) {
@@ -666,7 +1123,31 @@ void Terrain3DEditor::_apply_undo(const Dictionary &p_data) {
 			}
 		}
 	}
-	_terrain->get_instancer()->update_mmis(true);
+	// Instance cells restored above are already updated. Rebuild only if regions holding instances,
+	// or drawn with them, were replaced, added or removed.
+	Terrain3DInstancer *instancer = _terrain->get_instancer();
+	auto has_instances = [&](const Vector2i &p_region_loc) {
+		const Terrain3DRegion *region = data->get_region_ptr(p_region_loc);
+		return (region && region->get_instance_count() > 0) || instancer->_mmi_nodes.count(p_region_loc) > 0 ||
+				instancer->_mmi_rids.count(p_region_loc) > 0;
+	};
+	bool rebuild_instances = false;
+	for (const char *key : { "added_regions", "removed_regions" }) {
+		TypedArray<Vector2i> region_locs = p_data.get(key, TypedArray<Vector2i>());
+		for (int i = 0; i < region_locs.size() && !rebuild_instances; i++) {
+			rebuild_instances = has_instances(region_locs[i]);
+		}
+	}
+	if (p_data.has("edited_regions")) {
+		TypedArray<Terrain3DRegion> undo_regions = p_data["edited_regions"];
+		for (int i = 0; i < undo_regions.size() && !rebuild_instances; i++) {
+			Terrain3DRegion *region = cast_to<Terrain3DRegion>(undo_regions[i]);
+			rebuild_instances = region && has_instances(region->get_location());
+		}
+	}
+	if (rebuild_instances) {
+		instancer->update_mmis(true);
+	}
 	if (_terrain->get_plugin()->has_method("update_grid")) {
 		LOG(DEBUG, "Calling GDScript update_grid()");
 		_terrain->get_plugin()->call("update_grid");
@@ -688,6 +1169,10 @@ void Terrain3DEditor::set_brush_data(const Dictionary &p_data) {
 	if (brush_images.size() == 2) {
 		Ref<Image> img = brush_images[0];
 		if (img.is_valid() && !img->is_empty()) {
+			// Stamps of the previous brush won't be used again
+			if (img.ptr() != cast_to<Image>(_brush_data.get("brush_image", Variant()))) {
+				_brush_stamps.clear();
+			}
 			_brush_data["brush_image"] = img;
 			_brush_data["brush_image_size"] = img->get_size();
 		} else {
@@ -737,6 +1222,7 @@ void Terrain3DEditor::set_brush_data(const Dictionary &p_data) {
 	_brush_data["align_to_view"] = bool(p_data.get("align_to_view", true));
 	_brush_data["gamma"] = CLAMP(real_t(p_data.get("gamma", 1.f)), 0.1f, 2.f);
 	_brush_data["jitter"] = CLAMP(real_t(p_data.get("jitter", 0.f)), 0.f, 1.f);
+	_brush_data["rotation_buckets"] = CLAMP(int(p_data.get("rotation_buckets", 64)), 1, 360);
 	_brush_data["gradient_points"] = p_data.get("gradient_points", PackedVector3Array());
 
 	Util::print_dict("set_brush_data() Santized brush data:", _brush_data, EXTREME);
@@ -760,6 +1246,8 @@ void Terrain3DEditor::start_operation(const Vector3 &p_global_position) {
 	_is_operating = true;
 	_original_regions = TypedArray<Terrain3DRegion>(); // New pointers instead of clear
 	_edited_regions = TypedArray<Terrain3DRegion>();
+	_tile_backups.clear();
+	_instance_backups.clear();
 	_added_removed_locations = TypedArray<Vector2i>();
 	// Reset counter at start to ensure first click places an instance
 	_terrain->get_instancer()->reset_density_counter();
@@ -797,8 +1285,10 @@ void Terrain3DEditor::operate(const Vector3 &p_global_position, const real_t p_c
 	}
 }
 
+// Saves a copy of the whole region for undo, for edits other than map tiles, such as instances.
+// May also follow a tile backup of the same region, as undo restores tiles after regions.
 void Terrain3DEditor::backup_region(const Ref<Terrain3DRegion> &p_region) {
-	if (_is_operating && p_region.is_valid() && !p_region->is_edited()) {
+	if (_is_operating && p_region.is_valid() && !_edited_regions.has(p_region)) {
 		LOG(DEBUG, "Storing original copy of region: ", p_region->get_location());
 		_original_regions.push_back(p_region->duplicate(true));
 		_edited_regions.push_back(p_region);
@@ -807,13 +1297,54 @@ void Terrain3DEditor::backup_region(const Ref<Terrain3DRegion> &p_region) {
 	}
 }
 
+// Saves the instances of one cell for undo, unless already saved in this operation. Edits of a
+// few cells use this rather than backup_region(), which copies the whole region.
+void Terrain3DEditor::backup_instance_cell(const Ref<Terrain3DRegion> &p_region, const int p_mesh_id, const Vector2i &p_cell) {
+	if (p_region.is_null()) {
+		return;
+	}
+	p_region->set_modified(true);
+	if (!_is_operating) {
+		return;
+	}
+	InstanceBackup *backup = nullptr;
+	for (InstanceBackup &existing : _instance_backups) {
+		if (existing.region == p_region) {
+			backup = &existing;
+			break;
+		}
+	}
+	if (!backup) {
+		LOG(DEBUG, "Storing original instance cells of region: ", p_region->get_location());
+		_instance_backups.push_back(InstanceBackup());
+		backup = &_instance_backups.back();
+		backup->region = p_region;
+	}
+	const InstanceData::CellMap *saved = backup->cells.get_cells(p_mesh_id);
+	if (saved && saved->count(p_cell) > 0) {
+		return;
+	}
+	const InstanceData *instances = p_region->get_instances_ptr();
+	const InstanceData::CellMap *cells = instances->get_cells(p_mesh_id);
+	auto it = cells ? cells->find(p_cell) : InstanceData::CellMap::const_iterator();
+	backup->cells.get_or_add_cell(p_mesh_id, p_cell).buffer = (cells && it != cells->end()) ? it->second.buffer : PackedFloat32Array();
+}
+
 // Called on left mouse button released
 void Terrain3DEditor::stop_operation() {
 	IS_DATA_INIT_MESG("Terrain isn't initialized", VOID);
 	// If undo was created and terrain actually modified, store it
 	LOG(DEBUG, "Backed up regions: ", _original_regions.size(), ", Edited regions: ", _edited_regions.size(),
+			", Backed up maps: ", int(_tile_backups.size()), ", Backed up instances: ", int(_instance_backups.size()),
 			", Added/Removed regions: ", _added_removed_locations.size());
-	if (_is_operating && (!_added_removed_locations.is_empty() || !_edited_regions.is_empty())) {
+	const bool edited = !_added_removed_locations.is_empty() || !_edited_regions.is_empty() ||
+			!_tile_backups.empty() || !_instance_backups.empty();
+	if (_is_operating && edited) {
+		// Upload queued edits while the regions are still marked edited
+		_terrain->get_data()->flush_map_updates();
+		for (const TileBackup &backup : _tile_backups) {
+			backup.region->set_edited(false);
+		}
 		for (int i = 0; i < _edited_regions.size(); i++) {
 			Ref<Terrain3DRegion> region = _edited_regions[i];
 			region->set_edited(false);
@@ -825,6 +1356,8 @@ void Terrain3DEditor::stop_operation() {
 	_undo_data.clear();
 	_original_regions = TypedArray<Terrain3DRegion>(); //New pointers instead of clear
 	_edited_regions = TypedArray<Terrain3DRegion>();
+	_tile_backups.clear();
+	_instance_backups.clear();
 	_added_removed_locations = TypedArray<Vector2i>();
 	_terrain->get_data()->clear_edited_area();
 	_is_operating = false;
@@ -870,5 +1403,11 @@ void Terrain3DEditor::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("backup_region", "region"), &Terrain3DEditor::backup_region);
 	ClassDB::bind_method(D_METHOD("stop_operation"), &Terrain3DEditor::stop_operation);
 
+	ClassDB::bind_method(D_METHOD("set_undo_memory_budget", "bytes"), &Terrain3DEditor::set_undo_memory_budget);
+	ClassDB::bind_method(D_METHOD("get_undo_memory_budget"), &Terrain3DEditor::get_undo_memory_budget);
+	ClassDB::bind_method(D_METHOD("set_undo_spill_to_disk", "enabled"), &Terrain3DEditor::set_undo_spill_to_disk);
+	ClassDB::bind_method(D_METHOD("get_undo_spill_to_disk"), &Terrain3DEditor::get_undo_spill_to_disk);
+	ClassDB::bind_method(D_METHOD("get_undo_memory_usage"), &Terrain3DEditor::get_undo_memory_usage);
+
 	ClassDB::bind_method(D_METHOD("apply_undo", "data"), &Terrain3DEditor::_apply_undo);
 }
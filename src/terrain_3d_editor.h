@@ -5,9 +5,11 @@
 
 #include <godot_cpp/classes/image.hpp>
 #include <godot_cpp/classes/image_texture.hpp>
+#include <vector>
 
 #include "terrain_3d.h"
 #include "terrain_3d_region.h"
+#include "undo_store.h"
 
 using namespace godot;
 
@@ -16,6 +18,12 @@ class Terrain3DEditor : public Object {
 	CLASS_NAME();
 
 public: // Constants
+	static inline const int BRUSH_TILE_SIZE = 64; // Brush pixels per side processed by one worker task
+	static inline const int BRUSH_TILE_BATCH = 1; // Brush tiles per worker task, each is already large
+	static inline const int BRUSH_STAMP_BATCH = 8; // Brush stamp columns per worker task
+	static inline const int BRUSH_STAMP_CACHE_BYTES = 64 * 1024 * 1024; // Memory for cached brush stamps
+	static inline const int UNDO_TILE_SIZE = 64; // Pixels per side of map tiles saved for undo
+
 	enum Tool {
 		REGION,
 		SCULPT,
@@ -85,6 +93,36 @@ private:
 	Dictionary _undo_data; // See _get_undo_data for definition
 	uint64_t _last_pen_tick = 0;
 
+	// Brush alpha resampled to one float per vertex for a rotation, see _get_brush_stamp()
+	struct BrushStamp {
+		const Image *image = nullptr;
+		int pixels = 0; // Vertices per side
+		int rotation = 0; // Bucket, or -1 for an exact angle
+		int buckets = 0;
+		real_t angle = 0.f; // Radians
+		real_t gamma = 1.f;
+		std::vector<float> alphas;
+	};
+	std::vector<BrushStamp> _brush_stamps; // Most recently used last
+
+	// Original map tiles of a region, saved before their first write in an operation. See _backup_tile()
+	struct TileBackup {
+		Ref<Terrain3DRegion> region;
+		MapType map_type = TYPE_MAX;
+		std::vector<bool> saved; // Per tile, row major
+		PackedInt32Array tiles; // Saved tile indices
+		Array data; // PackedByteArray of each saved tile
+	};
+	std::vector<TileBackup> _tile_backups; // Queue for undo
+
+	// Original instance cells of a region, saved before their first change in an operation. See backup_instance_cell()
+	struct InstanceBackup {
+		Ref<Terrain3DRegion> region;
+		InstanceData cells; // Empty buffers for cells that didn't exist
+	};
+	std::vector<InstanceBackup> _instance_backups; // Queue for undo
+	UndoStore _undo_store; // Compressed tiles referenced by the undo history
+
 	void _send_region_aabb(const Vector2i &p_region_loc, const Vector2 &p_height_range = Vector2());
 	Terrain3DRegion *_operate_region(const Vector2i &p_region_loc);
 	void _operate_map(const Vector3 &p_global_position, const real_t p_camera_direction);
@@ -92,6 +130,13 @@ private:
 	bool _is_in_bounds(const Point2i &p_pixel, const Point2i &p_size) const;
 	Vector2 _get_uv_position(const Vector3 &p_global_position, const int p_region_size, const real_t p_vertex_spacing) const;
 	Vector2 _get_rotated_uv(const Vector2 &p_uv, const real_t p_angle) const;
+	const std::vector<float> *_get_brush_stamp(const Image *p_image, const int p_pixels, const int p_rotation, const int p_buckets,
+			const real_t p_angle, const real_t p_gamma);
+	float _get_brush_alpha(const Image *p_image, const int p_pixels, const Vector2i &p_pixel, const real_t p_angle, const real_t p_gamma) const;
+	int _get_tile_backup(Terrain3DRegion *p_region, const MapType p_map_type);
+	void _backup_tile(const int p_backup, const Vector2i &p_pixel);
+	static PackedByteArray _read_tile(const Terrain3DRegion *p_region, const MapType p_map_type, const int p_tile);
+	static void _write_tile(Terrain3DRegion *p_region, const MapType p_map_type, const int p_tile, const PackedByteArray &p_data);
 	void _store_undo();
 	void _apply_undo(const Dictionary &p_data);
 
@@ -112,8 +157,15 @@ public:
 	bool is_operating() const { return _is_operating; }
 	void operate(const Vector3 &p_global_position, const real_t p_camera_direction);
 	void backup_region(const Ref<Terrain3DRegion> &p_region);
+	void backup_instance_cell(const Ref<Terrain3DRegion> &p_region, const int p_mesh_id, const Vector2i &p_cell);
 	void stop_operation();
 
+	void set_undo_memory_budget(const int64_t p_bytes) { _undo_store.set_memory_budget(p_bytes); }
+	int64_t get_undo_memory_budget() const { return _undo_store.get_memory_budget(); }
+	void set_undo_spill_to_disk(const bool p_enabled) { _undo_store.set_spill_to_disk(p_enabled); }
+	bool get_undo_spill_to_disk() const { return _undo_store.get_spill_to_disk(); }
+	Dictionary get_undo_memory_usage() const { return _undo_store.get_usage(); }
+
 protected:
 	static void _bind_methods();
 };
@@ -1,6 +1,11 @@
 // Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
 
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
 #include <godot_cpp/classes/resource_saver.hpp>
+#include <godot_cpp/classes/world3d.hpp>
+#include <algorithm>
+#include <cstring>
 
 #include "constants.h"
 #include "logger.h"
@@ -25,6 +30,12 @@ void Terrain3DInstancer::_update_mmis(const Vector2i &p_region_loc, const int p_
 	} else {
 		region_locations.push_back(p_region_loc);
 	}
+	// Server instances need the scenario, and are created on entering the tree
+	const bool server_mode = is_server_mode();
+	if (server_mode && !_terrain->is_inside_tree()) {
+		LOG(DEBUG, "Terrain3D isn't in the tree, skipping server instances");
+		return;
+	}
 	for (int r = 0; r < region_locations.size(); r++) {
 		Vector2i region_loc = region_locations[r];
 		Terrain3DRegion *region = _terrain->get_data()->get_region_ptr(region_loc);
@@ -32,171 +43,431 @@ void Terrain3DInstancer::_update_mmis(const Vector2i &p_region_loc, const int p_
 			LOG(WARN, "Errant null region found at: ", region_loc);
 			continue;
 		}
-		Dictionary mesh_inst_dict = region->get_instances();
+		InstanceData *instances = region->get_instances_ptr();
 
 		// For specified mesh id in that region, or -1 for all
-		Array mesh_types;
+		std::vector<int> mesh_types;
 		if (p_mesh_id < 0) {
-			mesh_types = mesh_inst_dict.keys();
+			mesh_types = instances->get_mesh_ids();
 		} else {
 			mesh_types.push_back(p_mesh_id);
 		}
-		for (int m = 0; m < mesh_types.size(); m++) {
-			int mesh_id = mesh_types[m];
+		for (const int mesh_id : mesh_types) {
+			Ref<Terrain3DMeshAsset> ma = _get_drawable_mesh_asset(mesh_id);
+			if (ma.is_null()) {
+				continue;
+			}
+			InstanceData::CellMap *cells = instances->get_cells(mesh_id);
+			if (!cells) {
+				continue;
+			}
+			for (auto &cell_it : *cells) {
+				_update_cell_mmis(region, mesh_id, ma, cell_it.first, cell_it.second, server_mode);
+			}
+		}
+	}
+}
 
-			// Verify mesh id is valid and has some meshes
-			Ref<Terrain3DMeshAsset> ma = _terrain->get_assets()->get_mesh_asset(mesh_id);
-			if (ma.is_valid()) {
-				if (!ma->is_enabled()) {
-					continue;
-				}
-				if (ma->get_lod_count() == 0) {
-					LOG(WARN, "MeshAsset ", mesh_id, " valid but has no meshes, skipping");
-					continue;
-				}
-			} else {
-				LOG(WARN, "MeshAsset ", mesh_id, " is null, skipping");
+// Returns the mesh asset if it's valid, enabled and has some meshes
+Ref<Terrain3DMeshAsset> Terrain3DInstancer::_get_drawable_mesh_asset(const int p_mesh_id) const {
+	Ref<Terrain3DMeshAsset> ma = _terrain->get_assets()->get_mesh_asset(p_mesh_id);
+	if (ma.is_null()) {
+		LOG(WARN, "MeshAsset ", p_mesh_id, " is null, skipping");
+		return Ref<Terrain3DMeshAsset>();
+	}
+	if (!ma->is_enabled()) {
+		return Ref<Terrain3DMeshAsset>();
+	}
+	if (ma->get_lod_count() == 0) {
+		LOG(WARN, "MeshAsset ", p_mesh_id, " valid but has no meshes, skipping");
+		return Ref<Terrain3DMeshAsset>();
+	}
+	return ma;
+}
+
+// Creates or updates the MMIs, or server instances, of all lods of one cell
+void Terrain3DInstancer::_update_cell_mmis(Terrain3DRegion *p_region, const int p_mesh_id, const Ref<Terrain3DMeshAsset> &p_ma,
+		const Vector2i &p_cell, InstanceData::Cell &p_cell_data, const bool p_server_mode) {
+	// Get instances
+	const Vector2i region_loc = p_region->get_location();
+	bool modified = p_cell_data.modified;
+	if (p_cell_data.get_count() == 0) {
+		LOG(WARN, "Empty cell in region ", region_loc, " cell ", p_cell);
+		return;
+	}
+
+	// Position the instances at their region location
+	Transform3D t = Transform3D();
+	int region_size = p_region->get_region_size();
+	real_t vertex_spacing = _terrain->get_vertex_spacing();
+	t.origin.x += region_loc.x * region_size * vertex_spacing;
+	t.origin.z += region_loc.y * region_size * vertex_spacing;
+
+	// Setup RenderingServer instances for each lod, from the last so the shadow impostor
+	// source exists before the shadow lod
+	if (p_server_mode) {
+		RID shadow_impostor_source_mm;
+		for (int lod = p_ma->get_last_lod(); lod >= Terrain3DMeshAsset::SHADOW_LOD_ID; lod--) {
+			if (!_is_lod_drawn(p_ma, lod) || (lod == Terrain3DMeshAsset::SHADOW_LOD_ID && !shadow_impostor_source_mm.is_valid())) {
 				continue;
 			}
+			RID mm = _update_cell_rids(region_loc, Vector2i(p_mesh_id, lod), p_cell, p_cell_data, p_ma, t,
+					shadow_impostor_source_mm, modified);
+			if (lod == p_ma->get_shadow_impostor()) {
+				shadow_impostor_source_mm = mm;
+			}
+		}
+		p_cell_data.modified = false;
+		return;
+	}
 
-			Dictionary cell_inst_dict = mesh_inst_dict[mesh_id];
-			Array cell_locations = cell_inst_dict.keys();
-			for (int c = 0; c < cell_locations.size(); c++) {
-				// Get instances
-				Vector2i cell = cell_locations[c];
-				Array triple = cell_inst_dict[cell];
-				if (triple.size() < 3) {
-					LOG(WARN, "Triple is empty");
-					continue;
-				}
-				TypedArray<Transform3D> xforms = triple[0];
-				PackedColorArray colors = triple[1];
-				bool modified = triple[2];
-				if (xforms.size() == 0) {
-					LOG(WARN, "Empty cell in region ", region_loc, " cell ", cell);
-					continue;
-				}
+	// Create MMI container if needed
+	String rname("Region" + Util::location_to_string(region_loc));
+	if (_mmi_containers.count(region_loc) == 0) {
+		LOG(DEBUG, "Creating new region MMI container Terrain3D/MMI/", rname);
+		Node3D *node = memnew(Node3D);
+		node->set_name(rname);
+		_mmi_containers[region_loc] = node;
+		_terrain->get_mmi_parent()->add_child(node, true);
+	}
 
-				// Create MMI container if needed
-				String rname("Region" + Util::location_to_string(region_loc));
-				if (_mmi_containers.count(region_loc) == 0) {
-					LOG(DEBUG, "Creating new region MMI container Terrain3D/MMI/", rname);
-					Node3D *node = memnew(Node3D);
-					node->set_name(rname);
-					_mmi_containers[region_loc] = node;
-					_terrain->get_mmi_parent()->add_child(node, true);
-				}
+	// Setup MMIs for each lod
+	MeshMMIDict &mesh_mmi_dict = _mmi_nodes[region_loc];
+	Ref<MultiMesh> shadow_impostor_source_mm;
 
-				// Setup MMIs for each lod
-				MeshMMIDict &mesh_mmi_dict = _mmi_nodes[region_loc];
-				Ref<MultiMesh> shadow_impostor_source_mm;
+	for (int lod = p_ma->get_last_lod(); lod >= Terrain3DMeshAsset::SHADOW_LOD_ID; lod--) {
+		if (!_is_lod_drawn(p_ma, lod)) {
+			continue;
+		}
 
-				for (int lod = ma->get_last_lod(); lod >= Terrain3DMeshAsset::SHADOW_LOD_ID; lod--) {
-					// Don't create shadow MMI if not needed
-					if (lod == Terrain3DMeshAsset::SHADOW_LOD_ID) {
-						if (ma->get_shadow_impostor() == 0 ||
-								ma->get_cast_shadows() == SHADOWS_OFF ||
-								ma->get_cast_shadows() == SHADOWS_ONLY) {
-							continue;
-						}
-					}
-					// Don't create MMIs for lods > last_shadow_lod in cast shadows mode
-					if (lod > ma->get_last_shadow_lod() && ma->get_cast_shadows() == SHADOWS_ONLY) {
-						continue;
-					}
+		// Get or create MMI
+		Vector2i mesh_key(p_mesh_id, lod);
+		CellMMIDict &cell_mmi_dict = mesh_mmi_dict[mesh_key];
+		MultiMeshInstance3D *mmi;
+		if (cell_mmi_dict.count(p_cell) == 0) {
+			mmi = memnew(MultiMeshInstance3D);
+			LOG(DEBUG, "No MMI found, Created new MultiMeshInstance3D: ", uint64_t(mmi));
+			// Node name is MMI3D_Cell##_##_Mesh#_LOD#
+			String cstring = "_C" + Util::location_to_string(p_cell).trim_prefix("_");
+			String mstring = "_M" + String::num_int64(p_mesh_id);
+			String lstring = "_L" + ((lod == Terrain3DMeshAsset::SHADOW_LOD_ID) ? "S" : String::num_int64(lod));
+			mmi->set_name("MMI3D" + cstring + mstring + lstring);
+			mmi->set_as_top_level(true);
+			cell_mmi_dict[p_cell] = mmi;
+
+			//Attach to tree
+			Node *node_container = _terrain->get_mmi_parent()->get_node_internal(rname);
+			if (!node_container) {
+				LOG(ERROR, rname, " isn't attached to the tree.");
+				continue;
+			}
+			node_container->add_child(mmi, true);
+			// New MMIs must be updated
+			modified = true;
+		}
+		// If data hasn't changed since last _update_mmis, skip
+		if (modified == false) {
+			continue;
+		}
 
-					// Get or create MMI
-					Vector2i mesh_key(mesh_id, lod);
-					CellMMIDict &cell_mmi_dict = mesh_mmi_dict[mesh_key];
-					MultiMeshInstance3D *mmi;
-					if (cell_mmi_dict.count(cell) == 0) {
-						mmi = memnew(MultiMeshInstance3D);
-						LOG(DEBUG, "No MMI found, Created new MultiMeshInstance3D: ", uint64_t(mmi));
-						// Node name is MMI3D_Cell##_##_Mesh#_LOD#
-						String cstring = "_C" + Util::location_to_string(cell).trim_prefix("_");
-						String mstring = "_M" + String::num_int64(mesh_id);
-						String lstring = "_L" + ((lod == Terrain3DMeshAsset::SHADOW_LOD_ID) ? "S" : String::num_int64(lod));
-						mmi->set_name("MMI3D" + cstring + mstring + lstring);
-						mmi->set_as_top_level(true);
-						cell_mmi_dict[cell] = mmi;
-
-						//Attach to tree
-						Node *node_container = _terrain->get_mmi_parent()->get_node_internal(rname);
-						if (!node_container) {
-							LOG(ERROR, rname, " isn't attached to the tree.");
-							continue;
-						}
-						node_container->add_child(mmi, true);
-						// New MMIs must be updated
-						modified = true;
-					}
-					// If data hasn't changed since last _update_mmis, skip
-					if (modified == false) {
-						continue;
-					}
+		// Update or create MM and assign to MMI
+		mmi = cell_mmi_dict[p_cell];
+		Ref<MultiMesh> mm;
+		if (lod == Terrain3DMeshAsset::SHADOW_LOD_ID) {
+			// Reuse LOD MM as shadow impostor, its buffer is already uploaded
+			mm = shadow_impostor_source_mm;
+		} else {
+			mm = mmi->get_multimesh();
+			if (mm.is_valid() && mm->get_mesh() == p_ma->get_mesh(lod)) {
+				_set_multimesh_buffer(mm, p_cell_data.buffer);
+			} else {
+				mm = _create_multimesh(p_mesh_id, lod, p_cell_data.buffer);
+			}
+		}
+		if (mm.is_null()) {
+			continue;
+		}
+		// If LOD is shadow impostor, save it to use in shadow MMI
+		if (lod == p_ma->get_shadow_impostor()) {
+			shadow_impostor_source_mm = mm;
+		}
+		mmi->set_multimesh(mm);
+		mmi->set_cast_shadows_setting(p_ma->get_lod_cast_shadows(lod));
+		_setup_mmi_lod_ranges(mmi, p_ma, lod);
+		// Set even if null, as MMIs are updated in place by update_mmis(true)
+		mmi->set_material_override(p_ma->get_material_override());
+		mmi->set_material_overlay(p_ma->get_material_overlay());
 
-					// Create MM and assign to MMI
-					mmi = cell_mmi_dict[cell];
-					Ref<MultiMesh> mm;
-					if (lod == Terrain3DMeshAsset::SHADOW_LOD_ID) {
-						// Reuse LOD MM as shadow impostor
-						mm = shadow_impostor_source_mm;
-					} else {
-						mm = _create_multimesh(mesh_id, lod, xforms, colors);
-					}
-					if (mm.is_null()) {
-						continue;
-					}
-					// If LOD is shadow impostor, save it to use in shadow MMI
-					if (lod == ma->get_shadow_impostor()) {
-						shadow_impostor_source_mm = mm;
-					}
-					mmi->set_multimesh(mm);
-					mmi->set_cast_shadows_setting(ma->get_lod_cast_shadows(lod));
-					_setup_mmi_lod_ranges(mmi, ma, lod);
-					Ref<Material> mat = ma->get_material_override();
-					if (mat.is_valid()) {
-						mmi->set_material_override(mat);
-					}
-					mat = ma->get_material_overlay();
-					if (mat.is_valid()) {
-						mmi->set_material_overlay(mat);
-					}
+		mmi->set_global_transform(t);
 
-					// Reposition the MMI to its region location
-					Transform3D t = Transform3D();
-					int region_size = region->get_region_size();
-					real_t vertex_spacing = _terrain->get_vertex_spacing();
-					t.origin.x += region_loc.x * region_size * vertex_spacing;
-					t.origin.z += region_loc.y * region_size * vertex_spacing;
-					mmi->set_global_transform(t);
+		// Clear the cell modified state
+		p_cell_data.modified = false;
+	}
+}
 
-					// Clear the cell modified state
-					triple[2] = false;
-				}
+/** Returns true if cells of the mesh asset have an MMI or server instance for the lod.
+ * The shadow impostor lod is only drawn if the asset casts shadows from another lod, and in cast
+ * shadows only mode, lods past the last shadow lod aren't drawn.
+ */
+bool Terrain3DInstancer::_is_lod_drawn(const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod) {
+	if (p_lod > p_ma->get_last_lod()) {
+		return false;
+	}
+	if (p_lod == Terrain3DMeshAsset::SHADOW_LOD_ID) {
+		return p_ma->get_shadow_impostor() != 0 && p_ma->get_cast_shadows() != SHADOWS_OFF &&
+				p_ma->get_cast_shadows() != SHADOWS_ONLY;
+	}
+	return p_lod <= p_ma->get_last_shadow_lod() || p_ma->get_cast_shadows() != SHADOWS_ONLY;
+}
+
+// Destroys the MMIs and server instances of cells no longer drawn, as update_mmis(true) updates
+// the others in place. That includes cells of inactive regions, erased cells, and cells of mesh
+// assets that are removed, disabled or no longer have the lod.
+void Terrain3DInstancer::_destroy_stale_mmis() {
+	IS_DATA_INIT(VOID);
+	Terrain3DData *data = _terrain->get_data();
+	Ref<Terrain3DAssets> assets = _terrain->get_assets();
+	struct StaleCell {
+		Vector2i region_loc;
+		int mesh_id = 0;
+		Vector2i cell;
+	};
+	std::vector<StaleCell> stale;
+	auto check_cell = [&](const Vector2i &p_region_loc, const Vector2i &p_mesh_key, const Vector2i &p_cell) {
+		const Terrain3DRegion *region = data->has_region(p_region_loc) ? data->get_region_ptr(p_region_loc) : nullptr;
+		const InstanceData::CellMap *cells = (region && !region->is_deleted()) ? region->get_instances_ptr()->get_cells(p_mesh_key.x) : nullptr;
+		if (cells && cells->count(p_cell) > 0) {
+			Ref<Terrain3DMeshAsset> ma = assets->get_mesh_asset(p_mesh_key.x);
+			if (ma.is_valid() && ma->is_enabled() && ma->get_lod_count() > 0 && _is_lod_drawn(ma, p_mesh_key.y)) {
+				return;
+			}
+		}
+		stale.push_back({ p_region_loc, p_mesh_key.x, p_cell });
+	};
+	for (const auto &region_it : _mmi_nodes) {
+		for (const auto &mesh_it : region_it.second) {
+			for (const auto &cell_it : mesh_it.second) {
+				check_cell(region_it.first, mesh_it.first, cell_it.first);
 			}
 		}
 	}
+	for (const auto &region_it : _mmi_rids) {
+		for (const auto &mesh_it : region_it.second) {
+			for (const auto &cell_it : mesh_it.second) {
+				check_cell(region_it.first, mesh_it.first, cell_it.first);
+			}
+		}
+	}
+	// Destroys all lods of the cell, so the others are recreated when rebuilt
+	for (const StaleCell &cell : stale) {
+		_destroy_mmi_by_cell(cell.region_loc, cell.mesh_id, cell.cell);
+	}
+	LOG(DEBUG, "Destroyed ", int(stale.size()), " stale MMIs");
 }
 
-void Terrain3DInstancer::_setup_mmi_lod_ranges(MultiMeshInstance3D *p_mmi, const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod) {
-	if (!p_mmi || p_ma.is_null()) {
+// Queues all cells for _process_rebuilds(), replacing any queued before. Cells are marked modified,
+// so their existing MMIs are updated when rebuilt.
+void Terrain3DInstancer::_queue_rebuilds() {
+	IS_DATA_INIT(VOID);
+	Terrain3DData *data = _terrain->get_data();
+	real_t vertex_spacing = _terrain->get_vertex_spacing();
+	Vector3 cam_pos = _terrain->get_snapped_position();
+	Vector2 cam_pos_2d = Vector2(cam_pos.x, cam_pos.z);
+	_rebuilds.clear();
+
+	Array region_locations = data->get_region_locations();
+	for (int r = 0; r < region_locations.size(); r++) {
+		Vector2i region_loc = region_locations[r];
+		Terrain3DRegion *region = data->get_region_ptr(region_loc);
+		if (!region) {
+			continue;
+		}
+		real_t region_width = region->get_region_size() * vertex_spacing;
+		Vector2 region_offset = Vector2(region_loc) * region_width;
+		InstanceData *instances = region->get_instances_ptr();
+		for (const int mesh_id : instances->get_mesh_ids()) {
+			if (_get_drawable_mesh_asset(mesh_id).is_null()) {
+				continue;
+			}
+			for (auto &cell_it : *instances->get_cells(mesh_id)) {
+				cell_it.second.modified = true;
+				QueuedCell queued;
+				queued.region_loc = region_loc;
+				queued.mesh_id = mesh_id;
+				queued.cell = cell_it.first;
+				Vector2 center = region_offset + (Vector2(cell_it.first) + Vector2(.5f, .5f)) * CELL_SIZE * vertex_spacing;
+				queued.distance = center.distance_squared_to(cam_pos_2d);
+				_rebuilds.push_back(queued);
+			}
+		}
+	}
+	std::sort(_rebuilds.begin(), _rebuilds.end(), [](const QueuedCell &a, const QueuedCell &b) {
+		return a.distance > b.distance;
+	});
+	LOG(INFO, "Queued ", int(_rebuilds.size()), " cells to rebuild, ", _rebuild_cells_per_frame, " per frame");
+	if (_rebuilds.empty()) {
+		emit_signal("rebuild_finished");
+	}
+}
+
+/** Rebuilds the MMIs of the cells queued by _queue_rebuilds(). Called every physics frame by Terrain3D.
+ * Up to rebuild_cells_per_frame cells are rebuilt, nearest to the camera first. Cells that were
+ * removed or already rebuilt by _update_mmis() since being queued are skipped.
+ *	p_blocking - rebuild all queued cells at once
+ */
+void Terrain3DInstancer::_process_rebuilds(const bool p_blocking) {
+	if (_rebuilds.empty()) {
 		return;
 	}
+	IS_DATA_INIT(VOID);
+	const bool server_mode = is_server_mode();
+	if (server_mode && !_terrain->is_inside_tree()) {
+		return;
+	}
+	Terrain3DData *data = _terrain->get_data();
+	int rebuilt = 0;
+	while (!_rebuilds.empty() && (p_blocking || rebuilt < _rebuild_cells_per_frame)) {
+		const QueuedCell queued = _rebuilds.back();
+		_rebuilds.pop_back();
+		Terrain3DRegion *region = data->get_region_ptr(queued.region_loc);
+		if (!region) {
+			continue;
+		}
+		InstanceData::CellMap *cells = region->get_instances_ptr()->get_cells(queued.mesh_id);
+		if (!cells) {
+			continue;
+		}
+		auto it = cells->find(queued.cell);
+		if (it == cells->end()) {
+			continue;
+		}
+		Ref<Terrain3DMeshAsset> ma = _get_drawable_mesh_asset(queued.mesh_id);
+		if (ma.is_null()) {
+			continue;
+		}
+		_update_cell_mmis(region, queued.mesh_id, ma, queued.cell, it->second, server_mode);
+		rebuilt++;
+	}
+	LOG(DEBUG, "Rebuilt ", rebuilt, " cells, ", int(_rebuilds.size()), " remaining");
+	if (_rebuilds.empty()) {
+		LOG(INFO, "Finished rebuilding queued cells");
+		emit_signal("rebuild_finished");
+	}
+}
+
+// Creates or updates the multimesh and instance RIDs of one cell and lod in server mode.
+// Returns the multimesh RID, for use by the shadow impostor.
+RID Terrain3DInstancer::_update_cell_rids(const Vector2i &p_region_loc, const Vector2i &p_mesh_key, const Vector2i &p_cell,
+		const InstanceData::Cell &p_cell_data, const Ref<Terrain3DMeshAsset> &p_ma, const Transform3D &p_xform,
+		const RID &p_shadow_mm, bool p_modified) {
+	const int lod = p_mesh_key.y;
+	CellRIDDict &cell_rid_dict = _mmi_rids[p_region_loc][p_mesh_key];
+	CellRIDs &rids = cell_rid_dict[p_cell];
+	if (!rids.instance.is_valid()) {
+		if (lod == Terrain3DMeshAsset::SHADOW_LOD_ID) {
+			rids.multimesh = p_shadow_mm;
+			rids.owns_multimesh = false;
+		} else {
+			rids.multimesh = RS->multimesh_create();
+			rids.owns_multimesh = true;
+		}
+		rids.instance = RS->instance_create2(rids.multimesh, _terrain->get_world_3d()->get_scenario());
+		RS->instance_set_visible(rids.instance, _terrain->is_visible_in_tree() && _terrain->get_show_instances());
+		LOG(EXTREME, "Created instance RID ", rids.instance, " for region ", p_region_loc, " mesh ", p_mesh_key, " cell ", p_cell);
+		// New instances must be updated
+		p_modified = true;
+	}
+	// If data hasn't changed since last _update_mmis, skip
+	if (!p_modified) {
+		return rids.multimesh;
+	}
+
+	if (lod == Terrain3DMeshAsset::SHADOW_LOD_ID) {
+		// Reuse LOD MM as shadow impostor, its buffer is already uploaded
+		if (rids.multimesh != p_shadow_mm) {
+			rids.multimesh = p_shadow_mm;
+			RS->instance_set_base(rids.instance, rids.multimesh);
+		}
+	} else {
+		Ref<Mesh> mesh = p_ma->get_mesh(lod);
+		if (mesh.is_null()) {
+			LOG(ERROR, "No LOD ", lod, " for mesh id ", p_mesh_key.x, " found");
+			return RID();
+		}
+		RS->multimesh_set_mesh(rids.multimesh, mesh->get_rid());
+		const int count = p_cell_data.get_count();
+		if (RS->multimesh_get_instance_count(rids.multimesh) != count) {
+			RS->multimesh_allocate_data(rids.multimesh, count, RenderingServer::MULTIMESH_TRANSFORM_3D, true);
+		}
+		RS->multimesh_set_buffer(rids.multimesh, p_cell_data.buffer);
+	}
+	RS->instance_set_transform(rids.instance, p_xform);
+	RS->instance_geometry_set_cast_shadows_setting(rids.instance,
+			RenderingServer::ShadowCastingSetting(p_ma->get_lod_cast_shadows(lod)));
+	LODRange range = _get_lod_range(p_ma, lod);
+	RS->instance_geometry_set_visibility_range(rids.instance, range.begin, range.end, range.begin_margin,
+			range.end_margin, range.fade ? RenderingServer::VISIBILITY_RANGE_FADE_SELF : RenderingServer::VISIBILITY_RANGE_FADE_DISABLED);
+	Ref<Material> mat = p_ma->get_material_override();
+	RS->instance_geometry_set_material_override(rids.instance, mat.is_valid() ? mat->get_rid() : RID());
+	mat = p_ma->get_material_overlay();
+	RS->instance_geometry_set_material_overlay(rids.instance, mat.is_valid() ? mat->get_rid() : RID());
+	return rids.multimesh;
+}
+
+// Matches the scenario and visibility of the server mode instances to the terrain
+void Terrain3DInstancer::_update_server_instances() {
+	if (!_terrain || _mmi_rids.empty()) {
+		return;
+	}
+	RID scenario;
+	if (_terrain->is_inside_tree()) {
+		scenario = _terrain->get_world_3d()->get_scenario();
+	}
+	bool visible = _terrain->is_visible_in_tree() && _terrain->get_show_instances();
+	LOG(INFO, "Updating server instances, visible: ", visible);
+	for (auto &region : _mmi_rids) {
+		for (auto &mesh : region.second) {
+			for (auto &cell : mesh.second) {
+				if (scenario.is_valid()) {
+					RS->instance_set_scenario(cell.second.instance, scenario);
+				}
+				RS->instance_set_visible(cell.second.instance, visible);
+			}
+		}
+	}
+}
+
+Terrain3DInstancer::LODRange Terrain3DInstancer::_get_lod_range(const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod) {
+	LODRange range;
 	real_t margin = p_ma->get_fade_margin();
 	if (margin > 0.f) {
 		real_t lod_begin = p_ma->get_lod_range_begin(p_lod);
 		lod_begin = MAX(lod_begin < 0.001f ? 0.f : lod_begin - margin, 0.f);
 		real_t lod_end = p_ma->get_lod_range_end(p_lod);
 		lod_end = MAX(lod_end < 0.001f ? 0.f : lod_end + margin, 0.f);
-		p_mmi->set_visibility_range_begin(lod_begin);
-		p_mmi->set_visibility_range_end(lod_end);
-		p_mmi->set_visibility_range_begin_margin(lod_begin < 0.001f ? 0.f : margin);
-		p_mmi->set_visibility_range_end_margin(lod_end < 0.001f ? 0.f : margin);
-		p_mmi->set_visibility_range_fade_mode(GeometryInstance3D::VISIBILITY_RANGE_FADE_SELF);
+		range.begin = lod_begin;
+		range.end = lod_end;
+		range.begin_margin = lod_begin < 0.001f ? 0.f : margin;
+		range.end_margin = lod_end < 0.001f ? 0.f : margin;
+		range.fade = true;
 	} else {
-		p_mmi->set_visibility_range_begin(p_ma->get_lod_range_begin(p_lod));
-		p_mmi->set_visibility_range_end(p_ma->get_lod_range_end(p_lod) * 1.0005f);
+		range.begin = p_ma->get_lod_range_begin(p_lod);
+		range.end = p_ma->get_lod_range_end(p_lod) * 1.0005f;
+	}
+	return range;
+}
+
+void Terrain3DInstancer::_setup_mmi_lod_ranges(MultiMeshInstance3D *p_mmi, const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod) {
+	if (!p_mmi || p_ma.is_null()) {
+		return;
+	}
+	LODRange range = _get_lod_range(p_ma, p_lod);
+	p_mmi->set_visibility_range_begin(range.begin);
+	p_mmi->set_visibility_range_end(range.end);
+	if (range.fade) {
+		p_mmi->set_visibility_range_begin_margin(range.begin_margin);
+		p_mmi->set_visibility_range_end_margin(range.end_margin);
+		p_mmi->set_visibility_range_fade_mode(GeometryInstance3D::VISIBILITY_RANGE_FADE_SELF);
 	}
 }
 
@@ -217,30 +488,20 @@ void Terrain3DInstancer::_update_vertex_spacing(const real_t p_vertex_spacing) {
 		}
 
 		// For all mesh_ids in region
-		Dictionary mesh_inst_dict = region->get_instances();
+		InstanceData *instances = region->get_instances_ptr();
 		LOG(DEBUG, "Updating MMIs from: ", region_loc);
-		Array mesh_types = mesh_inst_dict.keys();
-		for (int m = 0; m < mesh_types.size(); m++) {
-			int mesh_id = mesh_types[m];
-			Dictionary cell_inst_dict = mesh_inst_dict[mesh_id];
-			Array cell_locations = cell_inst_dict.keys();
-			for (int c = 0; c < cell_locations.size(); c++) {
-				// Get instances
-				Vector2i cell = cell_locations[c];
-				Array triple = cell_inst_dict[cell];
-				TypedArray<Transform3D> xforms = triple[0];
-				// Descale, then Scale to the new value
-				for (int i = 0; i < xforms.size(); i++) {
-					Transform3D t = xforms[i];
-					t.origin.x /= old_spacing;
-					t.origin.x *= p_vertex_spacing;
-					t.origin.z /= old_spacing;
-					t.origin.z *= p_vertex_spacing;
-					xforms[i] = t;
+		for (const int mesh_id : instances->get_mesh_ids()) {
+			for (auto &cell_it : *instances->get_cells(mesh_id)) {
+				InstanceData::Cell &cell_data = cell_it.second;
+				const int count = cell_data.get_count();
+				float *buffer = cell_data.buffer.ptrw();
+				// Descale, then Scale to the new value. Origin x and z follow the first and last basis rows
+				for (int i = 0; i < count; i++) {
+					float *instance = buffer + i * InstanceData::STRIDE;
+					instance[3] = instance[3] / old_spacing * p_vertex_spacing;
+					instance[11] = instance[11] / old_spacing * p_vertex_spacing;
 				}
-				triple[0] = xforms;
-				triple[2] = true;
-				cell_inst_dict[cell] = triple;
+				cell_data.modified = true;
 			}
 		}
 		// After all transforms are updated, set the new region vertex spacing value
@@ -252,6 +513,34 @@ void Terrain3DInstancer::_update_vertex_spacing(const real_t p_vertex_spacing) {
 }
 
 void Terrain3DInstancer::_destroy_mmi_by_cell(const Vector2i &p_region_loc, const int p_mesh_id, const Vector2i p_cell) {
+	// Free server mode RIDs, shadow lod first as it shares the multimesh of another lod
+	if (_mmi_rids.count(p_region_loc) > 0) {
+		MeshRIDDict &mesh_rid_dict = _mmi_rids[p_region_loc];
+		for (int lod = Terrain3DMeshAsset::SHADOW_LOD_ID; lod < Terrain3DMeshAsset::MAX_LOD_COUNT; lod++) {
+			Vector2i mesh_key(p_mesh_id, lod);
+			auto mesh_it = mesh_rid_dict.find(mesh_key);
+			if (mesh_it == mesh_rid_dict.end()) {
+				continue;
+			}
+			auto cell_it = mesh_it->second.find(p_cell);
+			if (cell_it == mesh_it->second.end()) {
+				continue;
+			}
+			LOG(EXTREME, "Freeing instance RID ", cell_it->second.instance, " and erasing cell ", p_cell);
+			RS->free_rid(cell_it->second.instance);
+			if (cell_it->second.owns_multimesh) {
+				RS->free_rid(cell_it->second.multimesh);
+			}
+			mesh_it->second.erase(cell_it);
+			if (mesh_it->second.empty()) {
+				mesh_rid_dict.erase(mesh_it);
+			}
+		}
+		if (mesh_rid_dict.empty()) {
+			_mmi_rids.erase(p_region_loc);
+		}
+	}
+
 	if (_mmi_nodes.count(p_region_loc) == 0) {
 		return;
 	}
@@ -297,27 +586,53 @@ void Terrain3DInstancer::_destroy_mmi_by_cell(const Vector2i &p_region_loc, cons
 
 void Terrain3DInstancer::_destroy_mmi_by_location(const Vector2i &p_region_loc, const int p_mesh_id) {
 	LOG(DEBUG, "Deleting all MMIs in region: ", p_region_loc, " for mesh_id: ", p_mesh_id);
-	if (_mmi_nodes.count(p_region_loc) == 0) {
+	if (_mmi_nodes.count(p_region_loc) == 0 && _mmi_rids.count(p_region_loc) == 0) {
 		return;
 	}
-	MeshMMIDict &mesh_mmi_dict = _mmi_nodes[p_region_loc];
 
+	// Iterate over keys as functions will invalidate standard iterator
+	std::vector<Vector2i> keys;
 	for (int lod = Terrain3DMeshAsset::SHADOW_LOD_ID; lod < Terrain3DMeshAsset::MAX_LOD_COUNT; lod++) {
 		Vector2i mesh_key(p_mesh_id, lod);
-		CellMMIDict &cell_mmi_dict = mesh_mmi_dict[mesh_key];
+		if (_mmi_nodes.count(p_region_loc) > 0 && _mmi_nodes[p_region_loc].count(mesh_key) > 0) {
+			for (auto &it : _mmi_nodes[p_region_loc][mesh_key]) {
+				keys.push_back(it.first);
+			}
+		}
+		if (_mmi_rids.count(p_region_loc) > 0 && _mmi_rids[p_region_loc].count(mesh_key) > 0) {
+			for (auto &it : _mmi_rids[p_region_loc][mesh_key]) {
+				keys.push_back(it.first);
+			}
+		}
+	}
+	for (auto &cell : keys) {
+		_destroy_mmi_by_cell(p_region_loc, p_mesh_id, cell);
+	}
+}
 
-		// Iterate over keys as functions will invalidate standard iterator
-		std::vector<Vector2i> keys;
-		keys.reserve(cell_mmi_dict.size());
-		int i = 0;
-		for (auto &it : cell_mmi_dict) {
-			keys.push_back(it.first);
-			i++;
+// Frees all server mode RIDs. Instances first, as shadow lods share the multimeshes of other lods.
+void Terrain3DInstancer::_destroy_rids() {
+	if (_mmi_rids.empty()) {
+		return;
+	}
+	LOG(INFO, "Freeing all server instances");
+	for (auto &region : _mmi_rids) {
+		for (auto &mesh : region.second) {
+			for (auto &cell : mesh.second) {
+				RS->free_rid(cell.second.instance);
+			}
 		}
-		for (auto &cell : keys) {
-			_destroy_mmi_by_cell(p_region_loc, p_mesh_id, cell);
+	}
+	for (auto &region : _mmi_rids) {
+		for (auto &mesh : region.second) {
+			for (auto &cell : mesh.second) {
+				if (cell.second.owns_multimesh) {
+					RS->free_rid(cell.second.multimesh);
+				}
+			}
 		}
 	}
+	_mmi_rids.clear();
 }
 
 void Terrain3DInstancer::_backup_regionl(const Vector2i &p_region_loc) {
@@ -335,7 +650,17 @@ void Terrain3DInstancer::_backup_region(const Ref<Terrain3DRegion> &p_region) {
 	}
 }
 
-Ref<MultiMesh> Terrain3DInstancer::_create_multimesh(const int p_mesh_id, const int p_lod, const TypedArray<Transform3D> &p_xforms, const PackedColorArray &p_colors) const {
+// Saves one cell for undo, before it's first changed in an editor operation
+void Terrain3DInstancer::_backup_cell(Terrain3DRegion *p_region, const int p_mesh_id, const Vector2i &p_cell) {
+	if (_terrain && _terrain->get_editor()) {
+		_terrain->get_editor()->backup_instance_cell(Ref<Terrain3DRegion>(p_region), p_mesh_id, p_cell);
+	} else {
+		p_region->set_modified(true);
+	}
+}
+
+// Creates a MultiMesh of the instances in p_buffer, in the layout of InstanceData::Cell::buffer
+Ref<MultiMesh> Terrain3DInstancer::_create_multimesh(const int p_mesh_id, const int p_lod, const PackedFloat32Array &p_buffer) const {
 	Ref<MultiMesh> mm;
 	IS_INIT(mm);
 	Ref<Terrain3DMeshAsset> mesh_asset = _terrain->get_assets()->get_mesh_asset(p_mesh_id);
@@ -352,18 +677,22 @@ Ref<MultiMesh> Terrain3DInstancer::_create_multimesh(const int p_mesh_id, const
 	mm->set_transform_format(MultiMesh::TRANSFORM_3D);
 	mm->set_use_colors(true);
 	mm->set_mesh(mesh);
-	if (p_xforms.size() > 0) {
-		mm->set_instance_count(p_xforms.size());
-		for (int i = 0; i < p_xforms.size(); i++) {
-			mm->set_instance_transform(i, p_xforms[i]);
-			if (i < p_colors.size()) {
-				mm->set_instance_color(i, p_colors[i]);
-			}
-		}
-	}
+	_set_multimesh_buffer(mm, p_buffer);
 	return mm;
 }
 
+// Uploads the instances to a MultiMesh created by _create_multimesh(). The buffer is already in
+// the layout of the RenderingServer, so it's copied in one call rather than per instance.
+void Terrain3DInstancer::_set_multimesh_buffer(const Ref<MultiMesh> &p_mm, const PackedFloat32Array &p_buffer) {
+	const int count = p_buffer.size() / InstanceData::STRIDE;
+	if (p_mm->get_instance_count() != count) {
+		p_mm->set_instance_count(count);
+	}
+	if (count > 0) {
+		RS->multimesh_set_buffer(p_mm->get_rid(), p_buffer);
+	}
+}
+
 Vector2i Terrain3DInstancer::_get_cell(const Vector3 &p_global_position, const int p_region_size) {
 	real_t vertex_spacing = _terrain->get_vertex_spacing();
 	Vector2i cell;
@@ -372,6 +701,55 @@ Vector2i Terrain3DInstancer::_get_cell(const Vector3 &p_global_position, const i
 	return cell;
 }
 
+// Returns the locations of the regions overlapping p_rect, an area in global XZ
+std::vector<Vector2i> Terrain3DInstancer::_get_regions_in_rect(const Rect2 &p_rect) const {
+	std::vector<Vector2i> region_locs;
+	const Terrain3DData *data = _terrain->get_data();
+	Vector2i start = data->get_region_location(Vector3(p_rect.position.x, 0.f, p_rect.position.y));
+	Vector2i end = data->get_region_location(Vector3(p_rect.get_end().x, 0.f, p_rect.get_end().y));
+	for (int y = start.y; y <= end.y; y++) {
+		for (int x = start.x; x <= end.x; x++) {
+			if (data->has_region(Vector2i(x, y))) {
+				region_locs.push_back(Vector2i(x, y));
+			}
+		}
+	}
+	return region_locs;
+}
+
+// Returns the cells in p_cells overlapping p_rect, an area in region space. The cell range covered
+// by the rect is looked up in the CellMap, unless the region has fewer cells than that.
+std::vector<Vector2i> Terrain3DInstancer::_get_cells_in_rect(const InstanceData::CellMap &p_cells, const Rect2 &p_rect, const int p_region_size) const {
+	std::vector<Vector2i> cells;
+	real_t cell_width = CELL_SIZE * _terrain->get_vertex_spacing();
+	int last_cell = MAX(p_region_size / CELL_SIZE - 1, 0);
+	Vector2i start = Vector2i((p_rect.position / cell_width).floor());
+	Vector2i end = Vector2i((p_rect.get_end() / cell_width).floor());
+	if (end.x < 0 || end.y < 0 || start.x > last_cell || start.y > last_cell) {
+		return cells;
+	}
+	start = start.clamp(V2I_ZERO, Vector2i(last_cell, last_cell));
+	end = end.clamp(V2I_ZERO, Vector2i(last_cell, last_cell));
+	int64_t range = int64_t(end.x - start.x + 1) * int64_t(end.y - start.y + 1);
+	if (range > int64_t(p_cells.size())) {
+		for (const auto &it : p_cells) {
+			const Vector2i &cell = it.first;
+			if (cell.x >= start.x && cell.x <= end.x && cell.y >= start.y && cell.y <= end.y) {
+				cells.push_back(cell);
+			}
+		}
+	} else {
+		for (int y = start.y; y <= end.y; y++) {
+			for (int x = start.x; x <= end.x; x++) {
+				if (p_cells.count(Vector2i(x, y)) > 0) {
+					cells.push_back(Vector2i(x, y));
+				}
+			}
+		}
+	}
+	return cells;
+}
+
 ///////////////////////////
 // Public Functions
 ///////////////////////////
@@ -386,6 +764,7 @@ void Terrain3DInstancer::initialize(Terrain3D *p_terrain) {
 }
 
 void Terrain3DInstancer::destroy() {
+	_destroy_rids();
 	IS_DATA_INIT(VOID);
 	LOG(INFO, "Destroying all MMIs");
 
@@ -405,6 +784,29 @@ void Terrain3DInstancer::destroy() {
 	}
 }
 
+void Terrain3DInstancer::set_mode(const InstancerMode p_mode) {
+	LOG(INFO, "Setting instancer mode: ", p_mode);
+	if (p_mode != _mode) {
+		destroy();
+		_mode = p_mode;
+		_update_mmis();
+	}
+}
+
+// Sets the cells update_mmis(true) rebuilds per frame. 0 rebuilds them all at once.
+void Terrain3DInstancer::set_rebuild_cells_per_frame(const int p_cells) {
+	_rebuild_cells_per_frame = MAX(p_cells, 0);
+	LOG(INFO, "Setting rebuild cells per frame: ", _rebuild_cells_per_frame);
+	if (_rebuild_cells_per_frame == 0) {
+		_process_rebuilds(true);
+	}
+}
+
+// Returns true if instances are drawn with RenderingServer instances rather than MMI nodes
+bool Terrain3DInstancer::is_server_mode() const {
+	return _mode == SERVER_EDITOR || (_mode == SERVER_GAME && !IS_EDITOR);
+}
+
 void Terrain3DInstancer::clear_by_mesh(const int p_mesh_id) {
 	LOG(INFO, "Deleting Multimeshes in all regions with mesh_id: ", p_mesh_id);
 	Array region_locations = _terrain->get_data()->get_region_locations();
@@ -426,10 +828,10 @@ void Terrain3DInstancer::clear_by_region(const Ref<Terrain3DRegion> &p_region, c
 	}
 	Vector2i region_loc = p_region->get_location();
 	LOG(INFO, "Deleting Multimeshes w/ mesh_id: ", p_mesh_id, " in region: ", region_loc);
-	Dictionary mesh_inst_dict = p_region->get_instances();
-	if (mesh_inst_dict.has(p_mesh_id)) {
+	InstanceData *instances = p_region->get_instances_ptr();
+	if (instances->has_mesh(p_mesh_id)) {
 		_backup_region(p_region);
-		mesh_inst_dict.erase(p_mesh_id);
+		instances->erase_mesh(p_mesh_id);
 	}
 	_destroy_mmi_by_location(region_loc, p_mesh_id);
 }
@@ -568,112 +970,80 @@ void Terrain3DInstancer::remove_instances(const Vector3 &p_global_position, cons
 	int region_size = _terrain->get_region_size();
 	real_t vertex_spacing = _terrain->get_vertex_spacing();
 
-	// Build list of potential regions to search, rather than searching the entire terrain, calculate possible regions covered
-	// and check if they are valid; if so add that location to the dictionary keys.
-	Dictionary r_locs;
-	// Calculate step distance to ensure every region is checked inside the bounds of brush size.
-	real_t step = brush_size / ceil(brush_size / real_t(region_size) / vertex_spacing);
-	for (real_t x = p_global_position.x - half_brush_size; x <= p_global_position.x + half_brush_size; x += step) {
-		for (real_t z = p_global_position.z - half_brush_size; z <= p_global_position.z + half_brush_size; z += step) {
-			Vector2i region_loc = data->get_region_location(Vector3(x, 0.f, z));
-			if (data->has_region(region_loc)) {
-				r_locs[region_loc] = 1;
-			}
-		}
-	}
-
-	Array region_queue = r_locs.keys();
-	if (region_queue.size() == 0) {
-		return;
-	}
-
-	for (int r = 0; r < region_queue.size(); r++) {
-		Vector2i region_loc = region_queue[r];
+	// Only search the regions and cells covered by the brush
+	Rect2 brush_rect = Rect2(p_global_position.x - half_brush_size, p_global_position.z - half_brush_size,
+			2.f * half_brush_size, 2.f * half_brush_size);
+	for (const Vector2i &region_loc : _get_regions_in_rect(brush_rect)) {
 		Terrain3DRegion *region = data->get_region_ptr(region_loc);
 		if (!region) {
 			LOG(WARN, "Errant null region found at: ", region_loc);
 			continue;
 		}
 
-		Dictionary mesh_inst_dict = region->get_instances();
-		Array mesh_types = mesh_inst_dict.keys();
-		if (mesh_types.size() == 0) {
+		InstanceData *instances = region->get_instances_ptr();
+		if (instances->is_empty()) {
 			continue;
 		}
 		Vector3 global_local_offset = Vector3(region_loc.x * region_size * vertex_spacing, 0.f, region_loc.y * region_size * vertex_spacing);
 		Vector2 localised_ring_center = Vector2(p_global_position.x - global_local_offset.x, p_global_position.z - global_local_offset.z);
+		Rect2 local_rect = Rect2(brush_rect.position - Vector2(global_local_offset.x, global_local_offset.z), brush_rect.size);
 		// For this mesh id, or all mesh ids
 		for (int m = (modifier_shift ? 0 : mesh_id); m <= (modifier_shift ? mesh_count - 1 : mesh_id); m++) {
 			// Ensure this region has this mesh
-			if (!mesh_inst_dict.has(m)) {
-				continue;
-			}
-			Dictionary cell_inst_dict = mesh_inst_dict[m];
-			Array cell_locations = cell_inst_dict.keys();
-			// This shouldnt be empty
-			if (cell_locations.size() == 0) {
-				LOG(WARN, "Region at: ", region_loc, " has instance dictionary for mesh id: ", m, " but has no cells.")
+			InstanceData::CellMap *cells = instances->get_cells(m);
+			if (!cells) {
 				continue;
 			}
-			// Check potential cells rather than searching the entire region, whilst marginally
-			// slower if there are very few cells for the given mesh present. It is significantly
-			// faster when a large number of cells are present.
-			Dictionary c_locs;
-			// Calculate step distance to ensure every cell is checked inside the bounds of brush size.
-			real_t cell_step = brush_size / ceil(brush_size / real_t(CELL_SIZE) / vertex_spacing);
-			for (real_t x = p_global_position.x - half_brush_size; x <= p_global_position.x + half_brush_size; x += cell_step) {
-				for (real_t z = p_global_position.z - half_brush_size; z <= p_global_position.z + half_brush_size; z += cell_step) {
-					Vector3 cell_pos = Vector3(x, 0.f, z) - global_local_offset;
-					// Manually calculate cell pos without modulus, locations not in the current region will not be found.
-					Vector2i cell_loc;
-					cell_loc.x = UtilityFunctions::floori(cell_pos.x / vertex_spacing) / CELL_SIZE;
-					cell_loc.y = UtilityFunctions::floori(cell_pos.z / vertex_spacing) / CELL_SIZE;
-					if (cell_locations.has(cell_loc)) {
-						c_locs[cell_loc] = 1;
-					}
-				}
-			}
-			Array cell_queue = c_locs.keys();
-			if (cell_queue.size() == 0) {
+			std::vector<Vector2i> cell_queue = _get_cells_in_rect(*cells, local_rect, region_size);
+			if (cell_queue.empty()) {
 				continue;
 			}
 			Ref<Terrain3DMeshAsset> mesh_asset = _terrain->get_assets()->get_mesh_asset(m);
 			real_t mesh_height_offset = mesh_asset->get_height_offset();
-			for (int c = 0; c < cell_queue.size(); c++) {
-				Vector2i cell = cell_queue[c];
-				Array triple = cell_inst_dict[cell];
-				TypedArray<Transform3D> xforms = triple[0];
-				PackedColorArray colors = triple[1];
-				TypedArray<Transform3D> updated_xforms;
-				PackedColorArray updated_colors;
-				// Remove transforms if inside ring radius
-				for (int i = 0; i < xforms.size(); i++) {
-					Transform3D t = xforms[i];
+			std::vector<Vector2i> emptied_cells;
+			std::vector<int> kept;
+			for (const Vector2i &cell : cell_queue) {
+				InstanceData::Cell &cell_data = (*cells)[cell];
+				const int count = cell_data.get_count();
+				const float *src = cell_data.buffer.ptr();
+				kept.clear();
+				// Remove transforms if inside ring radius. Read the origin first, and the rest only if close enough.
+				for (int i = 0; i < count; i++) {
+					const float *instance = src + i * InstanceData::STRIDE;
 					// Use localised ring center
-					real_t radial_distance = localised_ring_center.distance_to(Vector2(t.origin.x, t.origin.z));
-					Vector3 height_offset = t.basis.get_column(1) * mesh_height_offset;
+					real_t radial_distance = localised_ring_center.distance_to(Vector2(instance[3], instance[11]));
 					if (radial_distance < radius &&
-							UtilityFunctions::randf() < CLAMP(0.175f * strength, 0.005f, 10.f) &&
-							data->is_in_slope(t.origin + global_local_offset - height_offset, slope_range, invert)) {
-						_backup_region(region);
-						continue;
-					} else {
-						updated_xforms.push_back(t);
-						updated_colors.push_back(colors[i]);
+							UtilityFunctions::randf() < CLAMP(0.175f * strength, 0.005f, 10.f)) {
+						Transform3D t = InstanceData::read_transform(instance);
+						Vector3 height_offset = t.basis.get_column(1) * mesh_height_offset;
+						if (data->is_in_slope(t.origin + global_local_offset - height_offset, slope_range, invert)) {
+							continue;
+						}
 					}
+					kept.push_back(i);
 				}
-				if (updated_xforms.size() > 0) {
-					triple[0] = updated_xforms;
-					triple[1] = updated_colors;
-					triple[2] = true;
-					cell_inst_dict[cell] = triple;
-				} else {
-					cell_inst_dict.erase(cell);
+				if (int(kept.size()) == count) {
+					continue;
+				}
+				_backup_cell(region, m, cell);
+				if (kept.empty()) {
+					emptied_cells.push_back(cell);
 					_destroy_mmi_by_cell(region_loc, m, cell);
+					continue;
 				}
+				// The backup shares the old buffer, so write a new one
+				PackedFloat32Array buffer;
+				buffer.resize(int64_t(kept.size()) * InstanceData::STRIDE);
+				float *dst = buffer.ptrw();
+				for (size_t k = 0; k < kept.size(); k++) {
+					memcpy(dst + k * InstanceData::STRIDE, src + kept[k] * InstanceData::STRIDE, InstanceData::STRIDE * sizeof(float));
+				}
+				cell_data.buffer = buffer;
+				cell_data.modified = true;
 			}
-			if (cell_inst_dict.is_empty()) {
-				mesh_inst_dict.erase(m);
+			// Erasing the last cell also erases the mesh, and invalidates cells
+			for (const Vector2i &cell : emptied_cells) {
+				instances->erase_cell(m, cell);
 			}
 		}
 		_update_mmis(region_loc);
@@ -781,39 +1151,15 @@ void Terrain3DInstancer::append_region(const Ref<Terrain3DRegion> &p_region, con
 
 	_backup_region(p_region);
 
-	Dictionary cell_locations = p_region->get_instances()[p_mesh_id];
+	InstanceData *instances = p_region->get_instances_ptr();
 	int region_size = p_region->get_region_size();
 
 	for (int i = 0; i < p_xforms.size(); i++) {
 		Transform3D xform = p_xforms[i];
-		Color col = p_colors[i];
-		Vector2i cell = _get_cell(xform.origin, region_size);
-
-		// Get current instance arrays or create if none
-		Array triple = cell_locations[cell];
-		bool modified = true;
-		if (triple.size() != 3) {
-			LOG(DEBUG, "No data at ", p_region->get_location(), ":", cell, ". Creating triple");
-			triple.resize(3);
-			triple[0] = TypedArray<Transform3D>();
-			triple[1] = PackedColorArray();
-			triple[2] = modified;
-		}
-		TypedArray<Transform3D> xforms = triple[0];
-		PackedColorArray colors = triple[1];
-		xforms.push_back(xform);
-		colors.push_back(col);
-
-		// Must write back since there are copy constructors somewhere
-		// see godot-cpp#1149
-		triple[0] = xforms;
-		triple[1] = colors;
-		triple[2] = modified;
-		cell_locations[cell] = triple;
+		Color col = (i < p_colors.size()) ? p_colors[i] : COLOR_WHITE;
+		instances->append(p_mesh_id, _get_cell(xform.origin, region_size), xform, col);
 	}
 
-	// Write back dictionary. See above comments
-	p_region->get_instances()[p_mesh_id] = cell_locations;
 	if (p_update) {
 		_update_mmis(p_region->get_location(), p_mesh_id);
 	}
@@ -831,113 +1177,150 @@ void Terrain3DInstancer::update_transforms(const AABB &p_aabb) {
 		return;
 	}
 
-	Terrain3DData *data = _terrain->get_data();
 	int region_size = _terrain->get_region_size();
 	real_t vertex_spacing = _terrain->get_vertex_spacing();
 
-	// Build list of valid regions within AABB; add the locations as dictionary keys.
-	Dictionary r_locs;
-	// Calculate step distance to ensure every region is checked inside the bounds of AABB size.
-	Vector2 step = Vector2(size.x / ceil(size.x / real_t(region_size) / vertex_spacing), size.y / ceil(size.y / real_t(region_size) / vertex_spacing));
-	for (real_t x = global_position.x - half_size.x; x <= global_position.x + half_size.x; x += step.x) {
-		for (real_t z = global_position.y - half_size.y; z <= global_position.y + half_size.y; z += step.y) {
-			Vector2i region_loc = data->get_region_location(Vector3(x, 0.f, z));
-			if (data->has_region(region_loc)) {
-				r_locs[region_loc] = 0;
-			}
+	// Only search the regions and cells within the AABB
+	Rect2 search_rect = Rect2(global_position - half_size, 2.f * half_size);
+	for (const Vector2i &region_loc : _get_regions_in_rect(search_rect)) {
+		Terrain3DRegion *region = _terrain->get_data()->get_region_ptr(region_loc);
+		if (!region) {
+			continue;
 		}
-	}
-
-	Array region_queue = r_locs.keys();
-	if (region_queue.size() == 0) {
-		return;
-	}
-
-	for (int r = 0; r < region_queue.size(); r++) {
-		Vector2i region_loc = region_queue[r];
-		Ref<Terrain3DRegion> region = _terrain->get_data()->get_region(region_loc);
-		_backup_region(region);
-
-		Dictionary mesh_inst_dict = region->get_instances();
-		Array mesh_types = mesh_inst_dict.keys();
-		if (mesh_types.size() == 0) {
+		InstanceData *instances = region->get_instances_ptr();
+		if (instances->is_empty()) {
 			continue;
 		}
 		Vector3 global_local_offset = Vector3(region_loc.x * region_size * vertex_spacing, 0.f, region_loc.y * region_size * vertex_spacing);
-
-		// For this mesh id, or all mesh ids
-		for (int m = 0; m < mesh_types.size(); m++) {
-			// Check potential cells rather than searching the entire region, whilst marginally
-			// slower if there are very few cells for the given mesh present it is significantly
-			// faster when a very large number of cells are present.
-			int region_mesh_id = mesh_types[m];
-			Dictionary cell_inst_dict = mesh_inst_dict[region_mesh_id];
-			Array cell_locations = cell_inst_dict.keys();
-			if (cell_locations.size() == 0) {
-				continue;
-			}
-			Dictionary c_locs;
-			// Calculate step distance to ensure every cell is checked inside the bounds of brush size.
-			Vector2 cell_step = Vector2(size.x / ceil(size.x / real_t(CELL_SIZE) / vertex_spacing), size.y / ceil(size.y / real_t(CELL_SIZE) / vertex_spacing));
-			for (real_t x = global_position.x - half_size.x; x <= global_position.x + half_size.x; x += cell_step.x) {
-				for (real_t z = global_position.y - half_size.y; z <= global_position.y + half_size.y; z += cell_step.y) {
-					Vector3 cell_pos = Vector3(x, 0.f, z) - global_local_offset;
-					// Manually calculate cell pos without modulus, locations not in the current region will not be found.
-					Vector2i cell_loc;
-					cell_loc.x = UtilityFunctions::floori(cell_pos.x / vertex_spacing) / CELL_SIZE;
-					cell_loc.y = UtilityFunctions::floori(cell_pos.z / vertex_spacing) / CELL_SIZE;
-					if (cell_locations.has(cell_loc)) {
-						c_locs[cell_loc] = 0;
-					}
-				}
-			}
-			Array cell_queue = c_locs.keys();
-			if (cell_queue.size() == 0) {
+		Rect2 local_rect = Rect2(search_rect.position - Vector2(global_local_offset.x, global_local_offset.z), search_rect.size);
+		bool region_changed = false;
+
+		// For all mesh ids
+		for (const int region_mesh_id : instances->get_mesh_ids()) {
+			InstanceData::CellMap *cells = instances->get_cells(region_mesh_id);
+			std::vector<Vector2i> cell_queue = _get_cells_in_rect(*cells, local_rect, region_size);
+			if (cell_queue.empty()) {
 				continue;
 			}
-			Ref<Terrain3DMeshAsset> mesh_asset = _terrain->get_assets()->get_mesh_asset(mesh_types[m]);
+			Ref<Terrain3DMeshAsset> mesh_asset = _terrain->get_assets()->get_mesh_asset(region_mesh_id);
 			real_t mesh_height_offset = mesh_asset->get_height_offset();
-			for (int c = 0; c < cell_queue.size(); c++) {
-				Vector2i cell = cell_queue[c];
-				Array triple = cell_inst_dict[cell];
-				TypedArray<Transform3D> xforms = triple[0];
-				PackedColorArray colors = triple[1];
-				TypedArray<Transform3D> updated_xforms;
-				PackedColorArray updated_colors;
-				for (int i = 0; i < xforms.size(); i++) {
-					Transform3D t = xforms[i];
+			std::vector<Vector2i> emptied_cells;
+			for (const Vector2i &cell : cell_queue) {
+				InstanceData::Cell &cell_data = (*cells)[cell];
+				const int count = cell_data.get_count();
+				// Read from the shared buffer until the first change, then back up the cell for
+				// undo and write into a copy
+				float *buffer = nullptr;
+				int kept = 0;
+				for (int i = 0; i < count; i++) {
+					const float *instance = (buffer ? buffer : cell_data.buffer.ptr()) + i * InstanceData::STRIDE;
+					Transform3D t = InstanceData::read_transform(instance);
 					Vector3 global_origin(t.origin + global_local_offset);
+					bool removed = false;
 					if (rect.has_point(Vector2(global_origin.x, global_origin.z))) {
 						Vector3 height_offset = t.basis.get_column(1) * mesh_height_offset;
 						t.origin -= height_offset;
 						real_t height = _terrain->get_data()->get_height(global_origin);
 						// If the new height is a nan due to creating a hole, remove the instance
-						if (std::isnan(height)) {
-							continue;
-						}
+						removed = std::isnan(height);
 						t.origin.y = height;
 						t.origin += height_offset;
 					}
-					updated_xforms.push_back(t);
-					updated_colors.push_back(colors[i]);
+					if (!removed && kept == i && float(t.origin.y) == instance[7]) {
+						kept++;
+						continue;
+					}
+					if (!buffer) {
+						_backup_cell(region, region_mesh_id, cell);
+						buffer = cell_data.buffer.ptrw();
+						instance = buffer + i * InstanceData::STRIDE;
+					}
+					if (removed) {
+						continue;
+					}
+					float *dst = buffer + kept * InstanceData::STRIDE;
+					if (dst != instance) {
+						memcpy(dst, instance, InstanceData::STRIDE * sizeof(float));
+					}
+					dst[3] = t.origin.x;
+					dst[7] = t.origin.y;
+					dst[11] = t.origin.z;
+					kept++;
+				}
+				if (!buffer) {
+					continue;
 				}
-				if (updated_xforms.size() > 0) {
-					triple[0] = updated_xforms;
-					triple[1] = updated_colors;
-					triple[2] = true;
-					cell_inst_dict[cell] = triple;
+				region_changed = true;
+				if (kept > 0) {
+					cell_data.buffer.resize(int64_t(kept) * InstanceData::STRIDE);
+					cell_data.modified = true;
 				} else {
 					// Removed if a hole erased everything
-					cell_inst_dict.erase(cell);
-					_destroy_mmi_by_cell(region_loc, m, cell);
+					emptied_cells.push_back(cell);
+					_destroy_mmi_by_cell(region_loc, region_mesh_id, cell);
 				}
-				if (cell_inst_dict.is_empty()) {
-					mesh_inst_dict.erase(region_mesh_id);
+			}
+			// Erasing the last cell also erases the mesh, and invalidates cells
+			for (const Vector2i &cell : emptied_cells) {
+				instances->erase_cell(region_mesh_id, cell);
+			}
+		}
+		if (region_changed) {
+			_update_mmis(region_loc);
+		}
+	}
+}
+
+/** Returns the global transforms of the instances with their origin inside p_aabb.
+ * Only the regions and cells overlapping the AABB are searched.
+ *	p_mesh_id - the mesh asset id to search, or -1 for all
+ */
+TypedArray<Transform3D> Terrain3DInstancer::query_instances(const AABB &p_aabb, const int p_mesh_id) const {
+	TypedArray<Transform3D> xforms;
+	IS_DATA_INIT_MESG("Instancer isn't initialized.", xforms);
+	Terrain3DData *data = _terrain->get_data();
+	real_t vertex_spacing = _terrain->get_vertex_spacing();
+	for (const Vector2i &region_loc : _get_regions_in_rect(aabb2rect(p_aabb))) {
+		const Terrain3DRegion *region = data->get_region_ptr(region_loc);
+		if (!region) {
+			continue;
+		}
+		const InstanceData *instances = region->get_instances_ptr();
+		if (instances->is_empty()) {
+			continue;
+		}
+		int region_size = region->get_region_size();
+		Vector3 global_local_offset = Vector3(region_loc.x * region_size * vertex_spacing, 0.f, region_loc.y * region_size * vertex_spacing);
+		AABB local_aabb = AABB(p_aabb.position - global_local_offset, p_aabb.size);
+		Rect2 local_rect = aabb2rect(local_aabb);
+
+		std::vector<int> mesh_ids;
+		if (p_mesh_id < 0) {
+			mesh_ids = instances->get_mesh_ids();
+		} else {
+			mesh_ids.push_back(p_mesh_id);
+		}
+		for (const int mesh_id : mesh_ids) {
+			const InstanceData::CellMap *cells = instances->get_cells(mesh_id);
+			if (!cells) {
+				continue;
+			}
+			for (const Vector2i &cell : _get_cells_in_rect(*cells, local_rect, region_size)) {
+				const InstanceData::Cell &cell_data = cells->at(cell);
+				const int count = cell_data.get_count();
+				const float *src = cell_data.buffer.ptr();
+				for (int i = 0; i < count; i++) {
+					const float *instance = src + i * InstanceData::STRIDE;
+					if (local_aabb.has_point(Vector3(instance[3], instance[7], instance[11]))) {
+						Transform3D t = InstanceData::read_transform(instance);
+						t.origin += global_local_offset;
+						xforms.push_back(t);
+					}
 				}
 			}
 		}
-		_update_mmis(region_loc);
 	}
+	return xforms;
 }
 
 // Transfer foliage data from one region to another
@@ -971,30 +1354,27 @@ void Terrain3DInstancer::copy_paste_dfr(const Terrain3DRegion *p_src_region, con
 	}
 
 	// For each mesh, for each cell, if in rect, convert xforms to target region space, append to target region.
-	Dictionary mesh_inst_dict = p_src_region->get_instances();
-	Array mesh_types = mesh_inst_dict.keys();
-	for (int m = 0; m < mesh_types.size(); m++) {
+	const InstanceData *instances = p_src_region->get_instances_ptr();
+	for (const int mesh_id : instances->get_mesh_ids()) {
 		TypedArray<Transform3D> xforms;
 		PackedColorArray colors;
-		Dictionary cell_inst_dict = p_src_region->get_instances()[m];
-		Array cell_locs = cell_inst_dict.keys();
-		for (int c = 0; c < cell_locs.size(); c++) {
-			if (cells_to_copy.has(cell_locs[c])) {
-				Array triple = cell_inst_dict[cell_locs[c]];
-				TypedArray<Transform3D> cell_xforms = triple[0];
-				PackedColorArray cell_colors = triple[1];
-				for (int i = 0; i < cell_xforms.size(); i++) {
-					Transform3D t = cell_xforms[i];
-					t.origin += dst_translate;
-					xforms.push_back(t);
-					colors.push_back(cell_colors[i]);
-				}
+		for (const auto &cell_it : *instances->get_cells(mesh_id)) {
+			if (!cells_to_copy.has(cell_it.first)) {
+				continue;
+			}
+			const int count = cell_it.second.get_count();
+			const float *src = cell_it.second.buffer.ptr();
+			for (int i = 0; i < count; i++) {
+				Transform3D t = InstanceData::read_transform(src + i * InstanceData::STRIDE);
+				t.origin += dst_translate;
+				xforms.push_back(t);
+				colors.push_back(InstanceData::read_color(src + i * InstanceData::STRIDE));
 			}
 		}
 		if (xforms.size() == 0) {
 			continue;
 		}
-		append_region(Ref<Terrain3DRegion>(p_dst_region), m, xforms, colors, false);
+		append_region(Ref<Terrain3DRegion>(p_dst_region), mesh_id, xforms, colors, false);
 	}
 }
 
@@ -1015,31 +1395,11 @@ void Terrain3DInstancer::swap_ids(const int p_src_id, const int p_dst_id) {
 				continue;
 			}
 
-			// mesh_inst_dict could have src, src+dst, dst or nothing. All 4 must be considered
-			Dictionary mesh_inst_dict = region->get_instances();
-			Dictionary cells_inst_dict_src;
-			Dictionary cells_inst_dict_dst;
-			// Extract src dict
-			if (mesh_inst_dict.has(p_src_id)) {
+			// Instances could have src, src+dst, dst or nothing. swap_meshes() handles all 4
+			InstanceData *instances = region->get_instances_ptr();
+			if (instances->has_mesh(p_src_id) || instances->has_mesh(p_dst_id)) {
 				_backup_region(region);
-				cells_inst_dict_src = mesh_inst_dict[p_src_id];
-				mesh_inst_dict.erase(p_src_id);
-			}
-			// Extract dest dict
-			if (mesh_inst_dict.has(p_dst_id)) {
-				_backup_region(region);
-				cells_inst_dict_dst = mesh_inst_dict[p_dst_id];
-				mesh_inst_dict.erase(p_dst_id);
-			}
-			// If src exists, insert into dst slot
-			if (!cells_inst_dict_src.is_empty()) {
-				_backup_region(region);
-				mesh_inst_dict[p_dst_id] = cells_inst_dict_src;
-			}
-			// If dst exists, insert into src slot
-			if (!cells_inst_dict_dst.is_empty()) {
-				_backup_region(region);
-				mesh_inst_dict[p_src_id] = cells_inst_dict_dst;
+				instances->swap_meshes(p_src_id, p_dst_id);
 			}
 			LOG(MESG, "Swapped mesh_ids for region: ", region_loc);
 		}
@@ -1047,9 +1407,17 @@ void Terrain3DInstancer::swap_ids(const int p_src_id, const int p_dst_id) {
 	}
 }
 
+// Rebuilds update the existing MMIs in place, so instances stay visible until their cell is
+// rebuilt. They're spread over several frames, nearest to the camera first, unless
+// rebuild_cells_per_frame is 0. rebuild_finished is emitted when done.
 void Terrain3DInstancer::update_mmis(const bool p_rebuild) {
 	if (p_rebuild) {
-		destroy();
+		_destroy_stale_mmis();
+		_queue_rebuilds();
+		if (_rebuild_cells_per_frame == 0) {
+			_process_rebuilds(true);
+		}
+		return;
 	}
 	_update_mmis();
 }
@@ -1066,24 +1434,12 @@ void Terrain3DInstancer::dump_data() {
 			continue;
 		}
 		LOG(MESG, "Region: ", region_loc);
-		Dictionary mesh_inst_dict = region->get_instances();
-		Array mesh_ids = mesh_inst_dict.keys();
-		for (int m = 0; m < mesh_ids.size(); m++) {
-			int mesh_id = mesh_ids[m];
+		const InstanceData *instances = region->get_instances_ptr();
+		for (const int mesh_id : instances->get_mesh_ids()) {
 			LOG(MESG, "Mesh ID: ", mesh_id);
-			Dictionary cell_inst_dict = mesh_inst_dict[mesh_id];
-			Array cells = cell_inst_dict.keys();
-			for (int c = 0; c < cells.size(); c++) {
-				Vector2i cell = cells[c];
-				Array triple = cell_inst_dict[cell];
-				if (triple.size() != 3) {
-					LOG(WARN, "Malformed triple at cell ", cell, ": ", triple);
-					continue;
-				}
-				Array xforms = triple[0];
-				Array colors = triple[1];
-				bool modified = triple[2];
-				LOG(MESG, "Mesh: ", mesh_id, " cell: ", cell, " xforms: ", xforms.size(), " colors: ", colors.size(), " modified: ", modified);
+			for (const auto &cell_it : *instances->get_cells(mesh_id)) {
+				LOG(MESG, "Mesh: ", mesh_id, " cell: ", cell_it.first, " instances: ", cell_it.second.get_count(),
+						" floats: ", cell_it.second.buffer.size(), " modified: ", cell_it.second.modified);
 			}
 		}
 	}
@@ -1107,6 +1463,17 @@ void Terrain3DInstancer::dump_mmis() {
 			}
 		}
 	}
+	LOG(MESG, "_mmi_rids size: ", int(_mmi_rids.size()));
+	for (auto &i : _mmi_rids) {
+		LOG(MESG, "_mmi_rids region: ", i.first, ", dict ptr: ", uint64_t(&i.second));
+		for (auto &j : i.second) {
+			LOG(MESG, "mesh_rid_dict mesh: ", j.first, ", dict ptr: ", uint64_t(&j.second));
+			for (auto &k : j.second) {
+				LOG(MESG, "cell_rid_dict cell: ", k.first, ", instance: ", k.second.instance, ", multimesh: ", k.second.multimesh,
+						k.second.owns_multimesh ? "" : " (shared)");
+			}
+		}
+	}
 }
 
 ///////////////////////////
@@ -1114,6 +1481,17 @@ void Terrain3DInstancer::dump_mmis() {
 ///////////////////////////
 
 void Terrain3DInstancer::_bind_methods() {
+	BIND_ENUM_CONSTANT(NODES);
+	BIND_ENUM_CONSTANT(SERVER_GAME);
+	BIND_ENUM_CONSTANT(SERVER_EDITOR);
+
+	ClassDB::bind_method(D_METHOD("set_mode", "mode"), &Terrain3DInstancer::set_mode);
+	ClassDB::bind_method(D_METHOD("get_mode"), &Terrain3DInstancer::get_mode);
+	ClassDB::bind_method(D_METHOD("is_server_mode"), &Terrain3DInstancer::is_server_mode);
+	ClassDB::bind_method(D_METHOD("set_rebuild_cells_per_frame", "cells"), &Terrain3DInstancer::set_rebuild_cells_per_frame);
+	ClassDB::bind_method(D_METHOD("get_rebuild_cells_per_frame"), &Terrain3DInstancer::get_rebuild_cells_per_frame);
+	ClassDB::bind_method(D_METHOD("is_rebuilding"), &Terrain3DInstancer::is_rebuilding);
+
 	ClassDB::bind_method(D_METHOD("clear_by_mesh", "mesh_id"), &Terrain3DInstancer::clear_by_mesh);
 	ClassDB::bind_method(D_METHOD("clear_by_location", "region_location", "mesh_id"), &Terrain3DInstancer::clear_by_location);
 	ClassDB::bind_method(D_METHOD("clear_by_region", "region", "mesh_id"), &Terrain3DInstancer::clear_by_region);
@@ -1124,8 +1502,14 @@ void Terrain3DInstancer::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("append_location", "region_location", "mesh_id", "transforms", "colors", "update"), &Terrain3DInstancer::append_location, DEFVAL(true));
 	ClassDB::bind_method(D_METHOD("append_region", "region", "mesh_id", "transforms", "colors", "update"), &Terrain3DInstancer::append_region, DEFVAL(true));
 	ClassDB::bind_method(D_METHOD("update_transforms", "aabb"), &Terrain3DInstancer::update_transforms);
+	ClassDB::bind_method(D_METHOD("query_instances", "aabb", "mesh_id"), &Terrain3DInstancer::query_instances, DEFVAL(-1));
 	ClassDB::bind_method(D_METHOD("update_mmis", "rebuild"), &Terrain3DInstancer::update_mmis, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("swap_ids", "src_id", "dest_id"), &Terrain3DInstancer::swap_ids);
 	ClassDB::bind_method(D_METHOD("dump_data"), &Terrain3DInstancer::dump_data);
 	ClassDB::bind_method(D_METHOD("dump_mmis"), &Terrain3DInstancer::dump_mmis);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "mode", PROPERTY_HINT_ENUM, "Nodes,Server / Game,Server / Editor"), "set_mode", "get_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "rebuild_cells_per_frame", PROPERTY_HINT_RANGE, "0,1024,1,or_greater"), "set_rebuild_cells_per_frame", "get_rebuild_cells_per_frame");
+
+	ADD_SIGNAL(MethodInfo("rebuild_finished"));
 }
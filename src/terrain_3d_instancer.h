@@ -6,6 +6,7 @@
 #include <godot_cpp/classes/multi_mesh.hpp>
 #include <godot_cpp/classes/multi_mesh_instance3d.hpp>
 #include <unordered_map>
+#include <vector>
 
 #include "constants.h"
 
@@ -13,20 +14,32 @@ using namespace godot;
 
 class Terrain3D;
 class Terrain3DAssets;
+class Terrain3DData;
+class Terrain3DEditor;
 
 class Terrain3DInstancer : public Object {
 	GDCLASS(Terrain3DInstancer, Object);
 	CLASS_NAME();
 	friend Terrain3D;
+	friend Terrain3DData;
+	friend Terrain3DEditor;
 
 public: // Constants
 	static inline const int CELL_SIZE = 32;
+	static inline const int DEFAULT_REBUILD_CELLS = 64; // Cells rebuilt per frame after update_mmis(true)
+
+	enum InstancerMode {
+		NODES,
+		SERVER_GAME,
+		SERVER_EDITOR,
+	};
 
 private:
 	Terrain3D *_terrain = nullptr;
+	InstancerMode _mode = NODES;
 
-	// MM Resources stored in Terrain3DRegion::_instances as
-	// Region::_instances{mesh_id:int} -> cell{v2i} -> [ TypedArray<Transform3D>, PackedColorArray, modified:bool ]
+	// Instances stored in Terrain3DRegion::_instances as
+	// Region::_instances{mesh_id:int} -> cell{v2i} -> InstanceData::Cell{ buffer, modified }
 
 	// MMI Objects attached to tree, freed in destructor, stored as
 	// _mmi_nodes{region_loc} -> mesh{v2i(mesh_id,lod)} -> cell{v2i} -> MultiMeshInstance3D
@@ -38,17 +51,64 @@ private:
 	// _mmi_containers{region_loc} -> Node3D
 	std::unordered_map<Vector2i, Node3D *, Vector2iHash> _mmi_containers;
 
+	// In server mode, RenderingServer instances replace the MMIs, freed in destructor, stored as
+	// _mmi_rids{region_loc} -> mesh{v2i(mesh_id,lod)} -> cell{v2i} -> CellRIDs
+	struct CellRIDs {
+		RID multimesh; // The shadow impostor uses the multimesh of another lod, and doesn't own it
+		RID instance;
+		bool owns_multimesh = true;
+	};
+	typedef std::unordered_map<Vector2i, CellRIDs, Vector2iHash> CellRIDDict;
+	typedef std::unordered_map<Vector2i, CellRIDDict, Vector2iHash> MeshRIDDict;
+	std::unordered_map<Vector2i, MeshRIDDict, Vector2iHash> _mmi_rids;
+
+	struct LODRange {
+		real_t begin = 0.f;
+		real_t end = 0.f;
+		real_t begin_margin = 0.f;
+		real_t end_margin = 0.f;
+		bool fade = false;
+	};
+
+	// Cells queued by update_mmis(true) to be rebuilt in place on the main thread by
+	// _process_rebuilds(), a few each frame. Sorted so the cell nearest to the camera is last.
+	struct QueuedCell {
+		Vector2i region_loc;
+		int mesh_id = 0;
+		Vector2i cell;
+		real_t distance = 0.f;
+	};
+	std::vector<QueuedCell> _rebuilds;
+	int _rebuild_cells_per_frame = DEFAULT_REBUILD_CELLS;
+
 	uint32_t _density_counter = 0;
 	uint32_t _get_density_count(const real_t p_density);
 
 	void _update_mmis(const Vector2i &p_region_loc = V2I_MAX, const int p_mesh_id = -1);
+	Ref<Terrain3DMeshAsset> _get_drawable_mesh_asset(const int p_mesh_id) const;
+	void _update_cell_mmis(Terrain3DRegion *p_region, const int p_mesh_id, const Ref<Terrain3DMeshAsset> &p_ma,
+			const Vector2i &p_cell, InstanceData::Cell &p_cell_data, const bool p_server_mode);
+	static bool _is_lod_drawn(const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod);
+	void _destroy_stale_mmis();
+	void _queue_rebuilds();
+	void _process_rebuilds(const bool p_blocking = false);
+	RID _update_cell_rids(const Vector2i &p_region_loc, const Vector2i &p_mesh_key, const Vector2i &p_cell,
+			const InstanceData::Cell &p_cell_data, const Ref<Terrain3DMeshAsset> &p_ma, const Transform3D &p_xform,
+			const RID &p_shadow_mm, bool p_modified);
+	void _update_server_instances();
 	void _update_vertex_spacing(const real_t p_vertex_spacing);
 	void _destroy_mmi_by_cell(const Vector2i &p_region_loc, const int p_mesh_id, const Vector2i p_cell);
 	void _destroy_mmi_by_location(const Vector2i &p_region_loc, const int p_mesh_id);
+	void _destroy_rids();
 	void _backup_regionl(const Vector2i &p_region_loc);
 	void _backup_region(const Ref<Terrain3DRegion> &p_region);
-	Ref<MultiMesh> _create_multimesh(const int p_mesh_id, const int p_lod, const TypedArray<Transform3D> &p_xforms = TypedArray<Transform3D>(), const PackedColorArray &p_colors = PackedColorArray()) const;
+	void _backup_cell(Terrain3DRegion *p_region, const int p_mesh_id, const Vector2i &p_cell);
+	Ref<MultiMesh> _create_multimesh(const int p_mesh_id, const int p_lod, const PackedFloat32Array &p_buffer = PackedFloat32Array()) const;
+	static void _set_multimesh_buffer(const Ref<MultiMesh> &p_mm, const PackedFloat32Array &p_buffer);
 	Vector2i _get_cell(const Vector3 &p_global_position, const int p_region_size);
+	std::vector<Vector2i> _get_regions_in_rect(const Rect2 &p_rect) const;
+	std::vector<Vector2i> _get_cells_in_rect(const InstanceData::CellMap &p_cells, const Rect2 &p_rect, const int p_region_size) const;
+	static LODRange _get_lod_range(const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod);
 	void _setup_mmi_lod_ranges(MultiMeshInstance3D *p_mmi, const Ref<Terrain3DMeshAsset> &p_ma, const int p_lod);
 
 public:
@@ -58,6 +118,13 @@ public:
 	void initialize(Terrain3D *p_terrain);
 	void destroy();
 
+	void set_mode(const InstancerMode p_mode);
+	InstancerMode get_mode() const { return _mode; }
+	bool is_server_mode() const;
+	void set_rebuild_cells_per_frame(const int p_cells);
+	int get_rebuild_cells_per_frame() const { return _rebuild_cells_per_frame; }
+	bool is_rebuilding() const { return !_rebuilds.empty(); }
+
 	void clear_by_mesh(const int p_mesh_id);
 	void clear_by_location(const Vector2i &p_region_loc, const int p_mesh_id);
 	void clear_by_region(const Ref<Terrain3DRegion> &p_region, const int p_mesh_id);
@@ -71,6 +138,7 @@ public:
 	void append_region(const Ref<Terrain3DRegion> &p_region, const int p_mesh_id, const TypedArray<Transform3D> &p_xforms,
 			const PackedColorArray &p_colors, const bool p_update = true);
 	void update_transforms(const AABB &p_aabb);
+	TypedArray<Transform3D> query_instances(const AABB &p_aabb, const int p_mesh_id = -1) const;
 	void copy_paste_dfr(const Terrain3DRegion *p_src_region, const Rect2i &p_src_rect, const Terrain3DRegion *p_dst_region);
 
 	void swap_ids(const int p_src_id, const int p_dst_id);
@@ -84,6 +152,9 @@ protected:
 	static void _bind_methods();
 };
 
+typedef Terrain3DInstancer::InstancerMode InstancerMode;
+VARIANT_ENUM_CAST(Terrain3DInstancer::InstancerMode);
+
 // Allows us to instance every X function calls for sparse placement
 // Modifies _density_counter, not const!
 inline uint32_t Terrain3DInstancer::_get_density_count(const real_t p_density) {
@@ -464,17 +464,19 @@ void Terrain3DMaterial::_update_maps() {
 	LOG(EXTREME, "Updating maps in shader");
 
 	Terrain3DData *data = _terrain->get_data();
-	PackedInt32Array region_map = data->get_region_map();
+	PackedInt32Array region_map = data->get_region_map_pages();
 	LOG(EXTREME, "region_map.size(): ", region_map.size());
-	if (region_map.size() != Terrain3DData::REGION_MAP_SIZE * Terrain3DData::REGION_MAP_SIZE) {
-		LOG(ERROR, "Expected region_map.size() of ", Terrain3DData::REGION_MAP_SIZE * Terrain3DData::REGION_MAP_SIZE);
+	if (region_map.size() < RegionMap::PAGE_TABLE_SIZE + RegionMap::BLOCK_AREA) {
+		LOG(ERROR, "Expected region_map.size() of at least ", RegionMap::PAGE_TABLE_SIZE + RegionMap::BLOCK_AREA);
 		return;
 	}
-	RS->material_set_param(_material, "_region_map", region_map);
+	// The page table is small enough for a uniform, the pages are read from a texture
+	RS->material_set_param(_material, "_region_blocks", region_map.slice(0, RegionMap::PAGE_TABLE_SIZE));
+	RS->material_set_param(_material, "_region_map", data->get_region_map_rid());
 	RS->material_set_param(_material, "_region_map_size", Terrain3DData::REGION_MAP_SIZE);
 	if (Terrain3D::debug_level >= EXTREME) {
-		LOG(EXTREME, "Region map");
-		for (int i = 0; i < region_map.size(); i++) {
+		LOG(EXTREME, "Region map pages: ", RegionMap::get_page_count(region_map));
+		for (int i = RegionMap::PAGE_TABLE_SIZE; i < region_map.size(); i++) {
 			if (region_map[i]) {
 				LOG(EXTREME, "Region id: ", region_map[i], " array index: ", i);
 			}
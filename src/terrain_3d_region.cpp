@@ -1,12 +1,71 @@
 // Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
 
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
 #include <godot_cpp/classes/resource_saver.hpp>
 
 #include "logger.h"
+#include "region_file.h"
+#include "sparse_map.h"
 #include "terrain_3d_data.h"
 #include "terrain_3d_region.h"
 #include "terrain_3d_util.h"
 
+/////////////////////
+// Private Functions
+/////////////////////
+
+Ref<Image> &Terrain3DRegion::_get_image_ref(const MapType p_map_type) {
+	switch (p_map_type) {
+		case TYPE_HEIGHT:
+			return _height_map;
+		case TYPE_CONTROL:
+			return _control_map;
+		default:
+			return _color_map;
+	}
+}
+
+const Ref<Image> &Terrain3DRegion::_get_image_ref(const MapType p_map_type) const {
+	switch (p_map_type) {
+		case TYPE_HEIGHT:
+			return _height_map;
+		case TYPE_CONTROL:
+			return _control_map;
+		default:
+			return _color_map;
+	}
+}
+
+// Replaces a sparse map with an Image, for writing through the Image API
+void Terrain3DRegion::_expand_map(const MapType p_map_type) {
+	if (!_sparse_maps[p_map_type]) {
+		return;
+	}
+	LOG(DEBUG, "Expanding sparse ", TYPESTR[p_map_type], " of region ", _location);
+	_get_image_ref(p_map_type) = _sparse_maps[p_map_type]->to_image(p_map_type == TYPE_COLOR);
+	_expanded_maps[p_map_type] = _sparse_maps[p_map_type];
+	_sparse_maps[p_map_type].reset();
+}
+
+// Drops any memory mapped or sparse storage of a map before it's replaced
+void Terrain3DRegion::_clear_map(const MapType p_map_type) {
+	_unmap(p_map_type);
+	_sparse_maps[p_map_type].reset();
+	_expanded_maps[p_map_type].reset();
+}
+
+void Terrain3DRegion::_unmap(const MapType p_map_type) {
+	_mapped_maps[p_map_type] = nullptr;
+	for (const uint8_t *mapped : _mapped_maps) {
+		if (mapped) {
+			return;
+		}
+	}
+	_mapped_file.reset();
+}
+
 /////////////////////
 // Public Functions
 /////////////////////
@@ -37,32 +96,70 @@ void Terrain3DRegion::set_map(const MapType p_map_type, const Ref<Image> &p_imag
 	}
 }
 
+// Memory mapped and sparse maps are returned as a copy, so writes to it are not kept. Use
+// set_map() to replace them.
 Ref<Image> Terrain3DRegion::get_map(const MapType p_map_type) const {
-	switch (p_map_type) {
-		case TYPE_HEIGHT:
-			return get_height_map();
-		case TYPE_CONTROL:
-			return get_control_map();
-		case TYPE_COLOR:
-			return get_color_map();
-		default:
-			LOG(ERROR, "Requested map type ", p_map_type, ", is invalid");
-			return Ref<Image>();
-	}
+	return read_map(p_map_type);
 }
 
+// Returns nullptr for memory mapped and sparse maps, which have no Image. See get_mapped_ptr()
+// and get_sparse_map(). Use get_map_ptrw() to write.
 Image *Terrain3DRegion::get_map_ptr(const MapType p_map_type) const {
-	switch (p_map_type) {
-		case TYPE_HEIGHT:
-			return *_height_map;
-		case TYPE_CONTROL:
-			return *_control_map;
-		case TYPE_COLOR:
-			return *_color_map;
-		default:
-			LOG(ERROR, "Requested map type ", p_map_type, ", is invalid");
-			return nullptr;
+	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
+		LOG(ERROR, "Requested map type ", p_map_type, ", is invalid");
+		return nullptr;
+	}
+	return *_get_image_ref(p_map_type);
+}
+
+// Returns the map for writing, first expanding a sparse map into an Image. Returns nullptr for
+// memory mapped maps, which are read only. Prefer get_sparse_map_ptrw() for height and control
+// maps, which copies only the tiles written, where this copies the whole map.
+Image *Terrain3DRegion::get_map_ptrw(const MapType p_map_type) {
+	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
+		LOG(ERROR, "Requested map type ", p_map_type, ", is invalid");
+		return nullptr;
 	}
+	_expand_map(p_map_type);
+	return *_get_image_ref(p_map_type);
+}
+
+/** Returns the map for reading, without expanding sparse maps. Memory mapped and sparse maps are
+ * copied into a temporary Image, the color map with mipmaps. Other maps are returned as is.
+ * Safe to call from worker threads while the maps aren't being modified.
+ */
+Ref<Image> Terrain3DRegion::read_map(const MapType p_map_type) const {
+	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
+		LOG(ERROR, "Requested map type ", p_map_type, ", is invalid");
+		return Ref<Image>();
+	}
+	if (const uint8_t *mapped = _mapped_maps[p_map_type]) {
+		PackedByteArray data;
+		data.resize(int64_t(_region_size) * _region_size * sizeof(uint32_t));
+		memcpy(data.ptrw(), mapped, data.size());
+		return Image::create_from_data(_region_size, _region_size, false, FORMAT[p_map_type], data);
+	}
+	if (_sparse_maps[p_map_type]) {
+		return _sparse_maps[p_map_type]->to_image(p_map_type == TYPE_COLOR);
+	}
+	return _get_image_ref(p_map_type);
+}
+
+// Returns a pixel of the map, read in place without copying memory mapped or sparse maps. The
+// pixel must be within the region. Safe to call from worker threads while the maps aren't being
+// modified.
+Color Terrain3DRegion::get_pixel(const MapType p_map_type, const Vector2i &p_pixel) const {
+	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
+		return COLOR_NAN;
+	}
+	if (const uint8_t *mapped = _mapped_maps[p_map_type]) {
+		return SparseMap::decode(FORMAT[p_map_type], reinterpret_cast<const uint32_t *>(mapped)[p_pixel.y * _region_size + p_pixel.x]);
+	}
+	if (_sparse_maps[p_map_type]) {
+		return _sparse_maps[p_map_type]->get_pixel(p_pixel.x, p_pixel.y);
+	}
+	const Ref<Image> &map = _get_image_ref(p_map_type);
+	return map.is_valid() ? map->get_pixelv(p_pixel) : COLOR_NAN;
 }
 
 void Terrain3DRegion::set_maps(const TypedArray<Image> &p_maps) {
@@ -79,9 +176,9 @@ void Terrain3DRegion::set_maps(const TypedArray<Image> &p_maps) {
 TypedArray<Image> Terrain3DRegion::get_maps() const {
 	LOG(INFO, "Retrieving maps from region: ", _location);
 	TypedArray<Image> maps;
-	maps.push_back(_height_map);
-	maps.push_back(_control_map);
-	maps.push_back(_color_map);
+	maps.push_back(get_height_map());
+	maps.push_back(get_control_map());
+	maps.push_back(get_color_map());
 	return maps;
 }
 
@@ -90,7 +187,9 @@ void Terrain3DRegion::set_height_map(const Ref<Image> &p_map) {
 	if (_region_size == 0) {
 		set_region_size((p_map.is_valid()) ? p_map->get_width() : 0);
 	}
+	_clear_map(TYPE_HEIGHT);
 	_height_map = sanitize_map(TYPE_HEIGHT, p_map);
+	_height_pyramid.reset();
 	calc_height_range();
 }
 
@@ -99,6 +198,7 @@ void Terrain3DRegion::set_control_map(const Ref<Image> &p_map) {
 	if (_region_size == 0) {
 		set_region_size((p_map.is_valid()) ? p_map->get_width() : 0);
 	}
+	_clear_map(TYPE_CONTROL);
 	_control_map = sanitize_map(TYPE_CONTROL, p_map);
 }
 
@@ -107,6 +207,7 @@ void Terrain3DRegion::set_color_map(const Ref<Image> &p_map) {
 	if (_region_size == 0) {
 		set_region_size((p_map.is_valid()) ? p_map->get_width() : 0);
 	}
+	_clear_map(TYPE_COLOR);
 	_color_map = sanitize_map(TYPE_COLOR, p_map);
 	if (!_color_map->has_mipmaps()) {
 		LOG(DEBUG, "Color map does not have mipmaps. Generating");
@@ -114,14 +215,51 @@ void Terrain3DRegion::set_color_map(const Ref<Image> &p_map) {
 	}
 }
 
+// Returns the bytes held by the maps, excluding memory mapped ones
+int64_t Terrain3DRegion::get_memory() const {
+	int64_t bytes = 0;
+	for (int i = 0; i < TYPE_MAX; i++) {
+		const Ref<Image> &map = _get_image_ref(MapType(i));
+		bytes += map.is_valid() ? map->get_data().size() : 0;
+		bytes += _sparse_maps[i] ? _sparse_maps[i]->get_memory() : 0;
+		bytes += _expanded_maps[i] ? _expanded_maps[i]->get_memory() : 0;
+	}
+	return bytes;
+}
+
+/** Validates the maps, and stores them as sparse maps, which only hold the pixels of tiles that
+ * vary. Height and control maps are always stored this way, so DataSnapshot can share their tiles.
+ * Color maps are only if missing or mostly uniform, as the editor expands them to paint and
+ * generate mipmaps. Maps expanded since the last call are kept as Images, and compacted again
+ * here. Pointers into the maps, such as those of Terrain3DData, must be refreshed afterwards.
+ */
 void Terrain3DRegion::sanitize_maps() {
 	if (_region_size == 0) { // blank region, no set_*_map has been called
 		LOG(ERROR, "Set region_size first");
 		return;
 	}
-	_height_map = sanitize_map(TYPE_HEIGHT, _height_map);
-	_control_map = sanitize_map(TYPE_CONTROL, _control_map);
-	_color_map = sanitize_map(TYPE_COLOR, _color_map);
+	for (int i = 0; i < TYPE_MAX; i++) {
+		const MapType map_type = MapType(i);
+		_expanded_maps[i].reset();
+		// Memory mapped maps were validated when mapped, and sparse maps when compacted
+		if (_mapped_maps[i] || _sparse_maps[i]) {
+			continue;
+		}
+		Ref<Image> &map = _get_image_ref(map_type);
+		if (map.is_null()) {
+			LOG(DEBUG, "No provided ", TYPESTR[i], " map. Creating blank sparse map");
+			_sparse_maps[i] = std::make_shared<SparseMap>(_region_size, FORMAT[i], SparseMap::encode(FORMAT[i], COLOR[i]));
+			continue;
+		}
+		map = sanitize_map(map_type, map);
+		_sparse_maps[i] = SparseMap::compact(map, (map_type == TYPE_COLOR) ? SparseMap::MAX_DENSE_RATIO : 1.f);
+		if (_sparse_maps[i]) {
+			map.unref();
+		}
+	}
+	if (!_mapped_maps[TYPE_HEIGHT]) {
+		_height_pyramid.reset();
+	}
 }
 
 Ref<Image> Terrain3DRegion::sanitize_map(const MapType p_map_type, const Ref<Image> &p_map) const {
@@ -196,7 +334,7 @@ void Terrain3DRegion::set_height_range(const Vector2 &p_range) {
 }
 
 void Terrain3DRegion::calc_height_range() {
-	Vector2 range = Util::get_min_max(_height_map);
+	Vector2 range = _sparse_maps[TYPE_HEIGHT] ? _sparse_maps[TYPE_HEIGHT]->get_min_max() : Util::get_min_max(read_map(TYPE_HEIGHT));
 	if (_height_range != range) {
 		_height_range = range;
 		_modified = true;
@@ -225,17 +363,8 @@ Error Terrain3DRegion::save(const String &p_path, const bool p_16_bit) {
 	}
 	LOG(MESG, "Writing", (p_16_bit) ? " 16-bit" : "", " region ", _location, " to ", get_path());
 	set_version(Terrain3DData::CURRENT_VERSION);
-	Error err = OK;
-	if (p_16_bit) {
-		Ref<Image> original_map;
-		original_map.instantiate();
-		original_map->copy_from(_height_map);
-		_height_map->convert(Image::FORMAT_RH);
-		err = ResourceSaver::get_singleton()->save(this, get_path(), ResourceSaver::FLAG_COMPRESS);
-		_height_map = original_map;
-	} else {
-		err = ResourceSaver::get_singleton()->save(this, get_path(), ResourceSaver::FLAG_COMPRESS);
-	}
+	// Region files keep their format, and stay mappable if they were mapped
+	Error err = RegionFile::is_region_file(get_path()) ? RegionFile::save(this, get_path(), 0.f, is_mapped()) : write(get_path(), p_16_bit);
 	if (err == OK) {
 		_modified = false;
 		LOG(INFO, "File saved successfully");
@@ -245,6 +374,121 @@ Error Terrain3DRegion::save(const String &p_path, const bool p_16_bit) {
 	return err;
 }
 
+/** Writes a copy of the region to p_path, without changing this one. In 16-bit mode, the copy
+ * gets a converted copy of the height map. The file is first written to a temporary file in the
+ * same directory, which then replaces it, so an interrupted save never leaves a broken file.
+ * Safe to call from worker threads while the maps aren't being modified.
+ *	r_bytes - if not null, receives the size of the written file
+ */
+Error Terrain3DRegion::write(const String &p_path, const bool p_16_bit, uint64_t *r_bytes) const {
+	Ref<Terrain3DRegion> region;
+	region.instantiate();
+	region->set_data(get_data());
+	if (p_16_bit) {
+		Ref<Image> height_map;
+		height_map.instantiate();
+		height_map->copy_from(read_map(TYPE_HEIGHT));
+		height_map->convert(Image::FORMAT_RH);
+		region->_height_map = height_map;
+	}
+	// An absolute path also keeps the editor from being notified of the temporary file
+	String temp_path = ProjectSettings::get_singleton()->globalize_path(p_path.get_base_dir().path_join(".tmp-" + p_path.get_file()));
+	Error err = ResourceSaver::get_singleton()->save(region, temp_path, ResourceSaver::FLAG_COMPRESS);
+	if (err != OK) {
+		LOG(ERROR, "Cannot write temporary file: ", temp_path, ", error: ", UtilityFunctions::error_string(err));
+		DirAccess::remove_absolute(temp_path);
+		return err;
+	}
+	if (r_bytes) {
+		Ref<FileAccess> file = FileAccess::open(temp_path, FileAccess::READ);
+		*r_bytes = file.is_valid() ? file->get_length() : 0;
+	}
+	err = DirAccess::rename_absolute(temp_path, p_path);
+	if (err != OK) {
+		LOG(ERROR, "Cannot replace file: ", p_path, ", error: ", UtilityFunctions::error_string(err));
+		DirAccess::remove_absolute(temp_path);
+	}
+	return err;
+}
+
+/** Writes the region to p_path in the compact binary format of RegionFile, usually with the
+ * extension ".t3dr". Unlike save(), this doesn't change the path or the modified state.
+ *	p_height_step - quantizes heights to multiples of this many meters. 0 keeps them lossless.
+ *	p_mappable - stores the height and control maps uncompressed, for load_mapped()
+ */
+Error Terrain3DRegion::save_binary(const String &p_path, const real_t p_height_step, const bool p_mappable) const {
+	LOG(INFO, "Writing binary region ", _location, " to ", p_path);
+	return RegionFile::save(this, p_path, p_height_step, p_mappable);
+}
+
+Ref<Terrain3DRegion> Terrain3DRegion::load_binary(const String &p_path) {
+	return RegionFile::load(p_path);
+}
+
+// Loads a region file with its height and control maps read only from a memory mapping of it
+Ref<Terrain3DRegion> Terrain3DRegion::load_mapped(const String &p_path) {
+	return RegionFile::map(p_path);
+}
+
+// Reads a map directly from p_data within the memory mapped p_file, replacing its Image
+void Terrain3DRegion::set_mapped_map(const MapType p_map_type, const std::shared_ptr<const MappedFile> &p_file, const uint8_t *p_data) {
+	if (p_map_type != TYPE_HEIGHT && p_map_type != TYPE_CONTROL) {
+		LOG(ERROR, "Only height and control maps can be memory mapped");
+		return;
+	}
+	if (_mapped_file && _mapped_file != p_file) {
+		LOG(ERROR, "Maps of one region must be in the same file");
+		return;
+	}
+	_mapped_file = p_file;
+	_mapped_maps[p_map_type] = p_data;
+	_sparse_maps[p_map_type].reset();
+	_expanded_maps[p_map_type].reset();
+	if (p_map_type == TYPE_HEIGHT) {
+		_height_map.unref();
+		_height_pyramid.reset();
+	} else {
+		_control_map.unref();
+	}
+}
+
+// Returns the sparse map for writing, or nullptr if the map isn't sparse. The map is copied first
+// if a snapshot or a duplicated region shares it, and its tiles when written.
+SparseMap *Terrain3DRegion::get_sparse_map_ptrw(const MapType p_map_type) {
+	if (p_map_type < 0 || p_map_type >= TYPE_MAX || !_sparse_maps[p_map_type]) {
+		return nullptr;
+	}
+	if (_sparse_maps[p_map_type].use_count() > 1) {
+		_sparse_maps[p_map_type] = std::make_shared<SparseMap>(*_sparse_maps[p_map_type]);
+	}
+	return _sparse_maps[p_map_type].get();
+}
+
+/** Stores an Image height or control map in tiles again, once written through get_map_ptrw() or
+ * replaced with set_map(), so DataSnapshot can share it instead of copying it. Images not in the
+ * expected format and size are kept. Returns true if the map was compacted, after which pointers
+ * into it, such as those of Terrain3DData, must be refreshed.
+ */
+bool Terrain3DRegion::compact_map(const MapType p_map_type) {
+	if (p_map_type != TYPE_HEIGHT && p_map_type != TYPE_CONTROL) {
+		return false;
+	}
+	Ref<Image> &map = _get_image_ref(p_map_type);
+	if (_mapped_maps[p_map_type] || _sparse_maps[p_map_type] || map.is_null() ||
+			map->get_format() != FORMAT[p_map_type] || map->get_size() != Vector2i(_region_size, _region_size)) {
+		return false;
+	}
+	std::shared_ptr<SparseMap> sparse = SparseMap::compact(map, 1.f);
+	if (!sparse) {
+		return false;
+	}
+	LOG(DEBUG, "Compacted ", TYPESTR[p_map_type], " of region ", _location);
+	_sparse_maps[p_map_type] = sparse;
+	_expanded_maps[p_map_type].reset();
+	map.unref();
+	return true;
+}
+
 void Terrain3DRegion::set_location(const Vector2i &p_location) {
 	// In the future anywhere they want to put the location might be fine, but because of region_map
 	// We have a limitation of 16x16 and eventually 45x45.
@@ -270,10 +514,23 @@ void Terrain3DRegion::set_data(const Dictionary &p_data) {
 	SET_IF_HAS(_region_size, "region_size");
 	SET_IF_HAS(_vertex_spacing, "vertex_spacing");
 	SET_IF_HAS(_height_range, "height_range");
-	SET_IF_HAS(_height_map, "height_map");
-	SET_IF_HAS(_control_map, "control_map");
-	SET_IF_HAS(_color_map, "color_map");
-	SET_IF_HAS(_instances, "instances");
+	if (p_data.has("height_map")) {
+		_clear_map(TYPE_HEIGHT);
+		_height_map = p_data["height_map"];
+	}
+	if (p_data.has("control_map")) {
+		_clear_map(TYPE_CONTROL);
+		_control_map = p_data["control_map"];
+	}
+	if (p_data.has("color_map")) {
+		_clear_map(TYPE_COLOR);
+		_color_map = p_data["color_map"];
+	}
+	if (p_data.has("instance_data")) {
+		_instances.deserialize(p_data["instance_data"]);
+	} else if (p_data.has("instances")) {
+		_instances.from_dictionary(p_data["instances"]);
+	}
 }
 
 Dictionary Terrain3DRegion::get_data() const {
@@ -286,10 +543,11 @@ Dictionary Terrain3DRegion::get_data() const {
 	dict["region_size"] = _region_size;
 	dict["vertex_spacing"] = _vertex_spacing;
 	dict["height_range"] = _height_range;
-	dict["height_map"] = _height_map;
-	dict["control_map"] = _control_map;
-	dict["color_map"] = _color_map;
-	dict["instances"] = _instances;
+	// Memory mapped and sparse maps are copied, so this is safe on worker threads
+	dict["height_map"] = read_map(TYPE_HEIGHT);
+	dict["control_map"] = read_map(TYPE_CONTROL);
+	dict["color_map"] = read_map(TYPE_COLOR);
+	dict["instance_data"] = _instances.serialize();
 	return dict;
 }
 
@@ -308,12 +566,27 @@ Ref<Terrain3DRegion> Terrain3DRegion::duplicate(const bool p_deep) {
 		dict["modified"] = _modified;
 		dict["deleted"] = _deleted;
 		dict["location"] = _location;
-		// Resource duplicates
-		dict["height_map"] = _height_map->duplicate();
-		dict["control_map"] = _control_map->duplicate();
-		dict["color_map"] = _color_map->duplicate();
-		dict["instances"] = _instances.duplicate(true);
+		// Resource duplicates, except sparse maps which are shared below
+		auto duplicate_map = [&](const MapType p_map_type) -> Variant {
+			const Ref<Image> &map = _get_image_ref(p_map_type);
+			if (map.is_valid()) {
+				return map->duplicate();
+			}
+			return _sparse_maps[p_map_type] ? Variant() : Variant(read_map(p_map_type));
+		};
+		dict["height_map"] = duplicate_map(TYPE_HEIGHT);
+		dict["control_map"] = duplicate_map(TYPE_CONTROL);
+		dict["color_map"] = duplicate_map(TYPE_COLOR);
 		region->set_data(dict);
+		// Instance buffers are copied on write
+		region->_instances = _instances;
+	}
+	// Sparse maps are shared instead, as they're copied on write
+	for (int i = 0; i < TYPE_MAX; i++) {
+		if (_sparse_maps[i]) {
+			region->_get_image_ref(MapType(i)).unref();
+			region->_sparse_maps[i] = _sparse_maps[i];
+		}
 	}
 	return region;
 }
@@ -345,6 +618,9 @@ void Terrain3DRegion::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_control_map"), &Terrain3DRegion::get_control_map);
 	ClassDB::bind_method(D_METHOD("set_color_map", "map"), &Terrain3DRegion::set_color_map);
 	ClassDB::bind_method(D_METHOD("get_color_map"), &Terrain3DRegion::get_color_map);
+	ClassDB::bind_method(D_METHOD("read_map", "map_type"), &Terrain3DRegion::read_map);
+	ClassDB::bind_method(D_METHOD("get_memory"), &Terrain3DRegion::get_memory);
+	ClassDB::bind_method(D_METHOD("is_sparse", "map_type"), &Terrain3DRegion::is_sparse);
 	ClassDB::bind_method(D_METHOD("sanitize_maps"), &Terrain3DRegion::sanitize_maps);
 	ClassDB::bind_method(D_METHOD("sanitize_map", "map_type", "map"), &Terrain3DRegion::sanitize_map);
 	ClassDB::bind_method(D_METHOD("validate_map_size", "map"), &Terrain3DRegion::validate_map_size);
@@ -357,8 +633,15 @@ void Terrain3DRegion::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("set_instances", "instances"), &Terrain3DRegion::set_instances);
 	ClassDB::bind_method(D_METHOD("get_instances"), &Terrain3DRegion::get_instances);
+	ClassDB::bind_method(D_METHOD("set_instance_data", "data"), &Terrain3DRegion::set_instance_data);
+	ClassDB::bind_method(D_METHOD("get_instance_data"), &Terrain3DRegion::get_instance_data);
+	ClassDB::bind_method(D_METHOD("get_instance_count"), &Terrain3DRegion::get_instance_count);
 
 	ClassDB::bind_method(D_METHOD("save", "path", "16-bit"), &Terrain3DRegion::save, DEFVAL(""), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("save_binary", "path", "height_step", "mappable"), &Terrain3DRegion::save_binary, DEFVAL(0.f), DEFVAL(false));
+	ClassDB::bind_static_method("Terrain3DRegion", D_METHOD("load_binary", "path"), &Terrain3DRegion::load_binary);
+	ClassDB::bind_static_method("Terrain3DRegion", D_METHOD("load_mapped", "path"), &Terrain3DRegion::load_mapped);
+	ClassDB::bind_method(D_METHOD("is_mapped"), &Terrain3DRegion::is_mapped);
 
 	ClassDB::bind_method(D_METHOD("set_deleted", "deleted"), &Terrain3DRegion::set_deleted);
 	ClassDB::bind_method(D_METHOD("is_deleted"), &Terrain3DRegion::is_deleted);
@@ -381,7 +664,9 @@ void Terrain3DRegion::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "height_map", PROPERTY_HINT_RESOURCE_TYPE, "Image", ro_flags), "set_height_map", "get_height_map");
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "control_map", PROPERTY_HINT_RESOURCE_TYPE, "Image", ro_flags), "set_control_map", "get_control_map");
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "color_map", PROPERTY_HINT_RESOURCE_TYPE, "Image", ro_flags), "set_color_map", "get_color_map");
-	ADD_PROPERTY(PropertyInfo(Variant::DICTIONARY, "instances", PROPERTY_HINT_NONE, "", ro_flags), "set_instances", "get_instances");
+	ADD_PROPERTY(PropertyInfo(Variant::DICTIONARY, "instance_data", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_STORAGE), "set_instance_data", "get_instance_data");
+	// Converted to instance_data when loading files of earlier versions, no longer saved
+	ADD_PROPERTY(PropertyInfo(Variant::DICTIONARY, "instances", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NONE), "set_instances", "get_instances");
 
 	// Double-clicking a region .res file shows what's on disk, the defaults, not in memory. So these are hidden
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "edited", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NONE), "set_edited", "is_edited");
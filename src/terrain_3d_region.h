@@ -3,11 +3,18 @@
 #ifndef TERRAIN3D_REGION_CLASS_H
 #define TERRAIN3D_REGION_CLASS_H
 
+#include <memory>
+
 #include "constants.h"
+#include "instance_data.h"
 #include "terrain_3d_util.h"
 
 using namespace godot;
 
+class HeightPyramid;
+class MappedFile;
+class SparseMap;
+
 class Terrain3DRegion : public Resource {
 	GDCLASS(Terrain3DRegion, Resource);
 	CLASS_NAME();
@@ -51,14 +58,30 @@ private:
 	Ref<Image> _control_map;
 	Ref<Image> _color_map;
 	// Instancer
-	Dictionary _instances; // Meshes{int} -> Cells{v2i} -> [ Transform3D, Color, Modified ]
+	InstanceData _instances; // Meshes{int} -> Cells{v2i} -> packed transforms and colors
 	real_t _vertex_spacing = 1.f; // Vertex Spacing value that transforms are currently scaled.
 
 	// Working data not saved to disk
 	bool _deleted = false; // Marked for deletion on save
 	bool _edited = false; // Marked for undo/redo storage
 	bool _modified = false; // Marked for saving
+	Rect2i _dirty_rects[TYPE_MAX]; // Pixels edited since the last texture upload, or empty if unknown
 	Vector2i _location = V2I_MAX;
+	std::shared_ptr<HeightPyramid> _height_pyramid; // Built by Terrain3DData
+	// Read only maps in a memory mapped region file, used in place of the Images
+	std::shared_ptr<const MappedFile> _mapped_file;
+	const uint8_t *_mapped_maps[TYPE_MAX] = {};
+	// Height, control and mostly uniform color maps stored in tiles instead of Images, which
+	// DataSnapshot shares. Those expanded back into Images for writing are kept until the next
+	// sanitize_maps() or compact_map(), as Terrain3DData may still have pointers into them.
+	std::shared_ptr<SparseMap> _sparse_maps[TYPE_MAX];
+	std::shared_ptr<SparseMap> _expanded_maps[TYPE_MAX];
+
+	Ref<Image> &_get_image_ref(const MapType p_map_type);
+	const Ref<Image> &_get_image_ref(const MapType p_map_type) const;
+	void _expand_map(const MapType p_map_type);
+	void _clear_map(const MapType p_map_type);
+	void _unmap(const MapType p_map_type);
 
 public:
 	Terrain3DRegion() {}
@@ -73,14 +96,18 @@ public:
 	void set_map(const MapType p_map_type, const Ref<Image> &p_image);
 	Ref<Image> get_map(const MapType p_map_type) const;
 	Image *get_map_ptr(const MapType p_map_type) const;
+	Image *get_map_ptrw(const MapType p_map_type);
+	Ref<Image> read_map(const MapType p_map_type) const;
+	Color get_pixel(const MapType p_map_type, const Vector2i &p_pixel) const;
 	void set_maps(const TypedArray<Image> &p_maps);
 	TypedArray<Image> get_maps() const;
 	void set_height_map(const Ref<Image> &p_map);
-	Ref<Image> get_height_map() const { return _height_map; }
+	Ref<Image> get_height_map() const { return get_map(TYPE_HEIGHT); }
 	void set_control_map(const Ref<Image> &p_map);
-	Ref<Image> get_control_map() const { return _control_map; }
+	Ref<Image> get_control_map() const { return get_map(TYPE_CONTROL); }
 	void set_color_map(const Ref<Image> &p_map);
-	Ref<Image> get_color_map() const { return _color_map; }
+	Ref<Image> get_color_map() const { return get_map(TYPE_COLOR); }
+	int64_t get_memory() const;
 	void sanitize_maps();
 	Ref<Image> sanitize_map(const MapType p_map_type, const Ref<Image> &p_map) const;
 	bool validate_map_size(const Ref<Image> &p_map) const;
@@ -92,13 +119,34 @@ public:
 	void calc_height_range();
 
 	// Instancer
-	void set_instances(const Dictionary &p_instances) { _instances = p_instances; }
-	Dictionary get_instances() const { return _instances; }
+	void set_instances(const Dictionary &p_instances) { _instances.from_dictionary(p_instances); }
+	Dictionary get_instances() const { return _instances.to_dictionary(); }
+	void set_instance_data(const Dictionary &p_data) { _instances.deserialize(p_data); }
+	Dictionary get_instance_data() const { return _instances.serialize(); }
+	int64_t get_instance_count() const { return _instances.get_instance_count(); }
+	InstanceData *get_instances_ptr() { return &_instances; }
+	const InstanceData *get_instances_ptr() const { return &_instances; }
 	void set_vertex_spacing(const real_t p_vertex_spacing) { _vertex_spacing = CLAMP(p_vertex_spacing, 0.25f, 100.f); }
 	real_t get_vertex_spacing() const { return _vertex_spacing; }
 
 	// File I/O
 	Error save(const String &p_path = "", const bool p_16_bit = false);
+	Error write(const String &p_path, const bool p_16_bit = false, uint64_t *r_bytes = nullptr) const;
+	Error save_binary(const String &p_path, const real_t p_height_step = 0.f, const bool p_mappable = false) const;
+	static Ref<Terrain3DRegion> load_binary(const String &p_path);
+	static Ref<Terrain3DRegion> load_mapped(const String &p_path);
+
+	// Memory mapping
+	void set_mapped_map(const MapType p_map_type, const std::shared_ptr<const MappedFile> &p_file, const uint8_t *p_data);
+	const uint8_t *get_mapped_ptr(const MapType p_map_type) const;
+	std::shared_ptr<const MappedFile> get_mapped_file() const { return _mapped_file; }
+	bool is_mapped() const { return _mapped_file != nullptr; }
+
+	// Sparse maps
+	std::shared_ptr<const SparseMap> get_sparse_map(const MapType p_map_type) const;
+	SparseMap *get_sparse_map_ptrw(const MapType p_map_type);
+	bool is_sparse(const MapType p_map_type) const { return get_sparse_map(p_map_type) != nullptr; }
+	bool compact_map(const MapType p_map_type);
 
 	// Working Data
 	void set_deleted(const bool p_deleted) { _deleted = p_deleted; }
@@ -107,8 +155,13 @@ public:
 	bool is_edited() const { return _edited; }
 	void set_modified(const bool p_modified) { _modified = p_modified; }
 	bool is_modified() const { return _modified; }
+	void add_dirty_rect(const MapType p_map_type, const Rect2i &p_rect);
+	Rect2i take_dirty_rect(const MapType p_map_type);
+	void clear_dirty_rects();
 	void set_location(const Vector2i &p_location);
 	Vector2i get_location() const { return _location; }
+	void set_height_pyramid(const std::shared_ptr<HeightPyramid> &p_pyramid) { _height_pyramid = p_pyramid; }
+	std::shared_ptr<HeightPyramid> get_height_pyramid() const { return _height_pyramid; }
 
 	// Utility
 	void set_data(const Dictionary &p_data);
@@ -131,6 +184,40 @@ constexpr inline const Color *COLOR = Terrain3DRegion::COLOR;
 
 // Inline functions
 
+// Returns the map data read directly from a memory mapped file, or nullptr if the map is an Image
+inline const uint8_t *Terrain3DRegion::get_mapped_ptr(const MapType p_map_type) const {
+	return (p_map_type >= 0 && p_map_type < TYPE_MAX) ? _mapped_maps[p_map_type] : nullptr;
+}
+
+// Returns the map stored in tiles, or nullptr if the map is an Image or memory mapped
+inline std::shared_ptr<const SparseMap> Terrain3DRegion::get_sparse_map(const MapType p_map_type) const {
+	return (p_map_type >= 0 && p_map_type < TYPE_MAX) ? _sparse_maps[p_map_type] : nullptr;
+}
+
+// Grows the area of the map edited since the last upload by Terrain3DData::update_maps()
+inline void Terrain3DRegion::add_dirty_rect(const MapType p_map_type, const Rect2i &p_rect) {
+	if (p_map_type >= 0 && p_map_type < TYPE_MAX) {
+		Rect2i &rect = _dirty_rects[p_map_type];
+		rect = rect.has_area() ? rect.merge(p_rect) : p_rect;
+	}
+}
+
+// Returns and resets the edited area of the map. Empty means the whole map should be uploaded.
+inline Rect2i Terrain3DRegion::take_dirty_rect(const MapType p_map_type) {
+	if (p_map_type < 0 || p_map_type >= TYPE_MAX) {
+		return Rect2i();
+	}
+	Rect2i rect = _dirty_rects[p_map_type];
+	_dirty_rects[p_map_type] = Rect2i();
+	return rect;
+}
+
+inline void Terrain3DRegion::clear_dirty_rects() {
+	for (int i = 0; i < TYPE_MAX; i++) {
+		_dirty_rects[i] = Rect2i();
+	}
+}
+
 inline void Terrain3DRegion::update_height(const real_t p_height) {
 	if (p_height < _height_range.x) {
 		_height_range.x = p_height;
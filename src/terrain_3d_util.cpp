@@ -3,11 +3,39 @@
 #include <godot_cpp/classes/dir_access.hpp>
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
 #include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
 
 #include "logger.h"
+#include "region_file.h"
+#include "terrain_3d_editor.h"
+#include "terrain_3d_region.h"
 #include "terrain_3d_util.h"
 
+///////////////////////////
+// Private Functions
+///////////////////////////
+
+struct ParallelForJob {
+	const std::function<void(const int, const int)> *func = nullptr;
+	int count = 0;
+	int batch = 0;
+};
+
+// Returns the elements per parallel_for() task. A few tasks per thread balances uneven workloads.
+int Terrain3DUtil::_get_parallel_batch(const int p_count, const int p_min_batch) {
+	int threads = MAX(1, OS::get_singleton()->get_processor_count());
+	return MAX(MAX(1, p_min_batch), int_divide_ceil(p_count, threads * 4));
+}
+
+void Terrain3DUtil::_parallel_for_task(const uint32_t p_index, const uint64_t p_job) {
+	const ParallelForJob *job = reinterpret_cast<const ParallelForJob *>(p_job);
+	int from = int(p_index) * job->batch;
+	int to = MIN(from + job->batch, job->count);
+	(*job->func)(from, to);
+}
+
 ///////////////////////////
 // Public Functions
 ///////////////////////////
@@ -73,13 +101,17 @@ void Terrain3DUtil::dump_maps(const TypedArray<Image> &p_maps, const String &p_n
 	LOG(DEBUG, "Dumping ", p_name, " map array. Size: ", p_maps.size());
 	for (int i = 0; i < p_maps.size(); i++) {
 		Ref<Image> img = p_maps[i];
+		if (img.is_null()) {
+			LOG(DEBUG, "[", i, "]: No image, memory mapped");
+			continue;
+		}
 		LOG(DEBUG, "[", i, "]: Map size: ", img->get_size(), " format: ", img->get_format(), " ", img);
 	}
 }
 
-// Expects a filename in a String like: "terrain3d-01_02.res" which returns (-1, 2)
+// Expects a filename in a String like: "terrain3d-01_02.res" or ".t3dr" which returns (-1, 2)
 Vector2i Terrain3DUtil::filename_to_location(const String &p_filename) {
-	String location_string = p_filename.trim_prefix("terrain3d").trim_suffix(".res");
+	String location_string = p_filename.get_basename().trim_prefix("terrain3d");
 	return string_to_location(location_string);
 }
 
@@ -128,6 +160,33 @@ PackedStringArray Terrain3DUtil::get_files(const String &p_dir, const String &p_
 	return files;
 }
 
+/** Converts a region file between the Resource format (.res) and the compact binary format of
+ * RegionFile (.t3dr), chosen by the extension of each path.
+ *	p_height_step - quantizes heights to multiples of this many meters when writing a binary file.
+ *		0 keeps them lossless.
+ *	p_mappable - writes a binary file for Terrain3DRegion::load_mapped()
+ */
+Error Terrain3DUtil::convert_region_file(const String &p_src_path, const String &p_dst_path, const real_t p_height_step, const bool p_mappable) {
+	Ref<Terrain3DRegion> region;
+	if (RegionFile::is_region_file(p_src_path)) {
+		region = RegionFile::load(p_src_path);
+	} else {
+		region = ResourceLoader::get_singleton()->load(p_src_path, "Terrain3DRegion", ResourceLoader::CACHE_MODE_IGNORE);
+		if (region.is_valid()) {
+			region->set_location(filename_to_location(p_src_path.get_file()));
+		}
+	}
+	if (region.is_null()) {
+		LOG(ERROR, "Cannot load region file: ", p_src_path);
+		return ERR_FILE_CANT_READ;
+	}
+	Error err = RegionFile::is_region_file(p_dst_path) ? RegionFile::save(region.ptr(), p_dst_path, p_height_step, p_mappable) : region->write(p_dst_path);
+	if (err == OK) {
+		LOG(INFO, "Converted region ", region->get_location(), " from ", p_src_path, " to ", p_dst_path);
+	}
+	return err;
+}
+
 Ref<Image> Terrain3DUtil::black_to_alpha(const Ref<Image> &p_image) {
 	if (p_image.is_null()) {
 		return Ref<Image>();
@@ -446,6 +505,39 @@ Ref<Image> Terrain3DUtil::luminance_to_height(const Ref<Image> &p_src_rgb) {
 	return dst;
 }
 
+/**
+ * Splits the range [0, p_count) into batches and calls p_func(from, to) on each from the
+ * WorkerThreadPool, returning once all are done. Small ranges run on the calling thread.
+ * p_func must be safe to run concurrently on disjoint ranges.
+ *	p_min_batch - minimum number of elements per task, to amortize the task overhead
+ */
+void Terrain3DUtil::parallel_for(const int p_count, const std::function<void(const int p_from, const int p_to)> &p_func,
+		const int p_min_batch) {
+	if (p_count <= 0) {
+		return;
+	}
+	int batch = _get_parallel_batch(p_count, p_min_batch);
+	int tasks = int_divide_ceil(p_count, batch);
+	if (tasks <= 1) {
+		p_func(0, p_count);
+		return;
+	}
+	ParallelForJob job;
+	job.func = &p_func;
+	job.count = p_count;
+	job.batch = batch;
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	int64_t group_id = pool->add_group_task(callable_mp_static(&Terrain3DUtil::_parallel_for_task).bind(uint64_t(&job)),
+			tasks, -1, true, "Terrain3D parallel_for");
+	pool->wait_for_group_task_completion(group_id);
+}
+
+// Returns the number of tasks parallel_for() splits p_count elements into, 1 if it runs them on
+// the calling thread
+int Terrain3DUtil::get_parallel_tasks(const int p_count, const int p_min_batch) {
+	return (p_count > 0) ? int_divide_ceil(p_count, _get_parallel_batch(p_count, p_min_batch)) : 0;
+}
+
 void Terrain3DUtil::benchmark(Terrain3D *p_terrain) {
 	if (!p_terrain) {
 		return;
@@ -457,6 +549,24 @@ void Terrain3DUtil::benchmark(Terrain3D *p_terrain) {
 	uint64_t start_time;
 	Vector3 vec;
 	Color col;
+	uint32_t ctrl_sum;
+
+	// Reference: region lookup and Image::get_pixelv(), which get_pixel() used before reading
+	// the map buffers directly. Height maps are stored in tiles, so this reads an expanded copy.
+	Vector2i region_loc = data->get_region_location(vec);
+	Ref<Image> height_map = data->has_region(region_loc) ? data->get_region_ptr(region_loc)->read_map(TYPE_HEIGHT) : Ref<Image>();
+	if (height_map.is_valid()) {
+		for (int i = 0; i < 3; i++) {
+			start_time = Time::get_singleton()->get_ticks_msec();
+			for (uint32_t j = 0; j < 10000000; j++) {
+				if (data->get_region_ptr(region_loc)) {
+					col = height_map->get_pixelv(V2I_ZERO);
+				}
+			}
+			LOG(MESG, "Image::get_pixelv() 10M: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms");
+		}
+	}
+
 	for (int i = 0; i < 3; i++) {
 		start_time = Time::get_singleton()->get_ticks_msec();
 		for (uint32_t j = 0; j < 10000000; j++) {
@@ -465,6 +575,15 @@ void Terrain3DUtil::benchmark(Terrain3D *p_terrain) {
 		LOG(MESG, "get_pixel() 10M: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms");
 	}
 
+	for (int i = 0; i < 3; i++) {
+		ctrl_sum = 0;
+		start_time = Time::get_singleton()->get_ticks_msec();
+		for (uint32_t j = 0; j < 10000000; j++) {
+			ctrl_sum += data->get_control(vec);
+		}
+		LOG(MESG, "get_control() 10M: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms, sum: ", ctrl_sum);
+	}
+
 	vec = Vector3(0.5f, 0.f, 0.5f);
 	for (int i = 0; i < 3; i++) {
 		start_time = Time::get_singleton()->get_ticks_msec();
@@ -474,6 +593,102 @@ void Terrain3DUtil::benchmark(Terrain3D *p_terrain) {
 		LOG(MESG, "get_height() 1M interpolated: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms");
 	}
 
+	// Batched queries spread across a region
+	PackedVector3Array positions;
+	positions.resize(1000000);
+	real_t region_width = real_t(p_terrain->get_region_size()) * p_terrain->get_vertex_spacing();
+	for (int64_t j = 0; j < positions.size(); j++) {
+		positions[j] = Vector3(UtilityFunctions::randf() * region_width, 0.f, UtilityFunctions::randf() * region_width);
+	}
+	for (int i = 0; i < 3; i++) {
+		start_time = Time::get_singleton()->get_ticks_msec();
+		data->get_heights(positions);
+		LOG(MESG, "get_heights() 1M: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms");
+	}
+
+	for (int i = 0; i < 3; i++) {
+		start_time = Time::get_singleton()->get_ticks_msec();
+		for (int64_t j = 0; j < 100000; j++) {
+			vec = data->raycast(positions[j] + Vector3(0.f, 1000.f, 0.f), Vector3(.3f, -1.f, .2f));
+		}
+		LOG(MESG, "raycast() 100k: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms");
+	}
+
+	PackedVector3Array origins = positions.slice(0, 100000);
+	PackedVector3Array directions;
+	directions.resize(origins.size());
+	for (int64_t j = 0; j < origins.size(); j++) {
+		origins[j] += Vector3(0.f, 1000.f, 0.f);
+		directions[j] = Vector3(.3f, -1.f, .2f);
+	}
+	for (int i = 0; i < 3; i++) {
+		start_time = Time::get_singleton()->get_ticks_msec();
+		data->raycast_batch(origins, directions);
+		LOG(MESG, "raycast_batch() 100k: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms");
+	}
+
+	// Height sampler kernel vs the scalar reference on the same positions, a quarter on vertices
+	std::shared_ptr<const DataSnapshot> snapshot = data->get_snapshot();
+	if (snapshot) {
+		const MapSampler &sampler = snapshot->get_sampler();
+		std::vector<Vector2> descaled(positions.size());
+		for (int64_t j = 0; j < positions.size(); j++) {
+			descaled[j] = v3v2(positions[j]) / p_terrain->get_vertex_spacing();
+			descaled[j] = (j % 4 == 0) ? descaled[j].round() : descaled[j];
+		}
+		int sampled = 0;
+		int mismatched = 0;
+		for (const Vector2 &pos : descaled) {
+			const MapSampler::RegionPtrs *ptrs = sampler.get_region_ptrs(pos);
+			if (!ptrs) {
+				continue;
+			}
+			real_t height = sampler.sample_height(*ptrs, pos);
+			real_t reference = sampler.sample_height_scalar(*ptrs, pos);
+			sampled++;
+			if (std::isnan(height) != std::isnan(reference) ||
+					Math::abs(height - reference) > 1e-4f * MAX(1.f, Math::abs(reference))) {
+				mismatched++;
+			}
+		}
+		if (mismatched > 0) {
+			LOG(WARN, MapSampler::get_simd_name(), " sample_height() mismatched the scalar path on ", mismatched, " of ", sampled, " positions");
+		} else {
+			LOG(MESG, MapSampler::get_simd_name(), " sample_height() matched the scalar path on ", sampled, " positions");
+		}
+
+		real_t sum;
+		for (int i = 0; i < 3; i++) {
+			sum = 0.f;
+			start_time = Time::get_singleton()->get_ticks_msec();
+			for (const Vector2 &pos : descaled) {
+				const MapSampler::RegionPtrs *ptrs = sampler.get_region_ptrs(pos);
+				sum += ptrs ? sampler.sample_height(*ptrs, pos) : 0.f;
+			}
+			LOG(MESG, MapSampler::get_simd_name(), " sample_height() 1M: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms, sum: ", sum);
+		}
+		for (int i = 0; i < 3; i++) {
+			sum = 0.f;
+			start_time = Time::get_singleton()->get_ticks_msec();
+			for (const Vector2 &pos : descaled) {
+				const MapSampler::RegionPtrs *ptrs = sampler.get_region_ptrs(pos);
+				sum += ptrs ? sampler.sample_height_scalar(*ptrs, pos) : 0.f;
+			}
+			LOG(MESG, "Scalar sample_height() 1M: ", Time::get_singleton()->get_ticks_msec() - start_time, "ms, sum: ", sum);
+		}
+	}
+
+	// A typical brush must split into several tasks, or parallel_for() runs it on this thread
+	const int brush_pixels = int(Math::ceil(100.f / p_terrain->get_vertex_spacing()));
+	const int brush_tiles = int_divide_ceil(brush_pixels, Terrain3DEditor::BRUSH_TILE_SIZE);
+	const int tile_tasks = get_parallel_tasks(brush_tiles * brush_tiles, Terrain3DEditor::BRUSH_TILE_BATCH);
+	const int stamp_tasks = get_parallel_tasks(brush_pixels, Terrain3DEditor::BRUSH_STAMP_BATCH);
+	if (tile_tasks <= 1 || stamp_tasks <= 1) {
+		LOG(WARN, "A 100m brush runs on one thread, tile tasks: ", tile_tasks, ", stamp tasks: ", stamp_tasks);
+	} else {
+		LOG(MESG, "A 100m brush splits into ", tile_tasks, " tile tasks and ", stamp_tasks, " stamp tasks");
+	}
+
 	for (int i = 0; i < 2; i++) {
 		start_time = Time::get_singleton()->get_ticks_msec();
 		p_terrain->bake_mesh(0);
@@ -510,6 +725,9 @@ void Terrain3DUtil::_bind_methods() {
 	ClassDB::bind_static_method("Terrain3DUtil", D_METHOD("filename_to_location", "filename"), &Terrain3DUtil::filename_to_location);
 	ClassDB::bind_static_method("Terrain3DUtil", D_METHOD("location_to_filename", "region_location"), &Terrain3DUtil::location_to_filename);
 
+	// Region files
+	ClassDB::bind_static_method("Terrain3DUtil", D_METHOD("convert_region_file", "src_path", "dst_path", "height_step", "mappable"), &Terrain3DUtil::convert_region_file, DEFVAL(0.f), DEFVAL(false));
+
 	// Image handling
 	ClassDB::bind_static_method("Terrain3DUtil", D_METHOD("black_to_alpha", "image"), &Terrain3DUtil::black_to_alpha);
 	ClassDB::bind_static_method("Terrain3DUtil", D_METHOD("get_min_max", "image"), &Terrain3DUtil::get_min_max);
@@ -3,6 +3,8 @@
 #ifndef TERRAIN3D_UTIL_CLASS_H
 #define TERRAIN3D_UTIL_CLASS_H
 
+#include <functional>
+
 #include <godot_cpp/classes/image.hpp>
 #include <godot_cpp/classes/resource_loader.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
@@ -35,6 +37,9 @@ public:
 	static String location_to_string(const Vector2i &p_region_loc);
 	static PackedStringArray get_files(const String &p_dir, const String &p_glob = "*");
 
+	// Region files
+	static Error convert_region_file(const String &p_src_path, const String &p_dst_path, const real_t p_height_step = 0.f, const bool p_mappable = false);
+
 	// Image operations
 	static Ref<Image> black_to_alpha(const Ref<Image> &p_image);
 	static Vector2 get_min_max(const Ref<Image> &p_image);
@@ -51,8 +56,18 @@ public:
 			const bool p_invert_alpha = false,
 			const int p_alpha_channel = 0);
 	static Ref<Image> luminance_to_height(const Ref<Image> &p_src_rgb);
+
+	// Threading
+	static void parallel_for(const int p_count, const std::function<void(const int p_from, const int p_to)> &p_func,
+			const int p_min_batch = 1024);
+	static int get_parallel_tasks(const int p_count, const int p_min_batch = 1024);
+
 	static void benchmark(Terrain3D *p_terrain);
 
+private:
+	static int _get_parallel_batch(const int p_count, const int p_min_batch);
+	static void _parallel_for_task(const uint32_t p_index, const uint64_t p_job);
+
 protected:
 	static void _bind_methods();
 };
@@ -0,0 +1,205 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+
+#include "logger.h"
+#include "region_file.h"
+#include "undo_store.h"
+
+///////////////////////////
+// Private Functions
+///////////////////////////
+
+bool UndoStore::_open_spill_file() {
+	if (_spill_file.is_valid()) {
+		return true;
+	}
+	OS *os = OS::get_singleton();
+	_spill_path = os->get_cache_dir().path_join("terrain3d_undo_" + String::num_int64(os->get_process_id()) + ".tmp");
+	_spill_file = FileAccess::open(_spill_path, FileAccess::WRITE_READ);
+	if (_spill_file.is_null()) {
+		LOG(WARN, "Cannot create undo spill file: ", _spill_path, ", error: ", FileAccess::get_open_error(),
+				". Old undo data will be discarded instead");
+		_spill_to_disk = false;
+		return false;
+	}
+	LOG(INFO, "Spilling old undo data to: ", _spill_path);
+	return true;
+}
+
+void UndoStore::_close_spill_file() {
+	if (_spill_file.is_valid()) {
+		_spill_file->close();
+		_spill_file.unref();
+		DirAccess::remove_absolute(_spill_path);
+	}
+}
+
+// Rewrites the spill file without the dropped blobs, once they take more than half of it
+void UndoStore::_compact_spill_file() {
+	if (_spill_file.is_null()) {
+		return;
+	}
+	if (_disk_bytes == 0) {
+		_close_spill_file();
+		return;
+	}
+	const uint64_t length = _spill_file->get_length();
+	if (length < 2 * _disk_bytes + MIN_MEMORY_BUDGET) {
+		return;
+	}
+	const String temp_path = _spill_path + ".compact";
+	Ref<FileAccess> file = FileAccess::open(temp_path, FileAccess::WRITE_READ);
+	if (file.is_null()) {
+		return;
+	}
+	LOG(DEBUG, "Compacting undo spill file from ", length, " to ", _disk_bytes, " bytes");
+	for (auto it = _blobs.begin(); it != _blobs.end() && it->second.spilled; ++it) {
+		Blob &blob = it->second;
+		_spill_file->seek(blob.offset);
+		blob.offset = file->get_position();
+		file->store_buffer(_spill_file->get_buffer(blob.stored_size));
+	}
+	_spill_file->close();
+	file->close();
+	DirAccess::remove_absolute(_spill_path);
+	DirAccess::rename_absolute(temp_path, _spill_path);
+	_spill_file = FileAccess::open(_spill_path, FileAccess::READ_WRITE);
+	if (_spill_file.is_null()) {
+		LOG(ERROR, "Cannot reopen undo spill file: ", _spill_path, ". Spilled undo data is lost");
+		for (auto it = _blobs.begin(); it != _blobs.end() && it->second.spilled;) {
+			it = _drop(it);
+		}
+	}
+}
+
+std::map<int64_t, UndoStore::Blob>::iterator UndoStore::_drop(const std::map<int64_t, Blob>::iterator &p_it) {
+	const Blob &blob = p_it->second;
+	if (blob.spilled) {
+		_disk_bytes -= blob.stored_size;
+	} else {
+		_memory_bytes -= blob.stored_size;
+	}
+	_raw_bytes -= uint64_t(blob.width) * blob.height * 4;
+	_dropped++;
+	return _blobs.erase(p_it);
+}
+
+// Spills or drops the oldest blobs until the memory and disk budgets are met. Blobs are spilled in
+// id order, so the ones still in memory start at _spill_cursor, and the spilled ones at the front.
+void UndoStore::_enforce_budget() {
+	auto it = _blobs.lower_bound(_spill_cursor);
+	while (_memory_bytes > uint64_t(_memory_budget) && it != _blobs.end()) {
+		Blob &blob = it->second;
+		_spill_cursor = it->first + 1;
+		if (_spill_to_disk && _open_spill_file()) {
+			_spill_file->seek_end();
+			blob.offset = _spill_file->get_position();
+			_spill_file->store_buffer(blob.data);
+			blob.data = PackedByteArray();
+			blob.spilled = true;
+			_memory_bytes -= blob.stored_size;
+			_disk_bytes += blob.stored_size;
+			++it;
+		} else {
+			it = _drop(it);
+		}
+	}
+	const uint64_t disk_budget = uint64_t(_memory_budget) * DISK_BUDGET_FACTOR;
+	for (it = _blobs.begin(); _disk_bytes > disk_budget && it != _blobs.end() && it->second.spilled;) {
+		it = _drop(it);
+	}
+	_compact_spill_file();
+}
+
+///////////////////////////
+// Public Functions
+///////////////////////////
+
+void UndoStore::clear() {
+	_blobs.clear();
+	_spill_cursor = _next_id;
+	_memory_bytes = 0;
+	_disk_bytes = 0;
+	_raw_bytes = 0;
+	_dropped = 0;
+	_close_spill_file();
+}
+
+// Compresses a tile of p_width x p_height 4 byte pixels. Returns its id, or 0 on invalid data.
+int64_t UndoStore::store(const PackedByteArray &p_tile, const int p_width, const int p_height) {
+	const int64_t raw_size = int64_t(p_width) * p_height * 4;
+	if (raw_size <= 0 || p_tile.size() != raw_size) {
+		LOG(ERROR, "Invalid undo tile size: ", p_tile.size(), ", expected: ", raw_size);
+		return 0;
+	}
+	PackedByteArray planes;
+	planes.resize(raw_size);
+	RegionFile::encode_deltas(reinterpret_cast<const uint32_t *>(p_tile.ptr()), p_width, p_height, planes.ptrw());
+	Blob blob;
+	blob.data = planes.compress(FileAccess::COMPRESSION_ZSTD);
+	blob.compressed = !blob.data.is_empty() && blob.data.size() < planes.size();
+	if (!blob.compressed) {
+		blob.data = planes;
+	}
+	blob.stored_size = blob.data.size();
+	blob.width = p_width;
+	blob.height = p_height;
+	_memory_bytes += blob.stored_size;
+	_raw_bytes += raw_size;
+	const int64_t id = _next_id++;
+	_blobs[id] = blob;
+	_enforce_budget();
+	return id;
+}
+
+// Returns a copy of the tile as given to store(), or an empty array if it was dropped
+PackedByteArray UndoStore::fetch(const int64_t p_id) {
+	auto it = _blobs.find(p_id);
+	if (it == _blobs.end()) {
+		return PackedByteArray();
+	}
+	const Blob &blob = it->second;
+	PackedByteArray stored = blob.data;
+	if (blob.spilled) {
+		if (_spill_file.is_null()) {
+			return PackedByteArray();
+		}
+		_spill_file->seek(blob.offset);
+		stored = _spill_file->get_buffer(blob.stored_size);
+	}
+	const int64_t raw_size = int64_t(blob.width) * blob.height * 4;
+	PackedByteArray planes = blob.compressed ? stored.decompress(raw_size, FileAccess::COMPRESSION_ZSTD) : stored;
+	if (planes.size() != raw_size) {
+		LOG(ERROR, "Corrupt undo tile: ", p_id);
+		return PackedByteArray();
+	}
+	PackedByteArray tile;
+	tile.resize(raw_size);
+	RegionFile::decode_deltas(planes.ptr(), blob.width, blob.height, reinterpret_cast<uint32_t *>(tile.ptrw()));
+	return tile;
+}
+
+void UndoStore::set_memory_budget(const int64_t p_bytes) {
+	_memory_budget = MAX(p_bytes, MIN_MEMORY_BUDGET);
+	LOG(INFO, "Setting undo memory budget: ", _memory_budget, " bytes");
+	_enforce_budget();
+}
+
+void UndoStore::set_spill_to_disk(const bool p_enabled) {
+	_spill_to_disk = p_enabled;
+	LOG(INFO, "Setting undo spill to disk: ", _spill_to_disk);
+	_enforce_budget();
+}
+
+Dictionary UndoStore::get_usage() const {
+	Dictionary usage;
+	usage["memory"] = int64_t(_memory_bytes);
+	usage["disk"] = int64_t(_disk_bytes);
+	usage["uncompressed"] = int64_t(_raw_bytes);
+	usage["tiles"] = int64_t(_blobs.size());
+	usage["dropped"] = int64_t(_dropped);
+	usage["memory_budget"] = _memory_budget;
+	return usage;
+}
@@ -0,0 +1,74 @@
+// Copyright © 2025 Cory Petkovsek, Roope Palmroos, and Contributors.
+
+#ifndef UNDOSTORE_CLASS_H
+#define UNDOSTORE_CLASS_H
+
+#include <map>
+
+#include <godot_cpp/classes/file_access.hpp>
+
+#include "constants.h"
+
+using namespace godot;
+
+// Holds the map tiles Terrain3DEditor saves for undo and redo. The undo history only keeps the
+// ids returned by store(). Tiles of 4 byte pixels are stored as zigzag deltas split into byte
+// planes, see RegionFile::encode_deltas(), then compressed with zstd.
+// When the tiles in memory exceed the budget, the oldest are moved to a temporary spill file, or
+// dropped if spilling is disabled. The spill file may hold DISK_BUDGET_FACTOR times the memory
+// budget before its oldest tiles are dropped. Undo entries with dropped tiles can't be applied.
+
+class UndoStore {
+	CLASS_NAME_STATIC("Terrain3DUndoStore");
+
+public: // Constants
+	static inline const int64_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+	static inline const int64_t MIN_MEMORY_BUDGET = 1024 * 1024;
+	static inline const int DISK_BUDGET_FACTOR = 4;
+
+private:
+	struct Blob {
+		PackedByteArray data; // Empty once spilled
+		uint64_t offset = 0; // In the spill file
+		int stored_size = 0;
+		int width = 0;
+		int height = 0;
+		bool compressed = false;
+		bool spilled = false;
+	};
+	std::map<int64_t, Blob> _blobs; // By id, so oldest first
+	int64_t _next_id = 1;
+	int64_t _spill_cursor = 1; // Blobs below this id are spilled or dropped
+	int64_t _memory_budget = DEFAULT_MEMORY_BUDGET;
+	bool _spill_to_disk = true;
+	uint64_t _memory_bytes = 0;
+	uint64_t _disk_bytes = 0; // Of blobs still in use, the spill file may be larger
+	uint64_t _raw_bytes = 0; // Before compression
+	uint64_t _dropped = 0;
+	Ref<FileAccess> _spill_file;
+	String _spill_path;
+
+	bool _open_spill_file();
+	void _close_spill_file();
+	void _compact_spill_file();
+	std::map<int64_t, Blob>::iterator _drop(const std::map<int64_t, Blob>::iterator &p_it);
+	void _enforce_budget();
+
+public:
+	UndoStore() {}
+	~UndoStore() { clear(); }
+	UndoStore(const UndoStore &) = delete;
+	UndoStore &operator=(const UndoStore &) = delete;
+
+	void clear();
+	int64_t store(const PackedByteArray &p_tile, const int p_width, const int p_height);
+	PackedByteArray fetch(const int64_t p_id);
+	bool has(const int64_t p_id) const { return _blobs.count(p_id) > 0; }
+	void set_memory_budget(const int64_t p_bytes);
+	int64_t get_memory_budget() const { return _memory_budget; }
+	void set_spill_to_disk(const bool p_enabled);
+	bool get_spill_to_disk() const { return _spill_to_disk; }
+	Dictionary get_usage() const;
+};
+
+#endif // UNDOSTORE_CLASS_H